@@ -0,0 +1,264 @@
+#include "audio_assets.h"
+
+#include "audio_vfs.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+
+// MA_RESOURCE_MANAGER_PAGE_SIZE_IN_MILLISECONDS, which miniaudio only
+// defines inside its implementation
+constexpr size_t kStreamPageMs = 1000;
+
+// The formats miniaudio decodes without extra backends
+constexpr const char* kAudioExtensions[] = { ".flac", ".mp3", ".wav" };
+
+std::string resolveAudioPath(const std::string& base) {
+  for (const char* ext : kAudioExtensions) {
+    std::string path = base + ext;
+    if (std::ifstream(path).good()) return path;
+  }
+  return base + ".wav";
+}
+
+bool initAudioResourceManager(ma_resource_manager* rm, AudioMemoryVfs* vfs, ma_uint32 sampleRate,
+                              ma_uint32 jobThreads) {
+  ma_resource_manager_config config = ma_resource_manager_config_init();
+  if (vfs) config.pVFS = vfs->vfs();
+  config.decodedFormat = ma_format_f32;
+  config.decodedChannels = 0; // keep the file's, for spatialization
+  config.decodedSampleRate = sampleRate;
+  config.jobThreadCount = jobThreads;
+  return ma_resource_manager_init(&config, rm) == MA_SUCCESS;
+}
+
+const char* audioLoadModeName(AudioLoadMode mode) {
+  switch (mode) {
+  case AUDIO_DECODED: return "decoded";
+  case AUDIO_ENCODED: return "encoded";
+  case AUDIO_STREAM:  return "stream";
+  }
+  return "?";
+}
+
+// Decoded size as the resource manager would store it: f32 at the engine rate
+bool probeDecodedSize(const char* path, ma_uint32 sampleRate, size_t* bytes, ma_uint32* channels) {
+  ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 0, sampleRate);
+  ma_decoder decoder;
+  if (ma_decoder_init_file(path, &config, &decoder) != MA_SUCCESS) return false;
+  // Some decoders can't report a length without decoding; *bytes is 0 then
+  ma_uint64 frames = 0;
+  if (ma_decoder_get_length_in_pcm_frames(&decoder, &frames) != MA_SUCCESS) frames = 0;
+  *channels = decoder.outputChannels;
+  ma_decoder_uninit(&decoder);
+  *bytes = static_cast<size_t>(frames) * *channels * sizeof(float);
+  return true;
+}
+
+AudioAssets::~AudioAssets() {
+  uninit();
+}
+
+int AudioAssets::init(ma_engine* engine, const char* const* paths, int count, const AudioAssetConfig& config) {
+  this->engine = engine;
+  this->config = config;
+  ma_uint32 sampleRate = ma_engine_get_sample_rate(engine);
+  size_t budgetLeft = config.memoryBudget;
+  int loading = 0;
+  if (ma_fence_init(&loadFence) != MA_SUCCESS) return 0;
+  fenceInitialized = true;
+
+  for (int i = 0; i < count; ++i) {
+    assets.push_back(std::make_unique<Asset>());
+    Asset& a = *assets.back();
+    a.path = paths[i];
+
+    std::ifstream file(a.path, std::ios::binary | std::ios::ate);
+    ma_uint32 channels = 0;
+    if (!file || !probeDecodedSize(paths[i], sampleRate, &a.decodedBytes, &channels)) {
+      std::cerr << "Failed to load " << a.path << ", continuing without it\n";
+      continue;
+    }
+    a.fileBytes = static_cast<size_t>(file.tellg());
+
+    // Two pages of decoded audio are resident while streaming
+    size_t streamBytes = 2 * (kStreamPageMs * sampleRate / 1000) * channels * sizeof(float);
+    a.streamBytes = streamBytes;
+
+    ma_uint32 flags = 0;
+    bool sizeKnown = a.decodedBytes > 0;
+    if (sizeKnown && a.decodedBytes <= config.maxDecodedSize && a.decodedBytes <= budgetLeft) {
+      a.mode = AUDIO_DECODED;
+      a.residentBytes = a.decodedBytes;
+      flags = MA_SOUND_FLAG_DECODE;
+    } else if (config.vfs && a.fileBytes + streamBytes <= budgetLeft) {
+      // Streamed like AUDIO_STREAM, but the job threads read pages from
+      // memory, so nothing waits on the disk once loaded
+      a.mode = AUDIO_ENCODED;
+      a.residentBytes = a.fileBytes + streamBytes;
+      file.seekg(0);
+      a.encoded.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+      if (!config.vfs->add(a.path, a.encoded.data(), a.encoded.size())) {
+        std::cerr << "Failed to register " << a.path << ", continuing without it\n";
+        a.encoded.clear();
+        continue;
+      }
+      a.registered = true;
+      flags = MA_SOUND_FLAG_STREAM;
+    } else {
+      a.mode = AUDIO_STREAM;
+      a.residentBytes = streamBytes;
+      flags = MA_SOUND_FLAG_STREAM;
+    }
+
+    // Returns immediately; decoding happens on the job threads
+    ma_sound_config soundConfig = ma_sound_config_init_2(engine);
+    soundConfig.pFilePath = a.path.c_str();
+    soundConfig.flags = flags | MA_SOUND_FLAG_ASYNC;
+    soundConfig.initNotifications = ma_resource_manager_pipeline_notifications_init();
+    // A stream is playable once its first pages are in, and miniaudio never
+    // releases a stream's done fence, only its init fence
+    if (flags & MA_SOUND_FLAG_STREAM) soundConfig.initNotifications.init.pFence = &loadFence;
+    else soundConfig.initNotifications.done.pFence = &loadFence;
+    if (ma_sound_init_ex(engine, &soundConfig, &a.sound) != MA_SUCCESS) {
+      std::cerr << "Failed to load " << a.path << ", continuing without it\n";
+      unregisterEncoded(a);
+      continue;
+    }
+    budgetLeft -= std::min(budgetLeft, a.residentBytes);
+    a.initialized = true;
+    ++loading;
+  }
+  return loading;
+}
+
+void AudioAssets::uninit() {
+  // Sounds must not be torn down under a running load job
+  waitAll();
+  for (auto& a : assets) {
+    if (a->initialized) ma_sound_uninit(&a->sound);
+    unregisterEncoded(*a);
+  }
+  assets.clear();
+  if (fenceInitialized) ma_fence_uninit(&loadFence);
+  fenceInitialized = false;
+}
+
+void AudioAssets::unregisterEncoded(Asset& a) {
+  if (!a.registered) return;
+  config.vfs->remove(a.path);
+  a.registered = false;
+  a.encoded.clear();
+}
+
+ma_sound* AudioAssets::sound(int i) {
+  return i >= 0 && i < count() && assets[i]->initialized ? &assets[i]->sound : nullptr;
+}
+
+bool AudioAssets::ready(int i) const {
+  if (i < 0 || i >= count() || !assets[i]->initialized) return false;
+  ma_sound* s = const_cast<ma_sound*>(&assets[i]->sound);
+  auto* ds = static_cast<ma_resource_manager_data_source*>(ma_sound_get_data_source(s));
+  // MA_BUSY while the job threads are still working on it
+  return ds && ma_resource_manager_data_source_result(ds) == MA_SUCCESS;
+}
+
+void AudioAssets::waitAll() {
+  if (fenceInitialized) ma_fence_wait(&loadFence);
+}
+
+void AudioAssets::play(int i) {
+  ma_sound* s = sound(i);
+  if (!s) return;
+  if (!ready(i)) {
+    assets[i]->pendingStart = true;
+    return;
+  }
+  // Drop anything a crossfade left scheduled on it
+  ma_node_set_state_time(s, ma_node_state_started, 0);
+  ma_node_set_state_time(s, ma_node_state_stopped, ~(ma_uint64)0);
+  ma_sound_set_fade_in_pcm_frames(s, 1.0f, 1.0f, 0);
+  ma_sound_seek_to_pcm_frame(s, 0);
+  ma_sound_start(s);
+}
+
+void AudioAssets::stop(int i) {
+  ma_sound* s = sound(i);
+  if (!s) return;
+  assets[i]->pendingStart = false;
+  ma_sound_stop(s);
+}
+
+void AudioAssets::setVolume(int i, float volume) {
+  if (ma_sound* s = sound(i)) ma_sound_set_volume(s, volume);
+}
+
+void AudioAssets::setLooping(int i, bool looping) {
+  if (ma_sound* s = sound(i)) ma_sound_set_looping(s, looping ? MA_TRUE : MA_FALSE);
+}
+
+void AudioAssets::update() {
+  for (int i = 0; i < count(); ++i) {
+    if (assets[i]->pendingStart && ready(i)) {
+      assets[i]->pendingStart = false;
+      play(i);
+    }
+  }
+}
+
+bool AudioAssets::pending() const {
+  for (const auto& a : assets)
+    if (a->pendingStart) return true;
+  return false;
+}
+
+void AudioAssets::prefetch(int i) {
+  if (!sound(i)) return;
+  Asset& a = *assets[i];
+  if (a.mode == AUDIO_DECODED || ma_sound_is_playing(&a.sound)) return;
+  // ma_sound_seek_to_pcm_frame defers to the mixer, which skips stopped
+  // sounds. Seeking the stream directly queues a page load on the resource
+  // manager's job thread, and the seek to 0 on start is then a no-op.
+  ma_data_source_seek_to_pcm_frame(ma_sound_get_data_source(&a.sound), 0);
+}
+
+ma_uint32 AudioAssets::userFlags(int i) const {
+  return assets[i]->mode == AUDIO_DECODED ? MA_SOUND_FLAG_DECODE : MA_SOUND_FLAG_STREAM;
+}
+
+void AudioAssets::addUser(int i) {
+  Asset& a = *assets[i];
+  ++a.users;
+  if (a.mode != AUDIO_DECODED) a.residentBytes += a.streamBytes;
+}
+
+size_t AudioAssets::residentBytes() const {
+  size_t total = 0;
+  for (const auto& a : assets)
+    if (a->initialized) total += a->residentBytes;
+  return total;
+}
+
+void AudioAssets::report(std::ostream& out) const {
+  out << "Audio assets (budget " << config.memoryBudget / 1024 << " KB):\n";
+  for (const auto& a : assets) {
+    if (!a->initialized) {
+      out << "  " << std::left << std::setw(20) << a->path << " missing\n" << std::right;
+      continue;
+    }
+    out << "  " << std::left << std::setw(20) << a->path << " " << std::setw(8) << audioLoadModeName(a->mode)
+        << std::right << std::setw(8) << a->residentBytes / 1024 << " KB resident ("
+        << a->fileBytes / 1024 << " KB file, ";
+    if (a->users > 0) out << a->users << " more users, ";
+    if (a->decodedBytes == 0) {
+      out << "decoded size unknown)\n";
+      continue;
+    }
+    out << a->decodedBytes / 1024 << " KB decoded, " << std::fixed << std::setprecision(1)
+        << static_cast<double>(a->decodedBytes) / std::max<size_t>(a->fileBytes, 1) << ":1)\n"
+        << std::defaultfloat << std::setprecision(6);
+  }
+  out << "  total " << residentBytes() / 1024 << " KB\n";
+}
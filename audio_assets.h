@@ -0,0 +1,129 @@
+#pragma once
+
+#include <miniaudio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class AudioMemoryVfs;
+
+enum AudioLoadMode: uint8_t {
+  AUDIO_DECODED = 0, // fully decoded to f32 at load, cheapest to play
+  AUDIO_ENCODED = 1, // file bytes kept in memory, streamed from there
+  AUDIO_STREAM  = 2  // read from disk in pages, bounded memory
+};
+
+struct AudioAssetConfig {
+  // Total resident audio memory the manager may plan for
+  size_t memoryBudget = 32u << 20;
+  // Assets whose decoded size is above this are never fully decoded
+  size_t maxDecodedSize = 8u << 20;
+  // The resource manager's VFS, which serves AUDIO_ENCODED bytes; without
+  // one, assets that don't fit decoded stream from disk
+  AudioMemoryVfs* vfs = nullptr;
+};
+
+// Owns the quadrant tracks and picks a load mode per asset from its size and
+// the memory budget: decoded if small and it fits, encoded-in-memory if the
+// file fits, otherwise streamed.
+//
+// Not thread-safe: after init() only one thread (the audio control
+// thread, see AudioControlThread) may call into it.
+//
+// Loading is asynchronous: init() only queues work on the resource manager's
+// job threads, grouped under one ma_fence. A track asked to play before it is
+// ready starts from update() once it is. Missing or unreadable files are
+// skipped and every call on them is a no-op.
+//
+// Every mode decodes on the job threads, never while mixing: decoded assets
+// once at load, encoded and streamed ones a page ahead of playback.
+//
+// FLAC and MP3 files decode through the decoders built into miniaudio. The
+// resource manager keeps one data buffer per file path, found by hash and
+// reference counted, so other sounds loading the same file with
+// MA_SOUND_FLAG_DECODE (region emitters, voice pool copies) share the one
+// decoded copy.
+class AudioAssets {
+public:
+  AudioAssets() = default;
+  AudioAssets(const AudioAssets&) = delete;
+  AudioAssets& operator=(const AudioAssets&) = delete;
+  ~AudioAssets();
+
+  // Returns the number of assets that are loading
+  int init(ma_engine* engine, const char* const* paths, int count, const AudioAssetConfig& config);
+  void uninit();
+
+  int count() const { return static_cast<int>(assets.size()); }
+  const std::string& path(int i) const { return assets[i]->path; }
+  // nullptr if the asset failed to load
+  ma_sound* sound(int i);
+  // Load flags for another sound playing asset `i` (a region emitter) the
+  // way the asset is loaded: decoded assets share the one buffer, streamed
+  // ones open a stream of their own
+  ma_uint32 userFlags(int i) const;
+  // Counts such a sound; a streamed one's pages add to residentBytes()
+  void addUser(int i);
+  bool ready(int i) const;
+  // Blocks until every queued load has finished
+  void waitAll();
+
+  // Start from the beginning, as soon as the track is ready
+  void play(int i);
+  void stop(int i);
+  void setVolume(int i, float volume);
+  void setLooping(int i, bool looping);
+  // Starts tracks whose play() was deferred; call every control step
+  void update();
+  // A deferred play() is still waiting for its track to load
+  bool pending() const;
+
+  // Warm up a stopped track so starting it doesn't wait for its first page.
+  // Only does work for streamed and encoded assets; decoded ones are
+  // already resident.
+  void prefetch(int i);
+
+  size_t residentBytes() const;
+  void report(std::ostream& out) const;
+
+private:
+  struct Asset {
+    std::string path;
+    AudioLoadMode mode = AUDIO_DECODED;
+    size_t fileBytes = 0;
+    size_t decodedBytes = 0;   // 0 if the decoder can't tell without decoding
+    size_t residentBytes = 0;
+    size_t streamBytes = 0;    // pages one stream of it holds
+    int users = 0;             // other sounds added through addUser()
+    std::vector<char> encoded; // AUDIO_ENCODED only
+    ma_sound sound;
+    bool initialized = false;
+    bool registered = false;   // `encoded` is added to config.vfs
+    bool pendingStart = false;
+  };
+  // Drops an asset's registered encoded data; safe to call more than once
+  void unregisterEncoded(Asset& a);
+
+  ma_engine* engine = nullptr;
+  AudioAssetConfig config;
+  std::vector<std::unique_ptr<Asset>> assets;
+  ma_fence loadFence;
+  bool fenceInitialized = false;
+};
+
+const char* audioLoadModeName(AudioLoadMode mode);
+
+// `base` with the first extension that exists on disk, compressed formats
+// first, or `base` + ".wav" if none do
+std::string resolveAudioPath(const std::string& base);
+
+// Resource manager for the engine: every asset is decoded straight to f32 at
+// the engine's rate, once at load (or per page when streamed), so mixing
+// never resamples; `jobThreads` decode in parallel. Files added to `vfs` are
+// read from memory.
+bool initAudioResourceManager(ma_resource_manager* rm, AudioMemoryVfs* vfs, ma_uint32 sampleRate,
+                              ma_uint32 jobThreads);
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+enum AudioCommandType: uint8_t {
+  CMD_START_TRACK,   // start a track right away, no transition
+  CMD_TRANSITION,    // crossfade to a track on the next beat/bar
+  CMD_SET_VOLUME,    // track volume, `value`
+  CMD_PREFETCH,      // warm up a stopped streamed track
+  CMD_LISTENER,      // move the spatial listener to map coordinate (`value`, `value2`)
+  CMD_SFX            // one-shot from voice pool `track` at gain `value`
+};
+
+// Small POD so pushing one is a few stores
+struct AudioCommand {
+  AudioCommandType type;
+  int16_t track;
+  float value;
+  float value2;
+};
+
+// Bounded lock-free multi-producer/single-consumer ring (Vyukov's bounded
+// queue with the consumer side simplified). push() never blocks: it fails
+// when the ring is full. pop() must only be called from one thread.
+template <typename T, size_t N>
+class MpscRing {
+  static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+  MpscRing() {
+    for (size_t i = 0; i < N; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  bool push(const T& v) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& c = cells[pos & (N - 1)];
+      size_t seq = c.seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          c.value = v;
+          c.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool pop(T& out) {
+    Cell& c = cells[tail & (N - 1)];
+    size_t seq = c.seq.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(tail + 1) < 0) return false;
+    out = c.value;
+    c.seq.store(tail + N, std::memory_order_release);
+    ++tail;
+    return true;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T value;
+  };
+  Cell cells[N];
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) size_t tail = 0; // consumer only
+};
+
+// Commands from the UI and input threads to the audio side. Producers
+// never wait on audio state; the audio control thread (AudioControlThread)
+// applies everything queued, never the real-time callback.
+class AudioCommandQueue {
+public:
+  void push(AudioCommandType type, int track, float value = 0.0f, float value2 = 0.0f) {
+    if (!ring.push({type, static_cast<int16_t>(track), value, value2}))
+      dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  template <typename F>
+  void drain(F&& apply) {
+    AudioCommand c;
+    while (ring.pop(c)) apply(c);
+  }
+
+  uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+  MpscRing<AudioCommand, 256> ring;
+  std::atomic<uint64_t> dropped{0};
+};
@@ -0,0 +1,39 @@
+#include "audio_control.h"
+
+void AudioControlThread::start(std::function<bool()> fn, std::chrono::milliseconds every) {
+  step = std::move(fn);
+  interval = every;
+  quit = false;
+  thread = std::thread(&AudioControlThread::run, this);
+}
+
+void AudioControlThread::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  wake.notify_one();
+  if (thread.joinable()) thread.join();
+}
+
+void AudioControlThread::kick() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    kicked = true;
+  }
+  wake.notify_one();
+}
+
+void AudioControlThread::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!quit) {
+    lock.unlock();
+    bool again = step();
+    lock.lock();
+    if (again)
+      wake.wait_for(lock, interval, [this] { return quit || kicked; });
+    else
+      wake.wait(lock, [this] { return quit || kicked; });
+    kicked = false;
+  }
+}
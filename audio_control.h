@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs the audio work that isn't real-time safe on its own thread, so the
+// device callback never takes a lock or waits on a job: applying queued
+// commands, starting sounds whose data has just loaded, voice bookkeeping,
+// and stream prefetch seeks that post resource-manager jobs. miniaudio's
+// sound controls are atomic, so they take effect on the mixer's next read.
+//
+// `step` runs right away after kick(). While it returns true (a deferred
+// start, a fade or a one-shot still needs watching) it runs again every
+// `interval`; otherwise the thread sleeps until the next kick(), so an idle
+// app doesn't wake it at all.
+class AudioControlThread {
+public:
+  AudioControlThread() = default;
+  AudioControlThread(const AudioControlThread&) = delete;
+  AudioControlThread& operator=(const AudioControlThread&) = delete;
+  ~AudioControlThread() { stop(); }
+
+  void start(std::function<bool()> step, std::chrono::milliseconds interval);
+  void stop();
+  void kick();
+
+private:
+  void run();
+
+  std::function<bool()> step;
+  std::chrono::milliseconds interval{5};
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool kicked = false; // guarded by mutex
+  bool quit = false;   // guarded by mutex
+};
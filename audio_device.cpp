@@ -0,0 +1,82 @@
+#include "audio_device.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+AudioDevice::~AudioDevice() {
+  uninit();
+}
+
+bool AudioDevice::init(ma_engine* engine, const AudioDeviceConfig& config) {
+  this->engine = engine;
+  this->config = config;
+  ma_device_config dc = ma_device_config_init(ma_device_type_playback);
+  // Same as the device ma_engine would create for itself
+  dc.playback.format = ma_format_f32;
+  dc.noPreSilencedOutputBuffer = MA_TRUE;
+  dc.noClip = MA_TRUE;
+  dc.dataCallback = dataCallback;
+  dc.pUserData = this;
+  // ...with the knobs it doesn't expose
+  dc.periodSizeInFrames = config.periodFrames;
+  dc.periods = config.periods;
+  dc.performanceProfile = config.lowLatency ? ma_performance_profile_low_latency : ma_performance_profile_conservative;
+  dc.noFixedSizedCallback = config.noFixedSizedCallback ? MA_TRUE : MA_FALSE;
+  if (ma_device_init_ex(NULL, 0, NULL, &dc, &dev) != MA_SUCCESS) return false;
+  initialized = true;
+  return true;
+}
+
+void AudioDevice::uninit() {
+  if (!initialized) return;
+  ma_device_uninit(&dev);
+  initialized = false;
+}
+
+void AudioDevice::dataCallback(ma_device* device, void* out, const void*, ma_uint32 frameCount) {
+  AudioDevice* self = static_cast<AudioDevice*>(device->pUserData);
+  double begin = latencyNowMs();
+  ma_engine_read_pcm_frames(self->engine, out, frameCount, NULL);
+  double end = latencyNowMs();
+
+  ma_uint32 rate = device->sampleRate;
+  if (self->lastCallbackMs >= 0.0) {
+    double gap = begin - self->lastCallbackMs;
+    self->interval.add(gap);
+    // A steady backend calls back once per period it just consumed
+    self->jitter.add(std::fabs(gap - 1000.0 * self->lastFrames / rate));
+  }
+  self->mixTime.add(end - begin);
+  self->lastCallbackMs = begin;
+  self->lastFrames = frameCount;
+  self->minFrames = self->callbacks ? std::min(self->minFrames, frameCount) : frameCount;
+  self->maxFrames = std::max(self->maxFrames, frameCount);
+  ++self->callbacks;
+}
+
+double AudioDevice::queuedLatencyMs() const {
+  if (!initialized) return 0.0;
+  double frames = static_cast<double>(dev.playback.internalPeriodSizeInFrames) * dev.playback.internalPeriods;
+  // Fixed-size callbacks are re-blocked through one more period of buffering
+  if (!config.noFixedSizedCallback) frames += dev.playback.internalPeriodSizeInFrames;
+  return 1000.0 * frames / dev.playback.internalSampleRate;
+}
+
+void AudioDevice::report(std::ostream& out) const {
+  if (!initialized) return;
+  out << "Audio device (" << ma_get_backend_name(dev.pContext->backend) << ", "
+      << (config.lowLatency ? "low latency" : "conservative") << "):\n"
+      << "  requested " << config.periodFrames << " x " << config.periods << " frames (0 = default), got "
+      << dev.playback.internalPeriodSizeInFrames << " x " << dev.playback.internalPeriods << " at "
+      << dev.playback.internalSampleRate << " Hz\n"
+      << "  callbacks " << callbacks << ", " << minFrames << "-" << maxFrames << " frames each"
+      << (config.noFixedSizedCallback ? " (variable)" : " (fixed)") << "\n"
+      << "  queued latency " << queuedLatencyMs() << " ms\n";
+  out.flush();
+  interval.print("interval");
+  jitter.print("jitter");
+  mixTime.print("callback");
+  std::fflush(stdout);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "latency.h"
+
+#include <miniaudio.h>
+
+#include <ostream>
+
+struct AudioDeviceConfig {
+  ma_uint32 periodFrames = 0;      // 0: backend default
+  ma_uint32 periods = 0;           // 0: backend default
+  bool lowLatency = false;         // ma_performance_profile_low_latency
+  // Let the backend pick each callback's size instead of miniaudio
+  // re-blocking to periodFrames, which costs up to one extra period
+  bool noFixedSizedCallback = false;
+};
+
+// The playback device, created here rather than by ma_engine so period size,
+// period count and performance profile can be tuned per deployment. Every
+// callback is timed; report() shows what the backend actually granted, how
+// regularly it calls back and how much audio sits queued ahead of the DAC.
+//
+// Usage: init(), pass device() as ma_engine_config::pDevice together with
+// the same engine passed to init(), then ma_engine_init starts it. Stop the
+// engine before uninit().
+class AudioDevice {
+public:
+  AudioDevice() = default;
+  AudioDevice(const AudioDevice&) = delete;
+  AudioDevice& operator=(const AudioDevice&) = delete;
+  ~AudioDevice();
+
+  bool init(ma_engine* engine, const AudioDeviceConfig& config);
+  void uninit();
+
+  ma_device* device() { return &dev; }
+  // Device buffer plus miniaudio's re-blocking buffer, in milliseconds
+  double queuedLatencyMs() const;
+  // Only call once the device is stopped
+  void report(std::ostream& out) const;
+
+private:
+  static void dataCallback(ma_device* device, void* out, const void* in, ma_uint32 frameCount);
+
+  ma_engine* engine = nullptr;
+  AudioDeviceConfig config;
+  ma_device dev;
+  bool initialized = false;
+
+  // Audio thread only while running
+  double lastCallbackMs = -1.0;
+  ma_uint64 callbacks = 0;
+  ma_uint32 minFrames = 0, maxFrames = 0;
+  LatencyHistogram interval; // between callback starts
+  LatencyHistogram jitter;   // |interval - frames of the previous callback|
+  LatencyHistogram mixTime;  // spent inside the callback
+  ma_uint32 lastFrames = 0;
+};
@@ -0,0 +1,107 @@
+#include "audio_vfs.h"
+
+#include <algorithm>
+
+// An open handle: a cursor into a buffer in memory, or a file of the
+// fallback VFS
+struct AudioMemoryVfs::File {
+  const char* data = nullptr;
+  size_t size = 0;
+  size_t pos = 0;
+  ma_vfs_file inner = nullptr;
+};
+
+AudioMemoryVfs::AudioMemoryVfs() {
+  callbacks.cb.onOpen = onOpen;
+  callbacks.cb.onOpenW = NULL; // the resource manager is only given UTF-8 paths
+  callbacks.cb.onClose = onClose;
+  callbacks.cb.onRead = onRead;
+  callbacks.cb.onWrite = onWrite;
+  callbacks.cb.onSeek = onSeek;
+  callbacks.cb.onTell = onTell;
+  callbacks.cb.onInfo = onInfo;
+  callbacks.owner = this;
+  ma_default_vfs_init(&fallback, NULL);
+}
+
+bool AudioMemoryVfs::add(const std::string& path, const void* data, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return files.emplace(path, std::make_pair(static_cast<const char*>(data), size)).second;
+}
+
+void AudioMemoryVfs::remove(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex);
+  files.erase(path);
+}
+
+ma_result AudioMemoryVfs::onOpen(ma_vfs* pVFS, const char* pFilePath, ma_uint32 openMode, ma_vfs_file* pFile) {
+  AudioMemoryVfs* vfs = self(pVFS);
+  File* f = new File;
+  {
+    std::lock_guard<std::mutex> lock(vfs->mutex);
+    auto it = vfs->files.find(pFilePath);
+    if (it != vfs->files.end() && (openMode & MA_OPEN_MODE_WRITE) == 0) {
+      f->data = it->second.first;
+      f->size = it->second.second;
+    }
+  }
+  if (!f->data) {
+    ma_result result = ma_vfs_open(&vfs->fallback, pFilePath, openMode, &f->inner);
+    if (result != MA_SUCCESS) {
+      delete f;
+      return result;
+    }
+  }
+  *pFile = f;
+  return MA_SUCCESS;
+}
+
+ma_result AudioMemoryVfs::onClose(ma_vfs* pVFS, ma_vfs_file file) {
+  File* f = static_cast<File*>(file);
+  ma_result result = f->inner ? ma_vfs_close(&self(pVFS)->fallback, f->inner) : MA_SUCCESS;
+  delete f;
+  return result;
+}
+
+ma_result AudioMemoryVfs::onRead(ma_vfs* pVFS, ma_vfs_file file, void* pDst, size_t sizeInBytes, size_t* pBytesRead) {
+  File* f = static_cast<File*>(file);
+  if (f->inner) return ma_vfs_read(&self(pVFS)->fallback, f->inner, pDst, sizeInBytes, pBytesRead);
+  size_t n = std::min(sizeInBytes, f->size - f->pos);
+  std::copy(f->data + f->pos, f->data + f->pos + n, static_cast<char*>(pDst));
+  f->pos += n;
+  if (pBytesRead) *pBytesRead = n;
+  return n == 0 && sizeInBytes > 0 ? MA_AT_END : MA_SUCCESS;
+}
+
+ma_result AudioMemoryVfs::onWrite(ma_vfs* pVFS, ma_vfs_file file, const void* pSrc, size_t sizeInBytes,
+                                  size_t* pBytesWritten) {
+  File* f = static_cast<File*>(file);
+  if (f->inner) return ma_vfs_write(&self(pVFS)->fallback, f->inner, pSrc, sizeInBytes, pBytesWritten);
+  return MA_ACCESS_DENIED;
+}
+
+ma_result AudioMemoryVfs::onSeek(ma_vfs* pVFS, ma_vfs_file file, ma_int64 offset, ma_seek_origin origin) {
+  File* f = static_cast<File*>(file);
+  if (f->inner) return ma_vfs_seek(&self(pVFS)->fallback, f->inner, offset, origin);
+  ma_int64 base = origin == ma_seek_origin_start ? 0
+                : origin == ma_seek_origin_end   ? static_cast<ma_int64>(f->size)
+                                                 : static_cast<ma_int64>(f->pos);
+  ma_int64 pos = base + offset;
+  if (pos < 0 || pos > static_cast<ma_int64>(f->size)) return MA_BAD_SEEK;
+  f->pos = static_cast<size_t>(pos);
+  return MA_SUCCESS;
+}
+
+ma_result AudioMemoryVfs::onTell(ma_vfs* pVFS, ma_vfs_file file, ma_int64* pCursor) {
+  File* f = static_cast<File*>(file);
+  if (f->inner) return ma_vfs_tell(&self(pVFS)->fallback, f->inner, pCursor);
+  *pCursor = static_cast<ma_int64>(f->pos);
+  return MA_SUCCESS;
+}
+
+ma_result AudioMemoryVfs::onInfo(ma_vfs* pVFS, ma_vfs_file file, ma_file_info* pInfo) {
+  File* f = static_cast<File*>(file);
+  if (f->inner) return ma_vfs_info(&self(pVFS)->fallback, f->inner, pInfo);
+  pInfo->sizeInBytes = f->size;
+  return MA_SUCCESS;
+}
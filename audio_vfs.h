@@ -0,0 +1,52 @@
+#pragma once
+
+#include <miniaudio.h>
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Resource manager VFS that serves files held in memory by path and hands
+// every other path to miniaudio's default (stdio) VFS. Lets a stream decode
+// page by page on the job threads from bytes that are already resident, so
+// neither disk reads nor decoding ever happen on the mixing thread.
+//
+// add() and remove() may run while the job threads read other files; the
+// caller keeps an added buffer alive until every sound reading it is gone.
+class AudioMemoryVfs {
+public:
+  AudioMemoryVfs();
+  AudioMemoryVfs(const AudioMemoryVfs&) = delete;
+  AudioMemoryVfs& operator=(const AudioMemoryVfs&) = delete;
+
+  // What to pass as ma_resource_manager_config::pVFS
+  ma_vfs* vfs() { return &callbacks; }
+
+  bool add(const std::string& path, const void* data, size_t size);
+  void remove(const std::string& path);
+
+private:
+  struct File;
+
+  static ma_result onOpen(ma_vfs* pVFS, const char* pFilePath, ma_uint32 openMode, ma_vfs_file* pFile);
+  static ma_result onClose(ma_vfs* pVFS, ma_vfs_file file);
+  static ma_result onRead(ma_vfs* pVFS, ma_vfs_file file, void* pDst, size_t sizeInBytes, size_t* pBytesRead);
+  static ma_result onWrite(ma_vfs* pVFS, ma_vfs_file file, const void* pSrc, size_t sizeInBytes,
+                           size_t* pBytesWritten);
+  static ma_result onSeek(ma_vfs* pVFS, ma_vfs_file file, ma_int64 offset, ma_seek_origin origin);
+  static ma_result onTell(ma_vfs* pVFS, ma_vfs_file file, ma_int64* pCursor);
+  static ma_result onInfo(ma_vfs* pVFS, ma_vfs_file file, ma_file_info* pInfo);
+
+  // miniaudio calls back with the ma_vfs it was given, i.e. &callbacks
+  struct Callbacks {
+    ma_vfs_callbacks cb; // must be first
+    AudioMemoryVfs* owner;
+  };
+  static AudioMemoryVfs* self(ma_vfs* pVFS) { return static_cast<Callbacks*>(pVFS)->owner; }
+
+  Callbacks callbacks;
+  ma_default_vfs fallback;
+  std::mutex mutex;
+  std::unordered_map<std::string, std::pair<const char*, size_t>> files; // guarded by mutex
+};
@@ -0,0 +1,152 @@
+#include "border_layer.h"
+#include "gl_util.h"
+
+#include <algorithm>
+
+// Segment quad: (end, side) per corner, drawn as a strip
+constexpr float kSegmentCorners[] = {0.0f, -1.0f, 0.0f, 1.0f, 1.0f, -1.0f, 1.0f, 1.0f};
+
+bool BorderLayer::init(const char* path) {
+  if (!set.load(path)) return false;
+
+  // Every level in one buffer, with each point's feature alongside for the
+  // fill colour
+  std::vector<BorderPoint> points;
+  std::vector<uint32_t> featureOf;
+  std::vector<uint32_t> indices;
+  for (const BorderSet::Lod& lod : set.lods) {
+    lodBase.push_back(static_cast<uint32_t>(points.size()));
+    lodIndexBase.push_back(static_cast<uint32_t>(indices.size()));
+    points.insert(points.end(), lod.points.begin(), lod.points.end());
+    featureOf.resize(points.size());
+    for (size_t f = 0; f < lod.ranges.size(); ++f) {
+      const BorderSet::Range& r = lod.ranges[f];
+      std::fill_n(featureOf.begin() + lodBase.back() + r.firstPoint, r.pointCount, static_cast<uint32_t>(f));
+    }
+    indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+  }
+  // The points now live on the GPU
+  for (BorderSet::Lod& lod : set.lods) {
+    std::vector<BorderPoint>().swap(lod.points);
+    std::vector<uint32_t>().swap(lod.indices);
+  }
+
+  lineProgram = loadProgram("glsl/vertex_border_line.glsl", "glsl/fragment_border_line.glsl");
+  fillProgram = loadProgram("glsl/vertex_border_fill.glsl", "glsl/fragment_border_fill.glsl");
+  lineZoomLoc = glGetUniformLocation(lineProgram, "zoom");
+  linePanLoc = glGetUniformLocation(lineProgram, "pan");
+  lineViewportLoc = glGetUniformLocation(lineProgram, "viewport");
+  lineWidthLoc = glGetUniformLocation(lineProgram, "halfWidth");
+  fillZoomLoc = glGetUniformLocation(fillProgram, "zoom");
+  fillPanLoc = glGetUniformLocation(fillProgram, "pan");
+
+  glGenBuffers(1, &cornerVBO);
+  glGenBuffers(1, &pointVBO);
+  glGenBuffers(1, &featureVBO);
+  glGenBuffers(1, &indexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, cornerVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kSegmentCorners), kSegmentCorners, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, pointVBO);
+  glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(BorderPoint), points.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, featureVBO);
+  glBufferData(GL_ARRAY_BUFFER, featureOf.size() * sizeof(uint32_t), featureOf.data(), GL_STATIC_DRAW);
+
+  // Outlines: the segment's endpoints are instance attributes, pointed at
+  // each run before drawing it
+  glGenVertexArrays(1, &lineVAO);
+  glBindVertexArray(lineVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, cornerVBO);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  for (int a = 1; a <= 2; ++a) {
+    glEnableVertexAttribArray(a);
+    glVertexAttribDivisor(a, 1);
+  }
+
+  glGenVertexArrays(1, &fillVAO);
+  glBindVertexArray(fillVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, pointVBO);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(BorderPoint), (void*)0);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, featureVBO);
+  glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+  glEnableVertexAttribArray(1);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+  glBindVertexArray(0);
+
+  lineRuns.reserve(set.features.size());
+  fillRuns.reserve(set.features.size());
+  return true;
+}
+
+void BorderLayer::release() {
+  glDeleteVertexArrays(1, &lineVAO);
+  glDeleteVertexArrays(1, &fillVAO);
+  glDeleteBuffers(1, &cornerVBO);
+  glDeleteBuffers(1, &pointVBO);
+  glDeleteBuffers(1, &featureVBO);
+  glDeleteBuffers(1, &indexBuffer);
+  glDeleteProgram(lineProgram);
+  glDeleteProgram(fillProgram);
+  lineVAO = fillVAO = cornerVBO = pointVBO = featureVBO = indexBuffer = 0;
+  lineProgram = fillProgram = 0;
+}
+
+void BorderLayer::collectRuns(int lod, float u0, float v0, float u1, float v1) {
+  lineRuns.clear();
+  fillRuns.clear();
+  const std::vector<BorderSet::Range>& ranges = set.lods[lod].ranges;
+  for (size_t f = 0; f < ranges.size(); ++f) {
+    const BorderSet::Feature& feat = set.features[f];
+    const BorderSet::Range& r = ranges[f];
+    if (feat.maxU < u0 || feat.minU > u1 || feat.maxV < v0 || feat.minV > v1) continue;
+    // Features are stored back to back, so neighbours usually merge
+    if (r.pointCount) {
+      if (!lineRuns.empty() && lineRuns.back().first + lineRuns.back().count == r.firstPoint)
+        lineRuns.back().count += r.pointCount;
+      else
+        lineRuns.push_back({r.firstPoint, r.pointCount});
+    }
+    if (r.indexCount) {
+      if (!fillRuns.empty() && fillRuns.back().first + fillRuns.back().count == r.firstIndex)
+        fillRuns.back().count += r.indexCount;
+      else
+        fillRuns.push_back({r.firstIndex, r.indexCount});
+    }
+  }
+}
+
+void BorderLayer::draw(float zoom, float panX, float panY) {
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  // One screen pixel in texture coordinates, in the tighter direction
+  float texel = 1.0f / (std::max(viewport[2], viewport[3]) * zoom);
+  int lod = set.pickLod(texel);
+  collectRuns(lod, 0.5f + panX - 0.5f / zoom, 0.5f + panY - 0.5f / zoom, 0.5f + panX + 0.5f / zoom,
+              0.5f + panY + 0.5f / zoom);
+
+  glUseProgram(fillProgram);
+  glUniform1f(fillZoomLoc, zoom);
+  glUniform2f(fillPanLoc, panX, panY);
+  glBindVertexArray(fillVAO);
+  for (const Run& run : fillRuns) {
+    const void* offset = (void*)(static_cast<size_t>(lodIndexBase[lod] + run.first) * sizeof(uint32_t));
+    glDrawElementsBaseVertex(GL_TRIANGLES, run.count, GL_UNSIGNED_INT, offset, lodBase[lod]);
+  }
+
+  glUseProgram(lineProgram);
+  glUniform1f(lineZoomLoc, zoom);
+  glUniform2f(linePanLoc, panX, panY);
+  glUniform2f(lineViewportLoc, static_cast<float>(viewport[2]), static_cast<float>(viewport[3]));
+  glUniform1f(lineWidthLoc, kLineWidth * 0.5f);
+  glBindVertexArray(lineVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, pointVBO);
+  for (const Run& run : lineRuns) {
+    size_t first = (static_cast<size_t>(lodBase[lod]) + run.first) * sizeof(BorderPoint);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(BorderPoint), (void*)first);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(BorderPoint), (void*)(first + sizeof(BorderPoint)));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, run.count - 1);
+  }
+  glBindVertexArray(0);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "borders.h"
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// Draws a BorderSet over the map: a faint per-feature fill and an
+// anti-aliased outline of constant pixel width. Every level of detail sits
+// in one static vertex buffer. Outlines are instanced quads, one per segment,
+// read straight from the point list with p1 one point after p0 and widened
+// in the vertex shader. Each frame picks the level for the current scale and
+// draws only the features whose bounds touch the view, merging neighbours
+// into as few draws as possible.
+//
+// Render thread only, with the GL context current.
+class BorderLayer {
+public:
+  static constexpr float kLineWidth = 1.5f; // pixels
+
+  // False if there is no border file at `path`
+  bool init(const char* path);
+  void release();
+  bool enabled() const { return lineProgram != 0; }
+
+  void draw(float zoom, float panX, float panY);
+
+  // Names and bounds, for labelling
+  const std::vector<BorderSet::Feature>& features() const { return set.features; }
+
+private:
+  struct Run {
+    uint32_t first, count;
+  };
+  // Visible features' ranges at `lod`, with touching neighbours merged
+  void collectRuns(int lod, float u0, float v0, float u1, float v1);
+
+  BorderSet set;
+  std::vector<uint32_t> lodBase;      // first point of each level in the buffer
+  std::vector<uint32_t> lodIndexBase; // first index of each level
+  GLuint lineProgram = 0, fillProgram = 0;
+  GLuint cornerVBO = 0, pointVBO = 0, featureVBO = 0, indexBuffer = 0;
+  GLuint lineVAO = 0, fillVAO = 0;
+  GLint lineZoomLoc = -1, linePanLoc = -1, lineViewportLoc = -1, lineWidthLoc = -1;
+  GLint fillZoomLoc = -1, fillPanLoc = -1;
+  // Per-frame scratch, reserved in init()
+  std::vector<Run> lineRuns, fillRuns;
+};
@@ -0,0 +1,69 @@
+#include "borders.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+constexpr char kBorderMagic[4] = {'K', 'B', 'R', 'D'};
+constexpr uint16_t kBorderVersion = 1;
+
+template <typename T>
+static bool read(std::ifstream& in, T& v) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+template <typename T>
+static bool readArray(std::ifstream& in, std::vector<T>& v, uint32_t count) {
+  v.resize(count);
+  return count == 0 || static_cast<bool>(in.read(reinterpret_cast<char*>(v.data()), count * sizeof(T)));
+}
+
+bool BorderSet::load(const char* path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+
+  char magic[4];
+  uint16_t version = 0;
+  uint8_t lodCount = 0;
+  uint32_t featureCount = 0;
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kBorderMagic, sizeof(magic)) != 0 ||
+      !read(in, version) || version != kBorderVersion || !read(in, lodCount) || !read(in, featureCount)) {
+    std::cerr << "Not a border file: " << path << "\n";
+    return false;
+  }
+
+  bool ok = true;
+  features.resize(featureCount);
+  for (Feature& f : features) {
+    uint8_t len = 0;
+    ok = ok && read(in, f.minU) && read(in, f.minV) && read(in, f.maxU) && read(in, f.maxV) && read(in, len);
+    f.name.resize(len);
+    ok = ok && (len == 0 || in.read(&f.name[0], len));
+  }
+  lods.resize(lodCount);
+  for (Lod& lod : lods) {
+    uint32_t pointCount = 0, indexCount = 0;
+    ok = ok && read(in, lod.tolerance) && read(in, pointCount) && read(in, indexCount) &&
+         readArray(in, lod.ranges, featureCount) && readArray(in, lod.points, pointCount) &&
+         readArray(in, lod.indices, indexCount);
+    for (const Range& r : lod.ranges)
+      ok = ok && r.firstPoint + r.pointCount <= pointCount && r.firstIndex + r.indexCount <= indexCount;
+    for (uint32_t i : lod.indices) ok = ok && i < pointCount;
+    if (!ok) break;
+  }
+  if (!ok) {
+    std::cerr << "Truncated or corrupt border file: " << path << "\n";
+    features.clear();
+    lods.clear();
+    return false;
+  }
+  return true;
+}
+
+int BorderSet::pickLod(float texelSize) const {
+  // Levels run finest first, so the last one that is fine enough wins
+  int best = 0;
+  for (int i = 0; i < static_cast<int>(lods.size()); ++i)
+    if (lods[i].tolerance <= 0.5f * texelSize) best = i;
+  return best;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A point on the map in texture coordinates (v = 0 at the bottom, like
+// RegionMap). In a ring's point list kBorderBreak separates rings.
+struct BorderPoint {
+  float u, v;
+};
+constexpr BorderPoint kBorderBreak = {-1.0f, -1.0f};
+
+// Country or province outlines, produced offline by tools/build_borders from
+// GeoJSON. Each level of detail is the same features simplified with
+// Douglas-Peucker to a tolerance, and already triangulated, so loading is
+// just reading arrays that go straight into vertex and index buffers.
+//
+// File layout (little endian):
+//   "KBRD" u16 version, u8 lodCount, u32 featureCount,
+//   featureCount x (f32 minU, minV, maxU, maxV, u8 nameLength, chars),
+//   lodCount x (f32 tolerance, u32 pointCount, u32 indexCount,
+//                featureCount x (u32 firstPoint, pointCount, firstIndex, indexCount),
+//                pointCount x (f32 u, v), indexCount x u32)
+// Finest level first. A feature's points are its closed rings, each
+// followed by kBorderBreak; its fill triangles index into the level's points.
+class BorderSet {
+public:
+  struct Feature {
+    std::string name;
+    float minU, minV, maxU, maxV;
+  };
+  struct Range {
+    uint32_t firstPoint, pointCount;
+    uint32_t firstIndex, indexCount;
+  };
+  struct Lod {
+    float tolerance; // in texture coordinates
+    std::vector<Range> ranges; // one per feature
+    std::vector<BorderPoint> points;
+    std::vector<uint32_t> indices;
+  };
+
+  bool load(const char* path);
+  bool empty() const { return lods.empty(); }
+
+  // Coarsest level whose error stays under half of a texel `texelSize`
+  // across (in texture coordinates)
+  int pickLod(float texelSize) const;
+
+  std::vector<Feature> features;
+  std::vector<Lod> lods;
+};
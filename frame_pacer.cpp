@@ -0,0 +1,30 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <thread>
+
+FrameLimiter::FrameLimiter(double targetFps) {
+  if (targetFps > 0.0) period = std::chrono::duration<double>(1.0 / targetFps);
+}
+
+void FrameLimiter::wait(void (*sleep)(double seconds)) {
+  if (!enabled()) return;
+  next += std::chrono::duration_cast<Clock::duration>(period);
+  Clock::time_point now = Clock::now();
+  // Don't try to catch up after a long stall
+  if (next < now - period) next = now;
+
+  // Coarse part
+  Clock::time_point sleepUntil = next - std::chrono::duration_cast<Clock::duration>(spinMargin);
+  while ((now = Clock::now()) < sleepUntil) {
+    sleep(std::chrono::duration<double>(sleepUntil - now).count());
+  }
+  // Learn how far past the requested wake-up the OS let us run
+  std::chrono::duration<double> over = now - sleepUntil;
+  std::chrono::duration<double> slack(0.0002);
+  spinMargin = std::clamp(spinMargin * 0.9 + (over + slack) * 0.1,
+                          std::chrono::duration<double>(0.0005), std::chrono::duration<double>(0.004));
+
+  // Fine part
+  while (Clock::now() < next) std::this_thread::yield();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+
+struct FramePacingConfig {
+  double targetFps = 0.0;     // 0 = no limiter, swaps set the pace
+  int swapInterval = 1;       // passed to glfwSwapInterval
+  bool adaptiveVsync = false; // use tear control (interval -1) when available
+  bool idle = true;           // skip frames and block when nothing changes
+  double idleTimeout = 0.25;  // seconds between wake-ups while idle
+};
+
+// Hybrid frame limiter: sleeps for the bulk of the frame and spins for the
+// last stretch, where OS sleep granularity would otherwise overshoot. The
+// spin margin tracks observed oversleep so it stays as small as possible.
+class FrameLimiter {
+public:
+  explicit FrameLimiter(double targetFps);
+
+  bool enabled() const { return period.count() > 0.0; }
+  // Waits for the next frame slot. `sleep` must block for at most the given
+  // number of seconds (e.g. glfwWaitEventsTimeout, so input keeps flowing).
+  void wait(void (*sleep)(double seconds));
+
+private:
+  using Clock = std::chrono::steady_clock;
+  std::chrono::duration<double> period{0.0};
+  std::chrono::duration<double> spinMargin{0.002};
+  Clock::time_point next = Clock::now();
+};
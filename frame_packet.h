@@ -0,0 +1,85 @@
+#pragma once
+
+#include "latency.h"
+
+#include <atomic>
+#include <cstdint>
+
+enum DrawKind: uint8_t { DRAW_MAP = 0, DRAW_KOPI = 1 };
+
+struct DrawItem {
+  DrawKind kind;
+};
+
+constexpr int kMaxDrawItems = 16;
+
+// Everything the render thread needs to draw one frame. The main thread fills
+// it in, publishes it, and never touches it again.
+struct FramePacket {
+  uint64_t frameId = 0;
+  // Camera
+  float zoom = 1.0f;
+  float panX = 0.0f, panY = 0.0f;
+  uint8_t projection = 0; // Projection
+  // Kopi uniforms
+  float offX = 0.0f, offY = 0.0f;
+  float angle = 0.0f;
+  float aspect = 1.0f;
+  // Region under the kopi, 0 for none
+  uint16_t highlightRegion = 0;
+  // Where track playback is, in the track file's seconds
+  double playbackTime = 0.0;
+  // Draw list, in submission order
+  int drawCount = 0;
+  DrawItem draws[kMaxDrawItems];
+  // Only filled in when latency measurement is on
+  LatencyStamps latency;
+
+  void push(DrawKind kind) {
+    if (drawCount < kMaxDrawItems) draws[drawCount++] = {kind};
+  }
+
+  // True if both packets would produce the same image
+  bool sameContent(const FramePacket& o) const {
+    if (zoom != o.zoom || panX != o.panX || panY != o.panY || projection != o.projection || offX != o.offX ||
+        offY != o.offY || angle != o.angle || aspect != o.aspect || highlightRegion != o.highlightRegion ||
+        playbackTime != o.playbackTime || drawCount != o.drawCount)
+      return false;
+    for (int i = 0; i < drawCount; ++i)
+      if (draws[i].kind != o.draws[i].kind) return false;
+    return true;
+  }
+};
+
+// Lock-free single-producer/single-consumer triple buffer. The producer always
+// has a private slot to write into, the consumer always reads the newest
+// published slot, and neither ever waits on the other.
+template <typename T>
+class TripleBuffer {
+public:
+  // Producer side
+  T& writeSlot() { return slots[back]; }
+  void publish() {
+    uint8_t prev = middle.exchange(back | kDirty, std::memory_order_acq_rel);
+    back = prev & kIndexMask;
+  }
+
+  // Consumer side. Returns true if a newer value was swapped in.
+  bool acquire() {
+    if (!(middle.load(std::memory_order_relaxed) & kDirty)) return false;
+    uint8_t prev = middle.exchange(front, std::memory_order_acq_rel);
+    front = prev & kIndexMask;
+    return true;
+  }
+  const T& readSlot() const { return slots[front]; }
+  bool pending() const { return middle.load(std::memory_order_acquire) & kDirty; }
+
+private:
+  static constexpr uint8_t kDirty = 0x4;
+  static constexpr uint8_t kIndexMask = 0x3;
+
+  T slots[3] = {};
+  std::atomic<uint8_t> middle{1};
+  uint8_t back = 0;  // owned by producer
+  uint8_t front = 2; // owned by consumer
+};
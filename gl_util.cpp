@@ -0,0 +1,46 @@
+#include "gl_util.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Utility to load shader source from file
+std::string loadShaderSource(const char* filePath) {
+  std::ifstream file(filePath);
+  if (!file) {
+    std::cerr << "Failed to open shader file: " << filePath << "\n";
+    return "";
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+GLuint compileShader(GLenum type, const std::string& src) {
+  const char* s = src.c_str();
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &s, nullptr);
+  glCompileShader(shader);
+  return shader;
+}
+
+GLuint linkProgram(GLuint vtx, GLuint frag) {
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vtx);
+  glAttachShader(program, frag);
+  glLinkProgram(program);
+  return program;
+}
+
+GLuint loadProgram(const char* vertexPath, const char* fragmentPath) {
+  GLuint vtx = compileShader(GL_VERTEX_SHADER, loadShaderSource(vertexPath));
+  GLuint frag = compileShader(GL_FRAGMENT_SHADER, loadShaderSource(fragmentPath));
+  GLuint program = linkProgram(vtx, frag);
+  glDeleteShader(vtx);
+  glDeleteShader(frag);
+  return program;
+}
+
+void setBlendOver() {
+  glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+
+// Small GL helpers shared by the render thread and the map layers. All of
+// them need the GL context current on the calling thread.
+
+// Shader source from a file, or "" (with a message) if it can't be read
+std::string loadShaderSource(const char* filePath);
+GLuint compileShader(GLenum type, const std::string& src);
+GLuint linkProgram(GLuint vtx, GLuint frag);
+// Compiles, links and frees the two stages
+GLuint loadProgram(const char* vertexPath, const char* fragmentPath);
+
+// Source-over blending for everything drawn on the map. Alpha accumulates
+// the same way, so a layer drawn into a cleared target comes out
+// premultiplied (see LayerCompositor).
+void setBlendOver();
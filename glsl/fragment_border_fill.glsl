@@ -0,0 +1,9 @@
+#version 330 core
+out vec4 FragColor;
+flat in uint Feature;
+void main() {
+  // A stable colour per feature, faint enough to keep the map readable
+  uint h = Feature * 2654435761u;
+  vec3 c = vec3(float(h & 255u), float((h >> 8) & 255u), float((h >> 16) & 255u)) / 255.0;
+  FragColor = vec4(c, 0.12);
+}
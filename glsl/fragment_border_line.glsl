@@ -0,0 +1,9 @@
+#version 330 core
+out vec4 FragColor;
+in float Across;
+uniform float halfWidth;
+void main() {
+  // Coverage falls off over the outermost pixel
+  float coverage = clamp(halfWidth + 0.5 - abs(Across), 0.0, 1.0);
+  FragColor = vec4(0.12, 0.12, 0.16, 0.85 * coverage);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+// Premultiplied, the size of the viewport
+uniform sampler2D layer;
+void main() {
+  FragColor = texture(layer, TexCoord);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+uniform sampler2D density;
+uniform sampler1D ramp;
+uniform float intensity;
+void main() {
+  // Saturates smoothly instead of clipping where splats pile up
+  float t = 1.0 - exp(-2.0 * texture(density, TexCoord).r * intensity);
+  FragColor = texture(ramp, t);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 Offset;
+flat in float Weight;
+void main() {
+  // Gaussian with the quad's edge at 3 sigma
+  float d2 = dot(Offset, Offset);
+  if (d2 > 1.0) discard;
+  FragColor = vec4(Weight * exp(-4.5 * d2), 0.0, 0.0, 0.0);
+}
@@ -0,0 +1,43 @@
+#version 330 core
+out vec4 FragColor;
+// View coordinate; see projection.h
+in vec2 TexCoord;
+uniform sampler2D texture1;
+uniform usampler2D regionIds;
+uniform uint highlightRegion;
+// One texel per band of the music's spectrum; spectrumBands is 0 when off
+uniform sampler1D spectrum;
+uniform uint spectrumBands;
+// Projection enum, and for the ones without a closed-form inverse the map
+// coordinate at each view texel (buildInverseLut)
+uniform int projection;
+uniform sampler2D inverseLut;
+
+const float PI = 3.14159265358979;
+
+void main() {
+  vec2 uv = TexCoord;
+  if (projection == 1) {
+    // Web Mercator
+    uv.y = atan(sinh((TexCoord.y - 0.5) * 2.0 * PI)) / PI + 0.5;
+  } else if (projection == 2) {
+    // Robinson; the LUT runs on past the outline, so the map's edge is the
+    // outline
+    uv = texture(inverseLut, TexCoord).rg;
+  }
+  // Sampled everywhere and masked after, to keep derivatives well defined
+  bool onMap = all(greaterThanEqual(TexCoord, vec2(0.0))) && all(lessThanEqual(TexCoord, vec2(1.0))) &&
+               all(greaterThanEqual(uv, vec2(0.0))) && all(lessThanEqual(uv, vec2(1.0)));
+
+  FragColor = texture(texture1, uv);
+  uint id = texture(regionIds, uv).r;
+  // Each region pulses with one band of the music
+  if (id != 0u && spectrumBands != 0u) {
+    float level = texelFetch(spectrum, int(id % spectrumBands), 0).r;
+    FragColor.rgb = mix(FragColor.rgb, vec3(0.3, 0.7, 1.0), 0.25 * level);
+  }
+  // Tint the region under the kopi
+  if (highlightRegion != 0u && id == highlightRegion)
+    FragColor.rgb = mix(FragColor.rgb, vec3(1.0, 0.85, 0.3), 0.35);
+  if (!onMap) FragColor = vec4(0.0);
+}
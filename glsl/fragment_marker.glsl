@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 Offset;
+flat in float Radius;
+flat in float Count;
+void main() {
+  float d = length(Offset);
+  float coverage = clamp(Radius + 0.5 - d, 0.0, 1.0);
+  if (coverage <= 0.0) discard;
+  // Dark rim, then orange for single points and blue for clusters
+  vec3 fill = Count > 1.0 ? vec3(0.2, 0.45, 0.85) : vec3(0.95, 0.55, 0.15);
+  vec3 color = mix(fill, vec3(0.1), clamp(d - (Radius - 1.5), 0.0, 1.0));
+  FragColor = vec4(color, 0.9 * coverage);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+in vec4 Color;
+uniform sampler2D glyphs;
+void main() {
+  // 0.5 is the outline; keep the edge about one pixel wide at any size
+  float d = texture(glyphs, TexCoord).r;
+  float w = max(fwidth(d) * 0.7, 1.0 / 255.0);
+  float fill = smoothstep(0.5 - w, 0.5 + w, d);
+  // Dark halo so labels read over any part of the map
+  float halo = smoothstep(0.3 - w, 0.3 + w, d);
+  FragColor = vec4(mix(vec3(0.05), Color.rgb, fill), Color.a * halo);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+in vec3 TileCoord;
+in float Alpha;
+uniform sampler2DArray tiles;
+uniform usampler2D regionIds;
+uniform uint highlightRegion;
+// One texel per band of the music's spectrum; spectrumBands is 0 when off
+uniform sampler1D spectrum;
+uniform uint spectrumBands;
+void main() {
+  FragColor = vec4(texture(tiles, TileCoord).rgb, Alpha);
+  uint id = texture(regionIds, TexCoord).r;
+  // Same overlays as fragment_map.glsl
+  if (id != 0u && spectrumBands != 0u) {
+    float level = texelFetch(spectrum, int(id % spectrumBands), 0).r;
+    FragColor.rgb = mix(FragColor.rgb, vec3(0.3, 0.7, 1.0), 0.25 * level);
+  }
+  if (highlightRegion != 0u && id == highlightRegion)
+    FragColor.rgb = mix(FragColor.rgb, vec3(1.0, 0.85, 0.3), 0.35);
+}
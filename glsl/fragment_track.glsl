@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 Offset;
+flat in vec3 Color;
+uniform float radius;
+void main() {
+  float coverage = clamp(radius + 0.5 - length(Offset), 0.0, 1.0);
+  if (coverage <= 0.0) discard;
+  FragColor = vec4(Color, 0.9 * coverage);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in uint aFeature;
+flat out uint Feature;
+
+uniform float zoom;
+uniform vec2 pan;
+
+void main() {
+  gl_Position = vec4((aPos - 0.5 - pan) * zoom * 2.0, 0.0, 1.0);
+  Feature = aFeature;
+}
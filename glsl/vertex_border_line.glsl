@@ -0,0 +1,34 @@
+#version 330 core
+
+// x: 0 at the segment's start, 1 at its end; y: -1 or +1 across it
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec2 aP0;
+layout (location = 2) in vec2 aP1;
+out float Across;
+
+uniform float zoom;
+uniform vec2 pan;
+uniform vec2 viewport;
+uniform float halfWidth;
+
+void main() {
+  // A break point (negative) separates rings; no segment touches it
+  if (aP0.x < 0.0 || aP1.x < 0.0) {
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    Across = 0.0;
+    return;
+  }
+  // Work in pixels from the centre of the view so the width is constant
+  vec2 a = (aP0 - 0.5 - pan) * zoom * viewport;
+  vec2 b = (aP1 - 0.5 - pan) * zoom * viewport;
+  vec2 dir = b - a;
+  float len = length(dir);
+  dir = len > 0.0 ? dir / len : vec2(1.0, 0.0);
+  vec2 normal = vec2(-dir.y, dir.x);
+  // One extra pixel for the anti-aliased edge, and square ends so joints
+  // between segments have no gaps
+  float extent = halfWidth + 1.0;
+  vec2 p = mix(a, b, aCorner.x) + dir * (aCorner.x * 2.0 - 1.0) * halfWidth + normal * aCorner.y * extent;
+  Across = aCorner.y * extent;
+  gl_Position = vec4(p * 2.0 / viewport, 0.0, 1.0);
+}
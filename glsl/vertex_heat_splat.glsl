@@ -0,0 +1,21 @@
+#version 330 core
+
+layout (location = 0) in vec2 aCorner;
+// Per splat: centre in texture coordinates and weight
+layout (location = 1) in vec2 aCentre;
+layout (location = 2) in float aWeight;
+out vec2 Offset;
+flat out float Weight;
+
+uniform float zoom;
+uniform vec2 pan;
+uniform vec2 viewport;
+uniform float radius;
+
+void main() {
+  Offset = aCorner;
+  Weight = aWeight;
+  // Sized in full-resolution pixels, so the target's resolution doesn't matter
+  vec2 centre = (aCentre - 0.5 - pan) * zoom * 2.0;
+  gl_Position = vec4(centre + aCorner * radius * 2.0 / viewport, 0.0, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+// Per marker: position in texture coordinates and how many points it stands for
+layout (location = 2) in vec3 aMarker;
+out vec2 Offset;
+flat out float Radius;
+flat out float Count;
+
+uniform float zoom;
+uniform vec2 pan;
+uniform vec2 viewport;
+uniform float maxRadius;
+
+void main() {
+  // Single markers are small dots; clusters grow with the log of their count
+  Radius = aMarker.z > 1.0 ? min(7.0 + 2.0 * log2(aMarker.z), maxRadius) : 5.0;
+  Count = aMarker.z;
+  // One extra pixel for the anti-aliased edge
+  Offset = aPos * (Radius + 1.0);
+  vec2 centre = (aMarker.xy - 0.5 - pan) * zoom * 2.0;
+  gl_Position = vec4(centre + Offset * 2.0 / viewport, 0.0, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+layout (location = 0) in vec2 aCorner;
+// Per glyph: rectangle in pixels, atlas coordinates at its corners, colour
+layout (location = 1) in vec4 aRect;
+layout (location = 2) in vec4 aTexRect;
+layout (location = 3) in vec4 aColor;
+out vec2 TexCoord;
+out vec4 Color;
+
+uniform vec2 viewport;
+
+void main() {
+  vec2 p = mix(aRect.xy, aRect.zw, aCorner);
+  TexCoord = mix(aTexRect.xy, aTexRect.zw, aCorner);
+  Color = aColor;
+  gl_Position = vec4(p * 2.0 / viewport - 1.0, 0.0, 1.0);
+}
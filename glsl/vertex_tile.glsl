@@ -0,0 +1,21 @@
+#version 330 core
+
+layout (location = 0) in vec2 aCorner;
+// Per tile: world rectangle, tile coordinates at its corners, layer and alpha
+layout (location = 1) in vec4 aRect;
+layout (location = 2) in vec4 aTileRect;
+layout (location = 3) in vec2 aLayerAlpha;
+out vec2 TexCoord;
+out vec3 TileCoord;
+out float Alpha;
+
+uniform float zoom;
+uniform vec2 pan;
+
+void main() {
+  // World coordinate, the same space vertex_map.glsl's TexCoord lives in
+  TexCoord = mix(aRect.xy, aRect.zw, aCorner);
+  gl_Position = vec4((TexCoord - 0.5 - pan) * zoom * 2.0, 0.0, 1.0);
+  TileCoord = vec3(mix(aTileRect.xy, aTileRect.zw, aCorner), aLayerAlpha.x);
+  Alpha = aLayerAlpha.y;
+}
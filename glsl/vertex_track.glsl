@@ -0,0 +1,29 @@
+#version 330 core
+
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+// Per sprite: position in texture coordinates and the id it belongs to
+layout (location = 2) in vec2 aPosition;
+layout (location = 3) in uint aId;
+out vec2 Offset;
+flat out vec3 Color;
+
+uniform float zoom;
+uniform vec2 pan;
+uniform vec2 viewport;
+uniform float radius;
+
+vec3 hue(float h) {
+  return clamp(abs(mod(h * 6.0 + vec3(0.0, 4.0, 2.0), 6.0) - 3.0) - 1.0, 0.0, 1.0);
+}
+
+void main() {
+  // Hash the id so neighbouring ids get unrelated colours
+  uint h = aId * 2654435761u;
+  h ^= h >> 16;
+  Color = mix(hue(float(h & 1023u) / 1024.0), vec3(1.0), 0.25);
+  // One extra pixel for the anti-aliased edge
+  Offset = aPos * (radius + 1.0);
+  vec2 centre = (aPosition - 0.5 - pan) * zoom * 2.0;
+  gl_Position = vec4(centre + Offset * 2.0 / viewport, 0.0, 1.0);
+}
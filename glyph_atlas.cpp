@@ -0,0 +1,189 @@
+#include "glyph_atlas.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+constexpr float kInf = 1e20f;
+
+// Squared distance transform of f[0..n) taken `stride` apart, in place
+// (Felzenszwalb and Huttenlocher, lower envelope of parabolas)
+static void edt1d(float* f, int n, int stride, float* d, int* v, float* z) {
+  int k = 0;
+  v[0] = 0;
+  z[0] = -kInf;
+  z[1] = kInf;
+  for (int q = 1; q < n; ++q) {
+    float fq = f[q * stride] + static_cast<float>(q * q);
+    float s;
+    for (;;) {
+      int r = v[k];
+      s = (fq - f[r * stride] - static_cast<float>(r * r)) / (2.0f * (q - r));
+      // z[0] is -inf, so this always stops by k == 0
+      if (s > z[k]) break;
+      --k;
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = kInf;
+  }
+  for (int q = 0, j = 0; q < n; ++q) {
+    while (z[j + 1] < q) ++j;
+    float dq = static_cast<float>(q - v[j]);
+    d[q] = dq * dq + f[v[j] * stride];
+  }
+  for (int q = 0; q < n; ++q) f[q * stride] = d[q];
+}
+
+void GlyphAtlas::edt(std::vector<float>& grid, int w, int h) {
+  int n = std::max(w, h);
+  scratchD.resize(n);
+  scratchV.resize(n);
+  scratchZ.resize(n + 1);
+  for (int x = 0; x < w; ++x) edt1d(&grid[x], h, w, scratchD.data(), scratchV.data(), scratchZ.data());
+  for (int y = 0; y < h; ++y)
+    edt1d(&grid[static_cast<size_t>(y) * w], w, 1, scratchD.data(), scratchV.data(), scratchZ.data());
+}
+
+bool GlyphAtlas::init(const char* fontPath) {
+  if (FT_Init_FreeType(&library) != 0) {
+    std::cerr << "Failed to initialize FreeType\n";
+    library = nullptr;
+    return false;
+  }
+  if (FT_New_Face(library, fontPath, 0, &face) != 0 || FT_Set_Pixel_Sizes(face, 0, kGlyphPx) != 0) {
+    std::cerr << "Failed to load font: " << fontPath << "\n";
+    release();
+    return false;
+  }
+  kerns = FT_HAS_KERNING(face);
+  ascender = face->size->metrics.ascender / 64.0f;
+  descender = face->size->metrics.descender / 64.0f;
+
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  // Zero is "far outside", so unused texels never show
+  std::vector<uint8_t> empty(static_cast<size_t>(kAtlasSize) * kAtlasSize, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, kAtlasSize, kAtlasSize, 0, GL_RED, GL_UNSIGNED_BYTE, empty.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  return true;
+}
+
+void GlyphAtlas::release() {
+  glDeleteTextures(1, &texture);
+  texture = 0;
+  if (face) FT_Done_Face(face);
+  if (library) FT_Done_FreeType(library);
+  face = nullptr;
+  library = nullptr;
+  glyphs.clear();
+  ids.clear();
+  std::fill(std::begin(slots), std::end(slots), Slot());
+}
+
+uint32_t GlyphAtlas::glyphId(uint32_t codepoint) {
+  auto it = ids.find(codepoint);
+  if (it != ids.end()) return it->second;
+
+  Glyph g;
+  g.codepoint = codepoint;
+  // Missing characters get the font's .notdef box
+  g.index = FT_Get_Char_Index(face, codepoint);
+  if (FT_Load_Glyph(face, g.index, FT_LOAD_NO_HINTING) == 0) g.advance = face->glyph->advance.x / 64.0f;
+  uint32_t id = static_cast<uint32_t>(glyphs.size());
+  glyphs.push_back(g);
+  ids.emplace(codepoint, id);
+  return id;
+}
+
+float GlyphAtlas::kerning(uint32_t left, uint32_t right) const {
+  if (!kerns) return 0.0f;
+  FT_Vector k;
+  if (FT_Get_Kerning(face, glyphs[left].index, glyphs[right].index, FT_KERNING_UNFITTED, &k) != 0) return 0.0f;
+  return k.x / 64.0f;
+}
+
+int GlyphAtlas::acquire(uint32_t id) {
+  Glyph& g = glyphs[id];
+  if (g.slot >= 0) {
+    slots[g.slot].lastUsed = frame;
+    return g.slot;
+  }
+  // Free cell, else the one unused for longest, never one used this frame
+  int best = -1;
+  for (int i = 0; i < kSlots; ++i) {
+    if (slots[i].glyph < 0) {
+      best = i;
+      break;
+    }
+    if (slots[i].lastUsed == frame) continue;
+    if (best < 0 || slots[i].lastUsed < slots[best].lastUsed) best = i;
+  }
+  if (best < 0) return -1;
+  if (slots[best].glyph >= 0) glyphs[slots[best].glyph].slot = -1;
+  slots[best] = {static_cast<int>(id), frame};
+  g.slot = best;
+  // A glyph with no outline (a space) just takes the cell
+  rasterize(g, best);
+  return best;
+}
+
+bool GlyphAtlas::rasterize(Glyph& g, int slot) {
+  g.width = g.height = 0;
+  if (FT_Load_Glyph(face, g.index, FT_LOAD_NO_HINTING) != 0 ||
+      FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL) != 0)
+    return false;
+  const FT_Bitmap& bitmap = face->glyph->bitmap;
+  int bw = static_cast<int>(bitmap.width), bh = static_cast<int>(bitmap.rows);
+  if (bw == 0 || bh == 0) return true;
+
+  // Coverage into two distance fields, to the outside and to the inside,
+  // with partly covered pixels placing the edge inside the pixel (as in
+  // Mapbox's TinySDF). The bitmap is padded by the spread all round.
+  int w = std::min(bw + 2 * kSpreadPx, kCellSize), h = std::min(bh + 2 * kSpreadPx, kCellSize);
+  outside.assign(static_cast<size_t>(w) * h, kInf);
+  inside.assign(static_cast<size_t>(w) * h, 0.0f);
+  for (int y = 0; y < bh && y + kSpreadPx < h; ++y) {
+    for (int x = 0; x < bw && x + kSpreadPx < w; ++x) {
+      float a = bitmap.buffer[y * bitmap.pitch + x] / 255.0f;
+      size_t i = static_cast<size_t>(y + kSpreadPx) * w + x + kSpreadPx;
+      if (a >= 1.0f) {
+        outside[i] = 0.0f;
+        inside[i] = kInf;
+      } else if (a > 0.0f) {
+        float d = 0.5f - a;
+        outside[i] = d > 0.0f ? d * d : 0.0f;
+        inside[i] = d < 0.0f ? d * d : 0.0f;
+      }
+    }
+  }
+  edt(outside, w, h);
+  edt(inside, w, h);
+  texels.resize(static_cast<size_t>(w) * h);
+  for (size_t i = 0; i < texels.size(); ++i) {
+    float dist = std::sqrt(outside[i]) - std::sqrt(inside[i]);
+    float v = 0.5f - dist / (2.0f * kSpreadPx);
+    texels[i] = static_cast<uint8_t>(std::lround(std::min(std::max(v, 0.0f), 1.0f) * 255.0f));
+  }
+  g.left = static_cast<float>(face->glyph->bitmap_left - kSpreadPx);
+  g.top = static_cast<float>(face->glyph->bitmap_top + kSpreadPx);
+  g.width = w;
+  g.height = h;
+
+  // Rows go in top first, as FreeType has them
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % kCellsPerRow) * kCellSize, (slot / kCellsPerRow) * kCellSize, w, h,
+                  GL_RED, GL_UNSIGNED_BYTE, texels.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct FT_LibraryRec_;
+struct FT_FaceRec_;
+
+// Signed-distance-field glyphs from one font, rasterized on first use into
+// fixed cells of a single-channel atlas texture. FreeType only draws the
+// coverage bitmap; the distance field comes from a linear-time Euclidean
+// distance transform, which is some forty times faster than FreeType's
+// own SDF renderer and keeps new glyphs from stalling a frame. Glyphs are
+// rendered once at kGlyphPx and drawn at any size from there. When every
+// cell is taken, the least recently used glyph gives up its cell; its
+// metrics stay, so only the bitmap has to be rendered again.
+//
+// Distances are stored with 0.5 on the outline, growing inwards, and reach
+// kSpreadPx either side of it.
+//
+// Render thread only, with the GL context current.
+class GlyphAtlas {
+public:
+  static constexpr int kAtlasSize = 1024;
+  static constexpr int kCellSize = 64;
+  static constexpr int kCellsPerRow = kAtlasSize / kCellSize;
+  static constexpr int kSlots = kCellsPerRow * kCellsPerRow;
+  static constexpr int kGlyphPx = 32;
+  static constexpr int kSpreadPx = 6;
+
+  // All in pixels at kGlyphPx, y up
+  struct Glyph {
+    uint32_t codepoint = 0;
+    unsigned index = 0;    // in the font
+    float advance = 0.0f;
+    float left = 0.0f, top = 0.0f; // bitmap corner relative to the pen
+    int width = 0, height = 0;     // bitmap, clipped to a cell
+    int slot = -1;                 // atlas cell, -1 when not resident
+  };
+
+  // False (with a message) if the font can't be loaded
+  bool init(const char* fontPath);
+  void release();
+  bool enabled() const { return texture != 0; }
+
+  // Stable id of the glyph for `codepoint`, loading its metrics on first use
+  uint32_t glyphId(uint32_t codepoint);
+  const Glyph& glyph(uint32_t id) const { return glyphs[id]; }
+  // Pen adjustment between two glyph ids, in pixels at kGlyphPx
+  float kerning(uint32_t left, uint32_t right) const;
+
+  // Cell of the glyph for this frame, rasterizing it if it isn't resident;
+  // -1 if every cell is already in use this frame
+  int acquire(uint32_t id);
+  // Glyphs acquired before this may be evicted after it
+  void nextFrame() { ++frame; }
+
+  GLuint atlasTexture() const { return texture; }
+  float ascender = 0.0f, descender = 0.0f; // pixels at kGlyphPx, descender < 0
+
+private:
+  struct Slot {
+    int glyph = -1;
+    uint64_t lastUsed = 0;
+  };
+
+  bool rasterize(Glyph& g, int slot);
+  // Squared Euclidean distance transform of a w x h grid, in place
+  void edt(std::vector<float>& grid, int w, int h);
+
+  FT_LibraryRec_* library = nullptr;
+  FT_FaceRec_* face = nullptr;
+  bool kerns = false;
+  GLuint texture = 0;
+  std::vector<Glyph> glyphs;
+  std::unordered_map<uint32_t, uint32_t> ids; // codepoint -> glyphs index
+  Slot slots[kSlots];
+  uint64_t frame = 1;
+  // Rasterization scratch
+  std::vector<float> outside, inside, scratchD, scratchZ;
+  std::vector<int> scratchV;
+  std::vector<uint8_t> texels;
+};
@@ -0,0 +1,203 @@
+#include "heatmap_layer.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+
+// Unit quad as a strip, centred on the splat
+constexpr float kSplatCorners[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+constexpr int kRampSize = 256;
+
+// Transparent where there is nothing, through blue and green to red
+struct RampStop {
+  float at, r, g, b, a;
+};
+constexpr RampStop kRamp[] = {
+  {0.00f, 0.0f, 0.0f, 1.0f, 0.0f},  {0.25f, 0.0f, 0.3f, 1.0f, 0.45f}, {0.45f, 0.0f, 0.9f, 0.9f, 0.6f},
+  {0.65f, 0.3f, 1.0f, 0.2f, 0.7f},  {0.85f, 1.0f, 0.85f, 0.0f, 0.8f}, {1.00f, 1.0f, 0.15f, 0.0f, 0.85f},
+};
+
+static GLuint makeRampTexture() {
+  uint8_t texels[kRampSize * 4];
+  for (int i = 0; i < kRampSize; ++i) {
+    float t = static_cast<float>(i) / (kRampSize - 1);
+    size_t s = 1;
+    while (s + 1 < std::size(kRamp) && kRamp[s].at < t) ++s;
+    const RampStop& a = kRamp[s - 1];
+    const RampStop& b = kRamp[s];
+    float f = std::min(std::max((t - a.at) / (b.at - a.at), 0.0f), 1.0f);
+    float rgba[4] = {a.r + (b.r - a.r) * f, a.g + (b.g - a.g) * f, a.b + (b.b - a.b) * f, a.a + (b.a - a.a) * f};
+    for (int c = 0; c < 4; ++c) texels[i * 4 + c] = static_cast<uint8_t>(std::lround(rgba[c] * 255.0f));
+  }
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_1D, texture);
+  glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, kRampSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+  return texture;
+}
+
+bool HeatmapLayer::init(const char* path) {
+  if (!set.load(path)) return false;
+
+  // A splat is a cluster node at the clustering level, or a single point
+  // drawn above it; deeper nodes weigh no more than their ancestor there
+  float heaviestPoint = 0.0f;
+  for (const MarkerPoint& p : set.points) heaviestPoint = std::max(heaviestPoint, p.weight);
+  for (float& h : heaviest) h = heaviestPoint;
+  for (const MarkerSet::Node& n : set.nodes) heaviest[n.level] = std::max(heaviest[n.level], n.weight);
+
+  splatProgram = loadProgram("glsl/vertex_heat_splat.glsl", "glsl/fragment_heat_splat.glsl");
+  colorProgram = loadProgram("glsl/vertex_heat.glsl", "glsl/fragment_heat.glsl");
+  splatZoomLoc = glGetUniformLocation(splatProgram, "zoom");
+  splatPanLoc = glGetUniformLocation(splatProgram, "pan");
+  splatViewportLoc = glGetUniformLocation(splatProgram, "viewport");
+  splatRadiusLoc = glGetUniformLocation(splatProgram, "radius");
+  intensityLoc = glGetUniformLocation(colorProgram, "intensity");
+  glUseProgram(colorProgram);
+  glUniform1i(glGetUniformLocation(colorProgram, "density"), 0);
+  glUniform1i(glGetUniformLocation(colorProgram, "ramp"), 3);
+
+  glGenVertexArrays(1, &splatVAO);
+  glGenBuffers(1, &quadVBO);
+  glGenBuffers(1, &instanceVBO);
+  glBindVertexArray(splatVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kSplatCorners), kSplatCorners, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  glBufferData(GL_ARRAY_BUFFER, kMaxSplats * sizeof(MarkerInstance), nullptr, GL_STREAM_DRAW);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(MarkerInstance), (void*)offsetof(MarkerInstance, u));
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(MarkerInstance), (void*)offsetof(MarkerInstance, weight));
+  for (int a = 1; a <= 2; ++a) {
+    glEnableVertexAttribArray(a);
+    glVertexAttribDivisor(a, 1);
+  }
+  // The full-screen pass makes its triangle from gl_VertexID
+  glGenVertexArrays(1, &screenVAO);
+  glBindVertexArray(0);
+
+  ramp = makeRampTexture();
+  glGenFramebuffers(1, &fbo);
+  GLint viewport[4], target;
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+  resize(viewport[2], viewport[3]);
+  bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER, target);
+  if (!complete) {
+    std::cerr << "Heatmap target is not renderable; heatmap disabled\n";
+    release();
+    return false;
+  }
+
+  splats.reserve(kMaxSplats);
+  return true;
+}
+
+void HeatmapLayer::release() {
+  glDeleteVertexArrays(1, &splatVAO);
+  glDeleteVertexArrays(1, &screenVAO);
+  glDeleteBuffers(1, &quadVBO);
+  glDeleteBuffers(1, &instanceVBO);
+  glDeleteFramebuffers(1, &fbo);
+  glDeleteTextures(1, &density);
+  glDeleteTextures(1, &ramp);
+  glDeleteProgram(splatProgram);
+  glDeleteProgram(colorProgram);
+  splatVAO = screenVAO = quadVBO = instanceVBO = fbo = density = ramp = 0;
+  splatProgram = colorProgram = 0;
+  valid = false;
+}
+
+void HeatmapLayer::resize(int width, int height) {
+  targetW = std::max(1, width / kDownsample);
+  targetH = std::max(1, height / kDownsample);
+  glDeleteTextures(1, &density);
+  glGenTextures(1, &density);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, density);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // Bilinear on the way back up to full resolution
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, targetW, targetH, 0, GL_RED, GL_FLOAT, nullptr);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, density, 0);
+  valid = false;
+}
+
+void HeatmapLayer::accumulate(float zoom, float panX, float panY, const GLint viewport[4]) {
+  float pixelsPerUnit = zoom * std::max(viewport[2], viewport[3]);
+  float clusterSize = kClusterPx / pixelsPerUnit;
+  // Splats centred just off screen still reach into it
+  float margin = kRadiusPx / (zoom * std::max(1, std::min(viewport[2], viewport[3])));
+  float half = 0.5f / zoom + margin;
+  splats.clear();
+  set.query(0.5f + panX - half, 0.5f + panY - half, 0.5f + panX + half, 0.5f + panY + half, clusterSize, splats,
+            kMaxSplats);
+  // query() clusters the first level whose nodes are under clusterSize;
+  // that level's heaviest possible splat peaks near the top of the ramp
+  int level = 0;
+  while (level < MarkerSet::kMaxDepth && 1.0f / static_cast<float>(1u << level) >= clusterSize) ++level;
+  intensity = heaviest[level] > 0.0f ? 1.0f / heaviest[level] : 0.0f;
+
+  static const float kZero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  // Drawn into whatever target the caller has bound, e.g. a cached layer
+  GLint target;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glViewport(0, 0, targetW, targetH);
+  glClearBufferfv(GL_COLOR, 0, kZero);
+  if (!splats.empty()) {
+    glBlendFunc(GL_ONE, GL_ONE);
+    glUseProgram(splatProgram);
+    glUniform1f(splatZoomLoc, zoom);
+    glUniform2f(splatPanLoc, panX, panY);
+    glUniform2f(splatViewportLoc, static_cast<float>(viewport[2]), static_cast<float>(viewport[3]));
+    glUniform1f(splatRadiusLoc, kRadiusPx);
+    glBindVertexArray(splatVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, kMaxSplats * sizeof(MarkerInstance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, splats.size() * sizeof(MarkerInstance), splats.data());
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(splats.size()));
+    setBlendOver();
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, target);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+  valid = true;
+  lastZoom = zoom;
+  lastPanX = panX;
+  lastPanY = panY;
+}
+
+void HeatmapLayer::draw(float zoom, float panX, float panY) {
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  if (std::max(1, viewport[2] / kDownsample) != targetW || std::max(1, viewport[3] / kDownsample) != targetH) {
+    GLint target;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+    resize(viewport[2], viewport[3]);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+  }
+  if (!valid || zoom != lastZoom || panX != lastPanX || panY != lastPanY) accumulate(zoom, panX, panY, viewport);
+
+  glUseProgram(colorProgram);
+  glUniform1f(intensityLoc, intensity);
+  glActiveTexture(GL_TEXTURE3);
+  glBindTexture(GL_TEXTURE_1D, ramp);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, density);
+  glBindVertexArray(screenVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(0);
+}
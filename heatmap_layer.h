@@ -0,0 +1,59 @@
+#pragma once
+
+#include "markers.h"
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// Draws a MarkerSet's weights as a density heatmap. Clusters from the
+// quadtree, a fraction of the kernel across, are splatted as Gaussians into
+// a half-resolution float target with additive blending; a full-screen pass
+// then maps density through a 1D colour ramp and blends it over the map.
+//
+// Density is normalised by the heaviest cluster the quadtree has at the
+// level being drawn, not by what happens to be in view, so a place keeps
+// its colour while panning and each zoom level has a fixed scale.
+//
+// The splat pass only runs when the camera or the viewport changes. Any
+// other redraw reuses the accumulated target and costs one full-screen quad.
+// Both passes leave the caller's framebuffer, viewport and blending as they
+// found them.
+//
+// Render thread only, with the GL context current.
+class HeatmapLayer {
+public:
+  static constexpr float kRadiusPx = 40.0f;  // kernel cut-off, 3 sigma
+  static constexpr float kClusterPx = 16.0f; // points this close share a splat
+  static constexpr int kDownsample = 2;
+  static constexpr size_t kMaxSplats = 32768;
+
+  // False if there is no marker file at `path`
+  bool init(const char* path);
+  void release();
+  bool enabled() const { return colorProgram != 0; }
+
+  void draw(float zoom, float panX, float panY);
+
+private:
+  // (Re)creates the density target for a viewport of width x height
+  void resize(int width, int height);
+  void accumulate(float zoom, float panX, float panY, const GLint viewport[4]);
+
+  MarkerSet set;
+  // Heaviest splat query() can return when clustering at each level
+  float heaviest[MarkerSet::kMaxDepth + 1] = {};
+  GLuint splatProgram = 0, colorProgram = 0;
+  GLuint splatVAO = 0, quadVBO = 0, instanceVBO = 0;
+  GLuint screenVAO = 0;
+  GLuint fbo = 0, density = 0, ramp = 0;
+  GLint splatZoomLoc = -1, splatPanLoc = -1, splatViewportLoc = -1, splatRadiusLoc = -1;
+  GLint intensityLoc = -1;
+  int targetW = 0, targetH = 0;
+  // Camera the target was accumulated for
+  bool valid = false;
+  float lastZoom = 0.0f, lastPanX = 0.0f, lastPanY = 0.0f;
+  float intensity = 1.0f;
+  // Per-accumulation scratch, reserved in init()
+  std::vector<MarkerInstance> splats;
+};
@@ -0,0 +1,224 @@
+#include "input_record.h"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+constexpr char kRecMagic[4] = {'K', 'R', 'E', 'C'};
+constexpr uint16_t kRecVersion = 4;
+
+template <typename T>
+void put(std::ofstream& out, T v) {
+  out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+bool get(const std::vector<char>& buf, size_t& pos, T& v) {
+  if (pos + sizeof(T) > buf.size()) return false;
+  std::memcpy(&v, buf.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+void fnv(uint64_t& h, const void* data, size_t size) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    h ^= p[i];
+    h *= 0x100000001b3ull;
+  }
+}
+
+void SimTrace::frameDone(const FramePacket& p) {
+  const float fields[] = { p.zoom, p.panX, p.panY, p.offX, p.offY, p.angle, p.aspect };
+  fnv(checksum, fields, sizeof(fields));
+  fnv(checksum, &p.highlightRegion, sizeof(p.highlightRegion));
+  fnv(checksum, &p.projection, sizeof(p.projection));
+  fnv(checksum, &p.playbackTime, sizeof(p.playbackTime));
+  for (int i = 0; i < p.drawCount; ++i) fnv(checksum, &p.draws[i].kind, sizeof(DrawKind));
+  ++frameCount;
+}
+
+void SimTrace::finish(const KopiState& k) {
+  offX = k.offX;
+  offY = k.offY;
+  panX = k.panX;
+  panY = k.panY;
+  zoom = k.zoom;
+  angle = k.angle;
+  lastQ = k.lastQ;
+}
+
+bool InputRecorder::open(const char* path, bool idleSkipping) {
+  out.open(path, std::ios::binary);
+  if (!out) {
+    std::cerr << "Failed to open recording for writing: " << path << "\n";
+    return false;
+  }
+  out.write(kRecMagic, sizeof(kRecMagic));
+  put(out, kRecVersion);
+  put<uint8_t>(out, idleSkipping);
+  return true;
+}
+
+void InputRecorder::add(const InputEvent& e) {
+  put<uint8_t>(out, e.type);
+  put(out, e.frame);
+  put(out, e.time);
+  switch (e.type) {
+  case EV_MOUSE_BUTTON:
+    put<uint8_t>(out, e.a);
+    put<uint8_t>(out, e.b);
+    put(out, e.x);
+    put(out, e.y);
+    break;
+  case EV_CURSOR_POS:
+    put(out, e.x);
+    put(out, e.y);
+    break;
+  case EV_KEY:
+    put<int16_t>(out, e.a);
+    put<uint8_t>(out, e.b);
+    break;
+  case EV_WINDOW_SIZE:
+    put<uint16_t>(out, e.a);
+    put<uint16_t>(out, e.b);
+    break;
+  case EV_SCROLL:
+    put(out, e.x);
+    put(out, e.y);
+    put(out, e.scroll);
+    break;
+  case EV_TICK:
+    put(out, e.x);
+    break;
+  case EV_END:
+    break;
+  }
+}
+
+bool InputRecorder::finish(const SimTrace& trace) {
+  put<uint8_t>(out, EV_END);
+  put(out, trace.frameCount);
+  put(out, trace.checksum);
+  put(out, trace.offX);
+  put(out, trace.offY);
+  put(out, trace.panX);
+  put(out, trace.panY);
+  put(out, trace.zoom);
+  put(out, trace.angle);
+  put<uint8_t>(out, trace.lastQ);
+  put<uint32_t>(out, trace.transitions.size());
+  for (const auto& t : trace.transitions) {
+    put(out, t.first);
+    put<uint8_t>(out, t.second);
+  }
+  out.close();
+  return !out.fail();
+}
+
+bool InputReplayer::load(const char* path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    std::cerr << "Failed to open recording: " << path << "\n";
+    return false;
+  }
+  std::vector<char> buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  size_t pos = sizeof(kRecMagic);
+  uint16_t version = 0;
+  uint8_t idleFlag = 0;
+  if (buf.size() < pos || std::memcmp(buf.data(), kRecMagic, pos) != 0 ||
+      !get(buf, pos, version) || version != kRecVersion || !get(buf, pos, idleFlag)) {
+    std::cerr << "Not a kopi input recording: " << path << "\n";
+    return false;
+  }
+  idleSkipping = idleFlag != 0;
+
+  bool ok = true;
+  while (ok) {
+    uint8_t type;
+    if (!get(buf, pos, type)) { ok = false; break; }
+    if (type == EV_END) break;
+    InputEvent e;
+    e.type = static_cast<InputEventType>(type);
+    ok = get(buf, pos, e.frame) && get(buf, pos, e.time);
+    switch (e.type) {
+    case EV_MOUSE_BUTTON: {
+      uint8_t button, action;
+      ok = ok && get(buf, pos, button) && get(buf, pos, action) && get(buf, pos, e.x) && get(buf, pos, e.y);
+      e.a = button;
+      e.b = action;
+      break;
+    }
+    case EV_CURSOR_POS:
+      ok = ok && get(buf, pos, e.x) && get(buf, pos, e.y);
+      break;
+    case EV_KEY: {
+      int16_t key;
+      uint8_t action;
+      ok = ok && get(buf, pos, key) && get(buf, pos, action);
+      e.a = key;
+      e.b = action;
+      break;
+    }
+    case EV_WINDOW_SIZE: {
+      uint16_t w, h;
+      ok = ok && get(buf, pos, w) && get(buf, pos, h);
+      e.a = w;
+      e.b = h;
+      break;
+    }
+    case EV_SCROLL:
+      ok = ok && get(buf, pos, e.x) && get(buf, pos, e.y) && get(buf, pos, e.scroll);
+      break;
+    case EV_TICK:
+      ok = ok && get(buf, pos, e.x);
+      break;
+    default:
+      ok = false;
+    }
+    if (ok) events.push_back(e);
+  }
+
+  uint8_t lastQ = 0;
+  uint32_t nTransitions = 0;
+  ok = ok && get(buf, pos, expected.frameCount) && get(buf, pos, expected.checksum) &&
+       get(buf, pos, expected.offX) && get(buf, pos, expected.offY) &&
+       get(buf, pos, expected.panX) && get(buf, pos, expected.panY) && get(buf, pos, expected.zoom) &&
+       get(buf, pos, expected.angle) && get(buf, pos, lastQ) && get(buf, pos, nTransitions);
+  expected.lastQ = static_cast<Quadrant>(lastQ);
+  for (uint32_t i = 0; ok && i < nTransitions; ++i) {
+    uint32_t frame = 0;
+    uint8_t q = 0;
+    ok = get(buf, pos, frame) && get(buf, pos, q);
+    if (ok) expected.transitions.emplace_back(frame, static_cast<Quadrant>(q));
+  }
+  if (!ok) {
+    std::cerr << "Truncated or corrupt recording: " << path << "\n";
+    return false;
+  }
+  return true;
+}
+
+float InputReplayer::nextEventTime(uint32_t frame) const {
+  if (next < events.size() && events[next].frame <= frame) return events[next].time;
+  return -1.0f;
+}
+
+bool InputReplayer::verify(const SimTrace& actual) const {
+  bool ok = true;
+  auto check = [&](bool same, const char* what) {
+    if (!same) {
+      std::cerr << "Replay mismatch: " << what << "\n";
+      ok = false;
+    }
+  };
+  check(actual.frameCount == expected.frameCount, "frame count");
+  check(actual.offX == expected.offX && actual.offY == expected.offY, "kopi position");
+  check(actual.panX == expected.panX && actual.panY == expected.panY, "map pan");
+  check(actual.zoom == expected.zoom, "map zoom");
+  check(actual.angle == expected.angle, "kopi angle");
+  check(actual.lastQ == expected.lastQ, "final quadrant");
+  check(actual.transitions == expected.transitions, "audio quadrant transitions");
+  check(actual.checksum == expected.checksum, "frame checksum");
+  return ok;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "frame_packet.h"
+#include "kopi.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum InputEventType: uint8_t {
+  EV_MOUSE_BUTTON = 1,
+  EV_CURSOR_POS   = 2,
+  EV_KEY          = 3,
+  EV_WINDOW_SIZE  = 4,
+  EV_SCROLL       = 5,
+  EV_TICK         = 6, // time passing while tracks play, x seconds
+  EV_END          = 0xFF
+};
+
+struct InputEvent {
+  InputEventType type = EV_END;
+  uint32_t frame = 0;  // simulation frame that first sees the event
+  float time = 0.0f;   // seconds since recording started
+  int32_t a = 0;       // button / key / width
+  int32_t b = 0;       // action / height
+  double x = 0.0, y = 0.0; // cursor position, kept exact for determinism
+  double scroll = 0.0;     // vertical wheel offset
+};
+
+// Everything a run produces that a replay must reproduce bit for bit
+struct SimTrace {
+  uint32_t frameCount = 0;
+  uint64_t checksum = 0xcbf29ce484222325ull; // FNV-1a over every frame packet
+  std::vector<std::pair<uint32_t, Quadrant>> transitions;
+  // Final state, filled in by finish()
+  float offX = 0.0f, offY = 0.0f;
+  float panX = 0.0f, panY = 0.0f;
+  float zoom = kDefaultZoom;
+  float angle = 0.0f;
+  Quadrant lastQ = TOP_RIGHT;
+
+  void quadrantChanged(Quadrant q) { transitions.emplace_back(frameCount, q); }
+  void frameDone(const FramePacket& p);
+  void finish(const KopiState& k);
+};
+
+// Writes the input stream to a compact binary file:
+//   "KREC" u16 version, u8 idle skipping, then events (u8 type, u32 frame, f32 time, payload),
+//   then EV_END and the SimTrace footer.
+class InputRecorder {
+public:
+  // idleSkipping: whether the run skips frames that change nothing
+  bool open(const char* path, bool idleSkipping);
+  void add(const InputEvent& e);
+  bool finish(const SimTrace& trace);
+
+private:
+  std::ofstream out;
+};
+
+class InputReplayer {
+public:
+  bool load(const char* path);
+
+  bool finished(uint32_t frame) const { return frame >= expected.frameCount; }
+  // Frame numbering depends on it, so replays must match the recording
+  bool idleSkipping = false;
+  // Recorded time of the next event due at or before `frame`, or -1 if none
+  float nextEventTime(uint32_t frame) const;
+  // Calls fn(event) for every event due at or before `frame`
+  template <typename F>
+  void dispatch(uint32_t frame, F&& fn) {
+    while (next < events.size() && events[next].frame <= frame) fn(events[next++]);
+  }
+
+  // Prints any mismatch against the recording; returns true if identical
+  bool verify(const SimTrace& actual) const;
+
+private:
+  std::vector<InputEvent> events;
+  size_t next = 0;
+  SimTrace expected;
+};
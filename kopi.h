@@ -0,0 +1,36 @@
+#pragma once
+
+#include "projection.h"
+
+#include <cstdint>
+
+// Kopi quad half-width and half-height
+constexpr float kKopiHalfW = 0.1f;
+constexpr float kKopiHalfH = 0.24f;
+
+// Map magnification at startup; the scroll wheel changes it from there
+constexpr float kDefaultZoom = 3.0f;
+
+enum Quadrant: uint8_t { TOP_RIGHT = 0, TOP_LEFT = 1, BOTTOM_LEFT = 2, BOTTOM_RIGHT = 3 };
+
+struct KopiState {
+  bool isPressed = false;
+  double lastX = 0.0f, lastY = 0.0f;
+  float offX = 0.0f, offY = 0.0f;
+  float panX = 0.0f, panY = 0.0f;
+  float zoom = kDefaultZoom;
+  Projection projection = PROJ_EQUIRECTANGULAR; // P cycles through them
+  float angle = 0.0f; // in radians
+  Quadrant lastQ = TOP_RIGHT;
+  uint16_t region = 0; // region under the kopi center, see RegionMap
+  // Track playback: space plays and pauses, [ and ] scrub
+  double playbackTime = 0.0;
+  bool playing = false;
+
+  Quadrant curQ() const {
+    if (offX >= 0 && offY >= 0) return TOP_RIGHT;
+    if (offX < 0 && offY >= 0)  return TOP_LEFT;
+    if (offX < 0 && offY < 0)   return BOTTOM_LEFT;
+    return BOTTOM_RIGHT;
+  }
+};
@@ -0,0 +1,134 @@
+#include "latency.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+double latencyNowMs() {
+  using namespace std::chrono;
+  static const steady_clock::time_point start = steady_clock::now();
+  return duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+LatencyHistogram::LatencyHistogram() : buckets(kBuckets + 1, 0) {}
+
+void LatencyHistogram::add(double ms) {
+  int b = static_cast<int>(std::max(ms, 0.0) / kBucketMs);
+  ++buckets[std::min(b, kBuckets)];
+  ++count;
+  maxMs = std::max(maxMs, ms);
+}
+
+double LatencyHistogram::percentile(double p) const {
+  if (count == 0) return 0.0;
+  uint64_t target = static_cast<uint64_t>(p * (count - 1)) + 1;
+  uint64_t seen = 0;
+  for (int i = 0; i <= kBuckets; ++i) {
+    seen += buckets[i];
+    if (seen >= target) return i == kBuckets ? maxMs : std::min((i + 1) * kBucketMs, maxMs);
+  }
+  return maxMs;
+}
+
+void LatencyHistogram::print(const char* name) const {
+  std::printf("  %-16s n=%-7llu p50=%6.2f  p90=%6.2f  p99=%6.2f  max=%6.2f ms\n",
+              name, static_cast<unsigned long long>(count),
+              percentile(0.5), percentile(0.9), percentile(0.99), maxMs);
+}
+
+void LatencyTracker::onInput() {
+  if (pending.inputCount < kMaxTrackedInputs)
+    pending.inputMs[pending.inputCount++] = latencyNowMs();
+  else
+    ++droppedInputs;
+}
+
+void LatencyTracker::stampFrame(LatencyStamps& s) {
+  s = pending;
+  s.simMs = latencyNowMs();
+  pending.inputCount = 0;
+}
+
+void LatencyTracker::initGL() {
+  if (!useGpuTimer) return;
+  GLint bits = 0;
+  glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+  if (bits == 0) {
+    std::cerr << "GL_TIMESTAMP queries unsupported, GPU latency disabled\n";
+    useGpuTimer = false;
+    return;
+  }
+  for (PendingGpu& g : gpuRing) glGenQueries(1, &g.query);
+  syncGpuClock();
+  gpuReady = true;
+}
+
+void LatencyTracker::syncGpuClock() {
+  GLint64 gpuNs = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpuNs);
+  gpuOffsetMs = latencyNowMs() - gpuNs / 1.0e6;
+}
+
+void LatencyTracker::frameSubmitted(const LatencyStamps& s) {
+  current = s;
+  submitMs = latencyNowMs();
+  if (!gpuReady || s.inputCount == 0) return;
+
+  PendingGpu& g = gpuRing[gpuNext];
+  if (g.inFlight) pollGpu(true);
+  glQueryCounter(g.query, GL_TIMESTAMP);
+  g.inFlight = true;
+  g.stamps = s;
+  gpuNext = (gpuNext + 1) % kGpuRing;
+}
+
+void LatencyTracker::frameSwapped() {
+  double swapMs = latencyNowMs();
+  for (int i = 0; i < current.inputCount; ++i) {
+    inputToSim.add(current.simMs - current.inputMs[i]);
+    total.add(swapMs - current.inputMs[i]);
+  }
+  if (current.inputCount > 0) {
+    simToSubmit.add(submitMs - current.simMs);
+    submitToSwap.add(swapMs - submitMs);
+  }
+  current.inputCount = 0;
+  if (gpuReady) pollGpu(false);
+}
+
+void LatencyTracker::pollGpu(bool wait) {
+  for (PendingGpu& g : gpuRing) {
+    if (!g.inFlight) continue;
+    GLint available = 0;
+    glGetQueryObjectiv(g.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available && !wait) continue;
+    GLuint64 gpuNs = 0;
+    glGetQueryObjectui64v(g.query, GL_QUERY_RESULT, &gpuNs);
+    double doneMs = gpuNs / 1.0e6 + gpuOffsetMs;
+    for (int i = 0; i < g.stamps.inputCount; ++i)
+      inputToGpu.add(doneMs - g.stamps.inputMs[i]);
+    g.inFlight = false;
+  }
+}
+
+void LatencyTracker::releaseGL() {
+  if (!gpuReady) return;
+  pollGpu(true);
+  for (PendingGpu& g : gpuRing) glDeleteQueries(1, &g.query);
+  gpuReady = false;
+}
+
+void LatencyTracker::printReport() const {
+  std::printf("Input-to-photon latency (per input event):\n");
+  inputToSim.print("input->sim");
+  simToSubmit.print("sim->submit");
+  submitToSwap.print("submit->swap");
+  total.print("input->swap");
+  if (useGpuTimer) inputToGpu.print("input->gpu done");
+  if (droppedInputs)
+    std::printf("  %llu input events not tracked (more than %d per frame)\n",
+                static_cast<unsigned long long>(droppedInputs), kMaxTrackedInputs);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Milliseconds on a steady clock shared by every thread
+double latencyNowMs();
+
+constexpr int kMaxTrackedInputs = 16;
+
+// Timestamps that travel with a frame packet from input to photon
+struct LatencyStamps {
+  int inputCount = 0;
+  double inputMs[kMaxTrackedInputs];
+  double simMs = 0.0;
+};
+
+// Fixed-bucket histogram, 0.1 ms resolution up to 200 ms
+class LatencyHistogram {
+public:
+  LatencyHistogram();
+  void add(double ms);
+  double percentile(double p) const;
+  void print(const char* name) const;
+
+private:
+  static constexpr double kBucketMs = 0.1;
+  static constexpr int kBuckets = 2000;
+  std::vector<uint32_t> buckets;
+  uint64_t count = 0;
+  double maxMs = 0.0;
+};
+
+// Input-to-photon latency measurement. Input timestamps are taken in the
+// GLFW callbacks on the main thread and copied into each frame packet; the
+// render thread closes them out at submission, swap and (optionally) GPU
+// completion using GL_TIMESTAMP queries.
+class LatencyTracker {
+public:
+  explicit LatencyTracker(bool useGpuTimer) : useGpuTimer(useGpuTimer) {}
+
+  // Main thread
+  void onInput();
+  void stampFrame(LatencyStamps& s);
+  // Input since the last frame changed nothing on screen; forget it
+  void dropPending() { pending.inputCount = 0; }
+
+  // Render thread, with the GL context current
+  void initGL();
+  void frameSubmitted(const LatencyStamps& s);
+  void frameSwapped();
+  void releaseGL();
+
+  // Call after the render thread has stopped
+  void printReport() const;
+
+private:
+  struct PendingGpu {
+    unsigned int query = 0;
+    bool inFlight = false;
+    LatencyStamps stamps;
+  };
+  static constexpr int kGpuRing = 4;
+
+  void pollGpu(bool wait);
+  void syncGpuClock();
+
+  bool useGpuTimer;
+  // Main thread only
+  LatencyStamps pending;
+  // Render thread only
+  LatencyStamps current;
+  double submitMs = 0.0;
+  PendingGpu gpuRing[kGpuRing];
+  int gpuNext = 0;
+  double gpuOffsetMs = 0.0; // CPU ms minus GPU ms
+  bool gpuReady = false;
+
+  LatencyHistogram inputToSim, simToSubmit, submitToSwap, inputToGpu, total;
+  uint64_t droppedInputs = 0;
+};
@@ -0,0 +1,159 @@
+#include "layer_compositor.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+static const float kTransparent[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+bool LayerCompositor::init(int layerCount) {
+  layers.assign(layerCount, Layer());
+  program = loadProgram("glsl/vertex_composite.glsl", "glsl/fragment_composite.glsl");
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "layer"), 0);
+  // The composite makes its triangle from gl_VertexID
+  glGenVertexArrays(1, &screenVAO);
+  glGenFramebuffers(1, &drawFbo);
+  glGenFramebuffers(1, &readFbo);
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  resize(viewport[2], viewport[3]);
+  glBindFramebuffer(GL_FRAMEBUFFER, drawFbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, spare, 0);
+  bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (!complete) {
+    std::cerr << "Layer target is not renderable; drawing layers uncached\n";
+    release();
+    layers.assign(layerCount, Layer());
+    return false;
+  }
+  return true;
+}
+
+void LayerCompositor::release() {
+  for (Layer& l : layers) {
+    glDeleteTextures(1, &l.texture);
+    l = Layer();
+  }
+  glDeleteTextures(1, &spare);
+  glDeleteFramebuffers(1, &drawFbo);
+  glDeleteFramebuffers(1, &readFbo);
+  glDeleteVertexArrays(1, &screenVAO);
+  glDeleteProgram(program);
+  spare = drawFbo = readFbo = screenVAO = program = 0;
+  width = height = 0;
+}
+
+GLuint LayerCompositor::makeTexture() const {
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // Read back one to one
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  return texture;
+}
+
+void LayerCompositor::resize(int w, int h) {
+  width = std::max(w, 1);
+  height = std::max(h, 1);
+  for (Layer& l : layers) {
+    glDeleteTextures(1, &l.texture);
+    l.texture = makeTexture();
+    l.valid = false;
+  }
+  glDeleteTextures(1, &spare);
+  spare = makeTexture();
+}
+
+void LayerCompositor::begin(float viewZoom, float viewPanX, float viewPanY) {
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  int w = std::max(viewport[2], 1), h = std::max(viewport[3], 1);
+  if (program && (w != width || h != height)) resize(w, h);
+  // Without targets this only snaps the pan
+  width = w;
+  height = h;
+  zoom = viewZoom;
+  originX = std::llround(static_cast<double>(viewPanX) * zoom * width);
+  originY = std::llround(static_cast<double>(viewPanY) * zoom * height);
+}
+
+float LayerCompositor::panX() const {
+  return static_cast<float>(static_cast<double>(originX) / (static_cast<double>(zoom) * width));
+}
+
+float LayerCompositor::panY() const {
+  return static_cast<float>(static_cast<double>(originY) / (static_cast<double>(zoom) * height));
+}
+
+void LayerCompositor::update(int i, bool scrollable, const DrawFn& draw) {
+  if (!program) {
+    draw(zoom, panX(), panY());
+    return;
+  }
+  Layer& l = layers[i];
+  // Content moves the other way to the camera
+  int64_t dx = originX - l.originX, dy = originY - l.originY;
+  bool sameZoom = l.valid && l.zoom == zoom;
+  if (sameZoom && dx == 0 && dy == 0) return;
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glViewport(0, 0, width, height);
+  glBindFramebuffer(GL_FRAMEBUFFER, drawFbo);
+  // Past half the view, drawing whole costs about what the strips would
+  if (scrollable && sameZoom && std::abs(dx) <= width / 2 && std::abs(dy) <= height / 2) {
+    int sx = static_cast<int>(dx), sy = static_cast<int>(dy);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, spare, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, l.texture, 0);
+    int x0 = std::max(sx, 0), x1 = width + std::min(sx, 0);
+    int y0 = std::max(sy, 0), y1 = height + std::min(sy, 0);
+    glBlitFramebuffer(x0, y0, x1, y1, x0 - sx, y0 - sy, x1 - sx, y1 - sy, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    std::swap(l.texture, spare);
+
+    // The corner both strips share is drawn twice, the second time whole
+    glEnable(GL_SCISSOR_TEST);
+    auto strip = [&](int x, int y, int w, int h) {
+      glScissor(x, y, w, h);
+      glClearBufferfv(GL_COLOR, 0, kTransparent);
+      draw(zoom, panX(), panY());
+    };
+    if (sx != 0) strip(sx > 0 ? width - sx : 0, 0, std::abs(sx), height);
+    if (sy != 0) strip(0, sy > 0 ? height - sy : 0, width, std::abs(sy));
+    glDisable(GL_SCISSOR_TEST);
+  } else {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, l.texture, 0);
+    glClearBufferfv(GL_COLOR, 0, kTransparent);
+    draw(zoom, panX(), panY());
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+  l.valid = true;
+  l.zoom = zoom;
+  l.originX = originX;
+  l.originY = originY;
+}
+
+void LayerCompositor::composite(int i) {
+  if (!program || !layers[i].valid) return;
+  glUseProgram(program);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, layers[i].texture);
+  glBindVertexArray(screenVAO);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  setBlendOver();
+  glBindVertexArray(0);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Keeps each layer of the map (the map itself, overlays, labels...) in its
+// own texture the size of the viewport and blends them onto the screen with
+// one full-screen triangle each. A layer is only drawn again when the camera
+// moves or it has been invalidated, so a frame where only the kopi moved
+// costs a few texture reads instead of resampling the map.
+//
+// After a small pan at the same zoom, a scrollable layer's texture is
+// shifted by a blit and only the newly exposed strips are drawn, scissored.
+// That only lines up if the pan moves by whole pixels, so the compositor
+// snaps it to the pixel grid and every layer is drawn at the snapped pan.
+//
+// Layers draw with the usual source-over blending (setBlendOver) into a
+// cleared texture, which leaves them premultiplied; the composite blends
+// them as such. Without a renderable target each update() draws straight
+// to the screen instead, as if there were no compositor.
+//
+// Render thread only, with the GL context current.
+class LayerCompositor {
+public:
+  // Draws a layer for the camera; the layer's target and viewport are bound.
+  // Called once per exposed strip after a scroll, so it should only draw:
+  // per-frame work belongs before update().
+  using DrawFn = std::function<void(float zoom, float panX, float panY)>;
+
+  bool init(int layerCount);
+  void release();
+
+  // Camera for this frame, with the viewport's size taken from GL
+  void begin(float zoom, float panX, float panY);
+  // Pan snapped to whole pixels, which every layer is drawn at
+  float panX() const;
+  float panY() const;
+
+  // The layer's image changed other than through the camera
+  void invalidate(int layer) { layers[layer].valid = false; }
+  // Brings the layer up to date with the camera, through `draw`. Layers
+  // whose image isn't just a function of the camera and their data (label
+  // placement), or that redo the whole view anyway (the heatmap's splats),
+  // aren't scrollable and are drawn whole.
+  void update(int layer, bool scrollable, const DrawFn& draw);
+  // Blends the layer onto the bound framebuffer
+  void composite(int layer);
+
+private:
+  struct Layer {
+    GLuint texture = 0;
+    bool valid = false;
+    // Camera it was drawn for
+    float zoom = 0.0f;
+    int64_t originX = 0, originY = 0;
+  };
+  // (Re)creates every layer's texture for a viewport of width x height
+  void resize(int width, int height);
+  GLuint makeTexture() const;
+
+  std::vector<Layer> layers;
+  // Scrolled layers are blitted into this, then swap textures with it
+  GLuint spare = 0;
+  GLuint drawFbo = 0, readFbo = 0;
+  GLuint program = 0, screenVAO = 0;
+  int width = 0, height = 0;
+  float zoom = 1.0f;
+  // Pan in whole pixels
+  int64_t originX = 0, originY = 0;
+};
@@ -1,101 +1,174 @@
-#include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include <stb_image.h>
 #include <miniaudio.h>
 
+#include "audio_assets.h"
+#include "audio_commands.h"
+#include "audio_control.h"
+#include "audio_device.h"
+#include "audio_vfs.h"
+#include "frame_pacer.h"
+#include "input_record.h"
+#include "kopi.h"
+#include "latency.h"
+#include "music_transitions.h"
+#include "offline_audio.h"
+#include "region_map.h"
+#include "render_thread.h"
+#include "spatial_audio.h"
+#include "spectrum.h"
+#include "tracks.h"
+#include "voice_manager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
-#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <future>
 #include <iostream>
-#include <sstream>
-
-// Utility to load shader source from file
-std::string loadShaderSource(const char* filePath) {
-  std::ifstream file(filePath);
-  if (!file) {
-    std::cerr << "Failed to open shader file: " << filePath << "\n";
-    return "";
-  }
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  return buffer.str();
-}
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 constexpr int kWindowW = 1200;
 constexpr int kWindowH = 600;
 
-// Fullscreen quad for world map (constexpr)
-constexpr float kMapVerts[] = {
-  // positions   // tex coords
-  -1.0f,  1.0f,  0.0f, 1.0f, // top-left
-  -1.0f, -1.0f,  0.0f, 0.0f, // bottom-left
-   1.0f, -1.0f,  1.0f, 0.0f, // bottom-right
-   1.0f,  1.0f,  1.0f, 1.0f  // top-right
-};
-
-// Kopi quad half-width and half-height
-constexpr float kKopiHalfW = 0.1f;
-constexpr float kKopiHalfH = 0.24f;
-
-// Quad for kopi (smaller, centered at offset, uses kKopiHalfW/kKopiHalfH)
-constexpr float kKopiVerts[] = {
-  // positions         // tex coords
-  -kKopiHalfW,  kKopiHalfH,  0.0f, 1.0f, // top-left
-  -kKopiHalfW, -kKopiHalfH,  0.0f, 0.0f, // bottom-left
-   kKopiHalfW, -kKopiHalfH,  1.0f, 0.0f, // bottom-right
-   kKopiHalfW,  kKopiHalfH,  1.0f, 1.0f  // top-right
+// Extension picked at startup by resolveAudioPath(), compressed first
+constexpr const char* kTrackFiles[] = {
+  "res/first",
+  "res/second",
+  "res/third",
+  "res/fourth"
 };
 
-constexpr unsigned int kIdxs[] = {
-  0, 1, 2,
-  0, 2, 3
-};
-
-enum Quadrant: uint8_t { TOP_RIGHT = 0, TOP_LEFT = 1, BOTTOM_LEFT = 2, BOTTOM_RIGHT = 3 };
-
-struct KopiState {
-  bool isPressed = false;
-  double lastX = 0.0f, lastY = 0.0f;
-  float offX = 0.0f, offY = 0.0f;
-  float panX = 0.0f, panY = 0.0f;
-  float angle = 0.0f; // in radians
-  Quadrant lastQ = TOP_RIGHT;
-
-  Quadrant curQ() const {
-    if (offX >= 0 && offY >= 0) return TOP_RIGHT;
-    if (offX < 0 && offY >= 0)  return TOP_LEFT;
-    if (offX < 0 && offY < 0)   return BOTTOM_LEFT;
-    return BOTTOM_RIGHT;
+// Tempo of each track above, used to put crossfades on the beat. Loaded
+// from the .tempo file shipped next to each track; unknown stays unsynced.
+static TrackTempo kTrackTempos[4];
+
+// Offline rendering (--render-audio) mixes a fixed amount of audio per
+// simulation frame instead of following a device clock
+constexpr ma_uint32 kOfflineSampleRate = 48000;
+constexpr ma_uint64 kOfflineFramesPerSimFrame = kOfflineSampleRate / 60;
+// Rendered after the last frame so a pending crossfade can finish
+constexpr ma_uint64 kOfflineTailFrames = kOfflineSampleRate;
+
+// Owned by the audio control thread once gAudioReady is set (the main
+// thread when rendering offline); other threads talk to them only through
+// kAudioQueue
+static AudioAssets kTracks;
+static MusicTransitions kMusic;
+static SpatialAudio kSpatial;
+static VoiceManager kVoices;
+// Region entry cue; the voice pool plays copies of it
+static ma_sound kEnterSfx;
+static bool kEnterSfxLoaded = false;
+static int kEnterPool = -1;
+// Only fed when the visualizer is on; publishes to the render thread
+static SpectrumAnalyzer kSpectrum;
+static AudioCommandQueue kAudioQueue;
+static AudioControlThread kAudioControl;
+// Created by us rather than the engine so its buffering can be tuned
+static AudioDevice kAudioDevice;
+static ma_resource_manager kResourceManager;
+// Holds AUDIO_ENCODED tracks for kResourceManager's job threads to stream from
+static AudioMemoryVfs kAudioVfs;
+std::atomic<bool> gAudioReady{false};
+
+void applyAudioCommand(const AudioCommand& c) {
+  switch (c.type) {
+  case CMD_START_TRACK: kMusic.start(c.track); break;
+  case CMD_TRANSITION:  kMusic.request(c.track); break;
+  case CMD_SET_VOLUME:  kTracks.setVolume(c.track, c.value); break;
+  case CMD_PREFETCH:    kTracks.prefetch(c.track); break;
+  case CMD_LISTENER:    kSpatial.setListener(c.value, c.value2); break;
+  case CMD_SFX:         kVoices.play(c.track, 0.0f, 0.0f, 0.0f, c.value); break;
   }
-};
+}
 
-constexpr char* kWavFiles[] = {
-  "res/first.wav",
-  "res/second.wav",
-  "res/third.wav",
-  "res/fourth.wav"
-};
+// Everything that may lock, seek or post resource-manager jobs, off the
+// real-time thread: on kAudioControl, or before each offline read
+// True while something still needs stepping without a new command
+bool audioControlStep() {
+  if (!gAudioReady.load(std::memory_order_acquire)) return false;
+  kAudioQueue.drain(applyAudioCommand);
+  kTracks.update();
+  kVoices.update();
+  return kTracks.pending() || kVoices.pending();
+}
 
-static ma_sound kSounds[4];
+// Runs on the audio thread at the end of every engine read; only lock-free
+// work belongs here
+void audio_process_callback(void*, float* pFramesOut, ma_uint64 frameCount) {
+  if (!gAudioReady.load(std::memory_order_acquire)) return;
+  // pFramesOut is the final mix for this read
+  kSpectrum.process(pFramesOut, frameCount);
+}
+// False in headless runs and when the audio engine failed to start
+bool gAudioEnabled = false;
+
+// Non-null when running with --latency
+LatencyTracker* gLatency = nullptr;
+// Non-null when running with --record / --replay
+InputRecorder* gRecorder = nullptr;
+InputReplayer* gReplay = nullptr;
+
+// Simulation frame counter and per-run trace used to verify replays
+uint32_t gSimFrame = 0;
+SimTrace gTrace;
+double gRecordStart = 0.0;
+
+// Window size in screen coordinates. Kept here rather than queried from GLFW
+// so that replays and headless runs see exactly what the recording saw.
+int gWinW = kWindowW;
+int gWinH = kWindowH;
+
+// Optional region index, loaded from res/regions.rid if present
+RegionMap gRegions;
+// Optional movement tracks, mapped from res/tracks.ktrk if present
+TrackSet gTracks;
+// True with --spatial once region emitters are playing
+bool gSpatialEnabled = false;
 
 void updateSound(KopiState* k) {
   Quadrant curQ = k->curQ();
   Quadrant lastQ = k->lastQ;
   if (curQ != lastQ) {
-    ma_sound_stop(&kSounds[lastQ]);
-    // Start sound from the beginning
-    ma_sound_seek_to_pcm_frame(&kSounds[curQ], 0);
-    ma_sound_start(&kSounds[curQ]);
+    // Crossfade on the next bar; repeated drops before then only retarget
+    if (gAudioEnabled) kAudioQueue.push(CMD_TRANSITION, curQ);
+    gTrace.quadrantChanged(curQ);
     k->lastQ = curQ;
   }
 }
 
+// The quadrant the kopi would enter by crossing the nearest axis
+Quadrant likelyNextQ(const KopiState& k) {
+  static const Quadrant kAcrossX[] = { TOP_LEFT, TOP_RIGHT, BOTTOM_RIGHT, BOTTOM_LEFT };
+  static const Quadrant kAcrossY[] = { BOTTOM_RIGHT, BOTTOM_LEFT, TOP_LEFT, TOP_RIGHT };
+  Quadrant q = k.curQ();
+  return std::fabs(k.offX) < std::fabs(k.offY) ? kAcrossX[q] : kAcrossY[q];
+}
+
+// While dragging, warm up whichever track the drop is most likely to start
+void prefetchLikelyTrack(const KopiState& k) {
+  static int prefetched = -1;
+  if (!gAudioEnabled || !k.isPressed) {
+    prefetched = -1;
+    return;
+  }
+  Quadrant q = k.curQ() != k.lastQ ? k.curQ() : likelyNextQ(k);
+  if (q != prefetched && q != k.lastQ) {
+    kAudioQueue.push(CMD_PREFETCH, q);
+    prefetched = q;
+  }
+}
+
 // Helper to check if mouse is inside kopi quad (NDC coordinates)
-bool isMouseInKopi(GLFWwindow* window, double xpos, double ypos, float xoff, float yoff, float angle = 0.0f) {
-  int winW, winH;
-  glfwGetWindowSize(window, &winW, &winH);
+bool isMouseInKopi(double xpos, double ypos, float xoff, float yoff, float angle = 0.0f) {
   // Convert window coordinates to NDC
-  float xNdc = (xpos / winW) * 2.0f - 1.0f;
-  float yNdc = 1.0f - (ypos / winH) * 2.0f;
+  float xNdc = (xpos / gWinW) * 2.0f - 1.0f;
+  float yNdc = 1.0f - (ypos / gWinH) * 2.0f;
 
   // Undo rotation for hit test
   float dx = xNdc - xoff;
@@ -109,14 +182,10 @@ bool isMouseInKopi(GLFWwindow* window, double xpos, double ypos, float xoff, flo
          yr >= -kKopiHalfH && yr <= kKopiHalfH;
 }
 
-// Mouse button callback
-void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
-  KopiState* k = static_cast<KopiState*>(glfwGetWindowUserPointer(window));
+void handleMouseButton(KopiState* k, int button, int action, double xpos, double ypos) {
   if (button == GLFW_MOUSE_BUTTON_LEFT) {
     if (action == GLFW_PRESS) {
-      double xpos, ypos;
-      glfwGetCursorPos(window, &xpos, &ypos);
-      if (isMouseInKopi(window, xpos, ypos, k->offX, k->offY, k->angle)) {
+      if (isMouseInKopi(xpos, ypos, k->offX, k->offY, k->angle)) {
         k->isPressed = true;
         k->lastX = xpos;
         k->lastY = ypos;
@@ -127,9 +196,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
     }
   }
   if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
-    double xpos, ypos;
-    glfwGetCursorPos(window, &xpos, &ypos);
-    if (isMouseInKopi(window, xpos, ypos, k->offX, k->offY, k->angle)) {
+    if (isMouseInKopi(xpos, ypos, k->offX, k->offY, k->angle)) {
       // Rotate 45 degrees clockwise
       k->angle += 3.14159265f / 4.0f;
       if (k->angle > 3.14159265f * 2.0f)
@@ -150,14 +217,10 @@ void clampKopiToWindow(KopiState* k) {
   if (k->offY > maxY) k->offY = maxY;
 }
 
-// Mouse move callback
-void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
-  KopiState* k = static_cast<KopiState*>(glfwGetWindowUserPointer(window));
+void handleCursorPos(KopiState* k, double xpos, double ypos) {
   if (k->isPressed) {
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
-    float dx = (xpos - k->lastX) / (width / 2.0f);
-    float dy = (k->lastY - ypos) / (height / 2.0f); // invert y
+    float dx = (xpos - k->lastX) / (gWinW / 2.0f);
+    float dy = (k->lastY - ypos) / (gWinH / 2.0f); // invert y
     k->offX += dx;
     k->offY += dy;
     k->lastX = xpos;
@@ -166,23 +229,174 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
   }
 }
 
+constexpr float kMinZoom = 1.0f;
+// Beyond this, float texture coordinates stop resolving single pixels
+constexpr float kMaxZoom = 4096.0f;
+// Zoom factor per wheel notch
+constexpr float kZoomStep = 1.25f;
+
+// Furthest the view centre may move from the map centre at `zoom`
+float panLimit(float zoom) {
+  return 0.5f - 0.5f / zoom;
+}
+
+// Zoom about the cursor: the map point under it stays put
+void handleScroll(KopiState* k, double xpos, double ypos, double offset) {
+  float zoom = std::clamp(k->zoom * std::pow(kZoomStep, static_cast<float>(offset)), kMinZoom, kMaxZoom);
+  float xNdc = (xpos / gWinW) * 2.0f - 1.0f;
+  float yNdc = 1.0f - (ypos / gWinH) * 2.0f;
+  k->panX += xNdc * 0.5f * (1.0f / k->zoom - 1.0f / zoom);
+  k->panY += yNdc * 0.5f * (1.0f / k->zoom - 1.0f / zoom);
+  k->zoom = zoom;
+  float limit = panLimit(zoom);
+  k->panX = std::clamp(k->panX, -limit, limit);
+  k->panY = std::clamp(k->panY, -limit, limit);
+}
+
+// Playing through all of the tracks takes this long whatever the frame
+// rate; a scrub step is this fraction of them
+constexpr double kPlaybackSeconds = 60.0;
+constexpr double kScrubStep = 0.02;
+// A stall, or the first frame after idling, doesn't jump the playback ahead
+constexpr double kMaxTickSeconds = 0.1;
+
+void scrubPlayback(KopiState* k, double fraction) {
+  double span = gTracks.endTime() - gTracks.startTime();
+  k->playbackTime = std::clamp(k->playbackTime + span * fraction, gTracks.startTime(), gTracks.endTime());
+}
+
+void advancePlayback(KopiState& k, double seconds) {
+  if (!k.playing) return;
+  scrubPlayback(&k, seconds / kPlaybackSeconds);
+  // Stop at the end rather than keep redrawing the last frame
+  if (k.playbackTime >= gTracks.endTime()) k.playing = false;
+}
+
 bool gMuted = false;
 
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+void handleKey(KopiState* k, int key, int action) {
+  if (action == GLFW_PRESS && key == GLFW_KEY_P) {
+    k->projection = static_cast<Projection>((k->projection + 1) % kProjectionCount);
+  }
+  if (!gTracks.empty() && action != GLFW_RELEASE) {
+    if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
+      // Playing from the end starts over
+      if (!k->playing && k->playbackTime >= gTracks.endTime()) k->playbackTime = gTracks.startTime();
+      k->playing = !k->playing;
+    }
+    if (key == GLFW_KEY_LEFT_BRACKET) scrubPlayback(k, -kScrubStep);
+    if (key == GLFW_KEY_RIGHT_BRACKET) scrubPlayback(k, kScrubStep);
+  }
   if (action == GLFW_PRESS && key == GLFW_KEY_M) {
     gMuted = !gMuted;
+    if (!gAudioEnabled) return;
     for (int i = 0; i < 4; ++i) {
-      ma_sound_set_volume(&kSounds[i], gMuted ? 0.0f : 1.0f);
+      kAudioQueue.push(CMD_SET_VOLUME, i, gMuted ? 0.0f : 1.0f);
     }
   }
 }
 
-constexpr float kZoom = 3.0f;
+void handleWindowSize(int width, int height) {
+  gWinW = std::max(width, 1);
+  gWinH = std::max(height, 1);
+}
+
+// Apply a recorded event exactly as the live callback would have
+void applyInputEvent(KopiState* k, const InputEvent& e) {
+  switch (e.type) {
+  case EV_MOUSE_BUTTON: handleMouseButton(k, e.a, e.b, e.x, e.y); break;
+  case EV_CURSOR_POS:   handleCursorPos(k, e.x, e.y); break;
+  case EV_KEY:          handleKey(k, e.a, e.b); break;
+  case EV_WINDOW_SIZE:  handleWindowSize(e.a, e.b); break;
+  case EV_SCROLL:       handleScroll(k, e.x, e.y, e.scroll); break;
+  case EV_TICK:         advancePlayback(*k, e.x); break;
+  case EV_END:          break;
+  }
+}
+
+// Shared front half of every GLFW input callback
+void onLiveInput(InputEvent e) {
+  if (gLatency) gLatency->onInput();
+  if (gRecorder) {
+    e.frame = gSimFrame;
+    e.time = static_cast<float>(glfwGetTime() - gRecordStart);
+    gRecorder->add(e);
+  }
+}
+
+// Mouse button callback
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+  // Input comes from the recording during replay
+  if (gReplay) return;
+  KopiState* k = static_cast<KopiState*>(glfwGetWindowUserPointer(window));
+  InputEvent e;
+  e.type = EV_MOUSE_BUTTON;
+  e.a = button;
+  e.b = action;
+  glfwGetCursorPos(window, &e.x, &e.y);
+  onLiveInput(e);
+  handleMouseButton(k, button, action, e.x, e.y);
+}
+
+// Mouse move callback
+void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
+  if (gReplay) return;
+  KopiState* k = static_cast<KopiState*>(glfwGetWindowUserPointer(window));
+  InputEvent e;
+  e.type = EV_CURSOR_POS;
+  e.x = xpos;
+  e.y = ypos;
+  onLiveInput(e);
+  handleCursorPos(k, xpos, ypos);
+}
+
+void scroll_callback(GLFWwindow* window, double, double yoffset) {
+  if (gReplay) return;
+  KopiState* k = static_cast<KopiState*>(glfwGetWindowUserPointer(window));
+  InputEvent e;
+  e.type = EV_SCROLL;
+  e.scroll = yoffset;
+  glfwGetCursorPos(window, &e.x, &e.y);
+  onLiveInput(e);
+  handleScroll(k, e.x, e.y, yoffset);
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+  if (gReplay) return;
+  KopiState* k = static_cast<KopiState*>(glfwGetWindowUserPointer(window));
+  InputEvent e;
+  e.type = EV_KEY;
+  e.a = key;
+  e.b = action;
+  onLiveInput(e);
+  handleKey(k, key, action);
+}
+
+void window_size_callback(GLFWwindow*, int width, int height) {
+  if (gReplay) return;
+  InputEvent e;
+  e.type = EV_WINDOW_SIZE;
+  e.a = width;
+  e.b = height;
+  onLiveInput(e);
+  handleWindowSize(width, height);
+}
+
+// Set when the window contents were damaged and must be redrawn even though
+// nothing changed (e.g. after being uncovered while idle)
+bool gNeedsRedraw = false;
+
+void window_refresh_callback(GLFWwindow*) {
+  gNeedsRedraw = true;
+}
+
+// Per frame at kDefaultZoom; scaled so the map scrolls at the same speed on
+// screen at any zoom
 constexpr float kPanStep = 0.01f;
 constexpr float kEdgeThr = 0.98f;
 
 void maybeAutoPan(KopiState& k) {
-  if (kZoom <= 1.0f) return;
+  if (k.zoom <= 1.0f) return;
 
   // Kopi quad bounds in NDC
   float kopiLeft   = k.offX - kKopiHalfW;
@@ -191,223 +405,462 @@ void maybeAutoPan(KopiState& k) {
   float kopiBottom = k.offY - kKopiHalfH;
 
   // Pan limits
-  const float panLimit = 1.0f / kZoom;
+  const float limit = panLimit(k.zoom);
+  const float step = kPanStep * (kDefaultZoom / k.zoom);
 
   // Pan right
-  if (kopiRight > kEdgeThr && k.panX < panLimit)
-    k.panX = std::min(k.panX + kPanStep, panLimit);
+  if (kopiRight > kEdgeThr && k.panX < limit)
+    k.panX = std::min(k.panX + step, limit);
   // Pan left
-  if (kopiLeft < -kEdgeThr && k.panX > -panLimit)
-    k.panX = std::max(k.panX - kPanStep, -panLimit);
+  if (kopiLeft < -kEdgeThr && k.panX > -limit)
+    k.panX = std::max(k.panX - step, -limit);
   // Pan up
-  if (kopiTop > kEdgeThr && k.panY < panLimit)
-    k.panY = std::min(k.panY + kPanStep, panLimit);
+  if (kopiTop > kEdgeThr && k.panY < limit)
+    k.panY = std::min(k.panY + step, limit);
   // Pan down
-  if (kopiBottom < -kEdgeThr && k.panY > -panLimit)
-    k.panY = std::max(k.panY - kPanStep, -panLimit);
+  if (kopiBottom < -kEdgeThr && k.panY > -limit)
+    k.panY = std::max(k.panY - step, -limit);
 }
 
-GLuint loadTexture(const char* path, int* outWidth = nullptr, int* outHeight = nullptr) {
-  int width, height, nrChannels;
-  stbi_set_flip_vertically_on_load(true);
-  unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-  if (!data) {
-    std::cerr << "Failed to load texture: " << path << "\n";
-    return 0;
-  }
-  GLuint texture;
-  glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  GLenum format = nrChannels == 4 ? GL_RGBA : GL_RGB;
-  glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-  glGenerateMipmap(GL_TEXTURE_2D);
-  stbi_image_free(data);
-  if (outWidth) *outWidth = width;
-  if (outHeight) *outHeight = height;
-  return texture;
+// O(1) region lookup under the kopi center
+void updateRegion(KopiState& k) {
+  if (gRegions.empty()) return;
+  float u, v;
+  // Off the edge of a projected map there is nothing to be over
+  bool onMap = ndcToMapUV(k.projection, k.offX, k.offY, k.zoom, k.panX, k.panY, &u, &v);
+  uint16_t region = onMap ? gRegions.at(u, v) : 0;
+  // Short cue on crossing into a region; quick crossings steal pool voices
+  if (region != k.region && region != 0 && gAudioEnabled) kAudioQueue.push(CMD_SFX, kEnterPool, 0.5f);
+  k.region = region;
 }
 
-int main() {
-  // Initialize miniaudio engine
-  ma_engine engine;
-  if (ma_engine_init(NULL, &engine) != MA_SUCCESS) {
-    std::cerr << "Failed to initialize miniaudio engine\n";
-    return -1;
-  }
+// The spatial listener rides on the kopi; only moves are sent
+void updateListener(const KopiState& k) {
+  static float lastU = -1.0f, lastV = -1.0f;
+  if (!gSpatialEnabled) return;
+  float u, v;
+  // Off the map the listener stays where it last was
+  if (!ndcToMapUV(k.projection, k.offX, k.offY, k.zoom, k.panX, k.panY, &u, &v)) return;
+  if (u == lastU && v == lastV) return;
+  kAudioQueue.push(CMD_LISTENER, -1, u, v);
+  lastU = u;
+  lastV = v;
+}
+
+// Snapshot the simulation state into the packet the render thread will draw
+void buildFramePacket(const KopiState& k, float aspect, FramePacket& p) {
+  p.zoom = k.zoom;
+  p.panX = k.panX;
+  p.panY = k.panY;
+  p.projection = k.projection;
+  p.offX = k.offX;
+  p.offY = k.offY;
+  p.angle = k.angle;
+  p.aspect = aspect;
+  p.highlightRegion = k.region;
+  p.playbackTime = k.playbackTime;
+  p.drawCount = 0;
+  p.push(DRAW_MAP);
+  p.push(DRAW_KOPI);
+}
+
+void printUsage() {
+  std::cerr << "Usage: hello [--latency | --latency-gpu]\n"
+               "             [--record <file> | --replay <file> [--fast] [--headless]]\n"
+               "             [--fps <n>] [--swap-interval <n>] [--adaptive-vsync] [--no-idle]\n"
+               "             [--audio-budget <MB>] [--audio-report] [--sync beat|bar]\n"
+               "             [--spatial] [--voices <n>] [--audio-bench]\n"
+               "             [--render-audio <file.wav>] (with --replay)\n"
+               "             [--audio-period <frames>] [--audio-periods <n>] [--audio-low-latency]\n"
+               "             [--audio-no-fixed-callback] [--visualizer] [--heatmap]\n";
+}
 
-  // Initialize wav files (static sounds array)
-  for (int i = 0; i < 4; ++i) {
-    if (ma_sound_init_from_file(&engine, kWavFiles[i], 0, NULL, NULL, &kSounds[i]) != MA_SUCCESS) {
-      std::cerr << "Failed to load " << kWavFiles[i] << "\n";
-      ma_engine_uninit(&engine);
+int main(int argc, char** argv) {
+  // Command line options
+  std::unique_ptr<LatencyTracker> latency;
+  const char* recordPath = nullptr;
+  const char* replayPath = nullptr;
+  bool fast = false;
+  bool headless = false;
+  FramePacingConfig pacing;
+  AudioAssetConfig audioConfig;
+  bool audioReport = false;
+  TransitionConfig transitionConfig;
+  bool spatial = false;
+  VoiceConfig voiceConfig;
+  const char* renderAudioPath = nullptr;
+  AudioDeviceConfig deviceConfig;
+  bool visualizer = false;
+  bool heatmap = false;
+  bool audioBench = false;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--latency")) {
+      latency = std::make_unique<LatencyTracker>(false);
+    } else if (!std::strcmp(argv[i], "--latency-gpu")) {
+      latency = std::make_unique<LatencyTracker>(true);
+    } else if (!std::strcmp(argv[i], "--record") && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (!std::strcmp(argv[i], "--replay") && i + 1 < argc) {
+      replayPath = argv[++i];
+    } else if (!std::strcmp(argv[i], "--fast")) {
+      fast = true;
+    } else if (!std::strcmp(argv[i], "--headless")) {
+      headless = true;
+    } else if (!std::strcmp(argv[i], "--fps") && i + 1 < argc) {
+      pacing.targetFps = std::atof(argv[++i]);
+    } else if (!std::strcmp(argv[i], "--swap-interval") && i + 1 < argc) {
+      pacing.swapInterval = std::max(0, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--adaptive-vsync")) {
+      pacing.adaptiveVsync = true;
+    } else if (!std::strcmp(argv[i], "--no-idle")) {
+      pacing.idle = false;
+    } else if (!std::strcmp(argv[i], "--audio-budget") && i + 1 < argc) {
+      audioConfig.memoryBudget = static_cast<size_t>(std::max(0.0, std::atof(argv[++i])) * (1 << 20));
+    } else if (!std::strcmp(argv[i], "--audio-report")) {
+      audioReport = true;
+    } else if (!std::strcmp(argv[i], "--sync") && i + 1 < argc &&
+               (!std::strcmp(argv[i + 1], "beat") || !std::strcmp(argv[i + 1], "bar"))) {
+      ++i;
+      transitionConfig.unit = !std::strcmp(argv[i], "beat") ? SYNC_BEAT : SYNC_BAR;
+    } else if (!std::strcmp(argv[i], "--spatial")) {
+      spatial = true;
+    } else if (!std::strcmp(argv[i], "--voices") && i + 1 < argc) {
+      voiceConfig.maxReal = std::max(1, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--render-audio") && i + 1 < argc) {
+      renderAudioPath = argv[++i];
+    } else if (!std::strcmp(argv[i], "--audio-period") && i + 1 < argc) {
+      deviceConfig.periodFrames = static_cast<ma_uint32>(std::max(0, std::atoi(argv[++i])));
+    } else if (!std::strcmp(argv[i], "--audio-periods") && i + 1 < argc) {
+      deviceConfig.periods = static_cast<ma_uint32>(std::max(0, std::atoi(argv[++i])));
+    } else if (!std::strcmp(argv[i], "--audio-low-latency")) {
+      deviceConfig.lowLatency = true;
+    } else if (!std::strcmp(argv[i], "--audio-no-fixed-callback")) {
+      deviceConfig.noFixedSizedCallback = true;
+    } else if (!std::strcmp(argv[i], "--visualizer")) {
+      visualizer = true;
+    } else if (!std::strcmp(argv[i], "--heatmap")) {
+      heatmap = true;
+    } else if (!std::strcmp(argv[i], "--audio-bench")) {
+      audioBench = true;
+    } else {
+      std::cerr << "Unknown option: " << argv[i] << "\n";
+      printUsage();
       return -1;
     }
-    ma_sound_set_looping(&kSounds[i], MA_TRUE);
   }
-  // Start the first sound by default
-  ma_sound_start(&kSounds[0]);
-
-  // Initialize GLFW
-  if (!glfwInit()) {
-    std::cerr << "Failed to initialize GLFW\n";
+  if ((recordPath && replayPath) || (headless && !replayPath) || (headless && latency) ||
+      (renderAudioPath && !replayPath)) {
+    printUsage();
     return -1;
   }
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-  // Create window
-  GLFWwindow* window = glfwCreateWindow(kWindowW, kWindowH, "World Map", nullptr, nullptr);
-  if (!window) {
-    std::cerr << "Failed to create GLFW window\n";
-    glfwTerminate();
-    return -1;
+  if (audioBench) {
+    // Offline; needs neither a window nor an audio device
+    runSpatialBench(std::cout);
+    return 0;
   }
-  glfwMakeContextCurrent(window);
+  gLatency = latency.get();
 
-  // Load OpenGL functions
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    std::cerr << "Failed to initialize GLAD\n";
-    return -1;
+  InputRecorder recorder;
+  InputReplayer replayer;
+  if (recordPath) {
+    if (!recorder.open(recordPath, pacing.idle)) return -1;
+    gRecorder = &recorder;
+  }
+  if (replayPath) {
+    if (!replayer.load(replayPath)) return -1;
+    gReplay = &replayer;
+    pacing.idle = replayer.idleSkipping;
+  } else if (visualizer) {
+    // The map keeps moving with the music even when the input doesn't
+    pacing.idle = false;
+  }
+
+  // Region emitters are placed from this, so it loads before audio starts
+  gRegions.load("res/regions.rid");
+  // Mapped, not read, so this is instant however large the file is
+  gTracks.open("res/tracks.ktrk");
+
+  // Initialize miniaudio engine and queue the tracks on a helper thread, so
+  // it overlaps with window and GL setup. Decoding itself runs on the
+  // resource manager's job threads.
+  ma_engine engine;
+  std::future<bool> audioInit;
+  int spatialEmitters = 0;
+  if (renderAudioPath) {
+    // Streamed pages arrive whenever the job thread gets to them, which
+    // would make the output timing-dependent; keep everything resident
+    audioConfig.memoryBudget = SIZE_MAX;
+    audioConfig.maxDecodedSize = SIZE_MAX;
+  }
+  std::vector<std::string> trackPaths;
+  std::vector<const char*> trackPathPtrs;
+  for (const char* base : kTrackFiles) trackPaths.push_back(resolveAudioPath(base));
+  for (int i = 0; i < 4; ++i) loadTrackTempo(kTrackFiles[i], &kTrackTempos[i]);
+  for (const std::string& path : trackPaths) trackPathPtrs.push_back(path.c_str());
+  bool ownResourceManager = false;
+  if (!headless || renderAudioPath) {
+    audioInit = std::async(std::launch::async, [&] {
+      ma_engine_config engineConfig = ma_engine_config_init();
+      engineConfig.onProcess = audio_process_callback;
+      if (renderAudioPath) {
+        engineConfig.noDevice = MA_TRUE;
+        engineConfig.channels = 2;
+        engineConfig.sampleRate = kOfflineSampleRate;
+      } else if (kAudioDevice.init(&engine, deviceConfig)) {
+        // The engine takes its channel count and rate from the device
+        engineConfig.pDevice = kAudioDevice.device();
+      } else {
+        std::cerr << "Failed to open audio device, continuing without audio\n";
+        return false;
+      }
+      // Two job threads so compressed tracks decode side by side
+      ma_uint32 rate = renderAudioPath ? kOfflineSampleRate : kAudioDevice.device()->sampleRate;
+      if (initAudioResourceManager(&kResourceManager, &kAudioVfs, rate, 2)) {
+        engineConfig.pResourceManager = &kResourceManager;
+        audioConfig.vfs = &kAudioVfs;
+        ownResourceManager = true;
+      }
+      if (ma_engine_init(&engineConfig, &engine) != MA_SUCCESS) {
+        std::cerr << "Failed to initialize miniaudio engine, continuing without audio\n";
+        kAudioDevice.uninit();
+        if (ownResourceManager) ma_resource_manager_uninit(&kResourceManager);
+        ownResourceManager = false;
+        return false;
+      }
+      // Each track picks decoded, encoded or streamed
+      kTracks.init(&engine, trackPathPtrs.data(), 4, audioConfig);
+      for (int i = 0; i < 4; ++i) kTracks.setLooping(i, true);
+      kMusic.init(&engine, &kTracks, kTrackTempos, 4, transitionConfig);
+      kVoices.init(&engine, voiceConfig);
+      // Decoded up front: pool copies share the source's buffer
+      std::string enterPath = resolveAudioPath("res/enter");
+      if (ma_sound_init_from_file(&engine, enterPath.c_str(), MA_SOUND_FLAG_DECODE | MA_SOUND_FLAG_NO_SPATIALIZATION,
+                                  NULL, NULL, &kEnterSfx) == MA_SUCCESS) {
+        kEnterSfxLoaded = true;
+        kEnterPool = kVoices.addPool(&kEnterSfx, 4, 1);
+      }
+      if (visualizer) kSpectrum.init(ma_engine_get_sample_rate(&engine), ma_engine_get_channels(&engine));
+      kSpatial.voices = &kVoices;
+      if (spatial && kSpatial.init(&engine, SpatialConfig()))
+        spatialEmitters = kSpatial.addRegionEmitters(gRegions, kTracks);
+      if (renderAudioPath) {
+        // Offline output must not depend on when decoding finished
+        kTracks.waitAll();
+        kSpatial.waitAll();
+      }
+      // Start the first sound by default
+      kAudioQueue.push(CMD_START_TRACK, 0);
+      // Hand the tracks over to the audio control thread
+      gAudioReady.store(true, std::memory_order_release);
+      return true;
+    });
   }
 
   KopiState kopiState;
-  glfwSetWindowUserPointer(window, &kopiState);
-  glfwSetMouseButtonCallback(window, mouse_button_callback);
-  glfwSetCursorPosCallback(window, cursor_position_callback);
-  glfwSetKeyCallback(window, key_callback);
-
-  // Load shaders from files
-  std::string vtxShaderMap = loadShaderSource("glsl/vertex_map.glsl");
-  std::string vtxShaderKopi = loadShaderSource("glsl/vertex_kopi.glsl");
-  std::string fragShader = loadShaderSource("glsl/fragment.glsl");
-  const char* mShaderSrc = vtxShaderMap.c_str();
-  const char* kShaderSrc = vtxShaderKopi.c_str();
-  const char* fShaderSrc = fragShader.c_str();
-
-  GLuint mVtxShader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(mVtxShader, 1, &mShaderSrc, nullptr);
-  glCompileShader(mVtxShader);
-  
-  GLuint kVtxShader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(kVtxShader, 1, &kShaderSrc, nullptr);
-  glCompileShader(kVtxShader);
-
-  GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragmentShader, 1, &fShaderSrc, nullptr);
-  glCompileShader(fragmentShader);
-
-  GLuint mapShaderProgram = glCreateProgram();
-  glAttachShader(mapShaderProgram, mVtxShader);
-  glAttachShader(mapShaderProgram, fragmentShader);
-  glLinkProgram(mapShaderProgram);
-
-  GLuint kopiShaderProgram = glCreateProgram();
-  glAttachShader(kopiShaderProgram, kVtxShader);
-  glAttachShader(kopiShaderProgram, fragmentShader);
-  glLinkProgram(kopiShaderProgram);
-
-  glDeleteShader(mVtxShader);
-  glDeleteShader(kVtxShader);
-  glDeleteShader(fragmentShader);
-
-  GLuint mapVBO, mapVAO, mapEBO;
-  glGenVertexArrays(1, &mapVAO);
-  glGenBuffers(1, &mapVBO);
-  glGenBuffers(1, &mapEBO);
-
-  glBindVertexArray(mapVAO);
-  glBindBuffer(GL_ARRAY_BUFFER, mapVBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(kMapVerts), kMapVerts, GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mapEBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(kIdxs), kIdxs, GL_STATIC_DRAW);
-  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-
-  GLuint kopiVBO, kopiVAO, kopiEBO;
-  glGenVertexArrays(1, &kopiVAO);
-  glGenBuffers(1, &kopiVBO);
-  glGenBuffers(1, &kopiEBO);
-
-  glBindVertexArray(kopiVAO);
-  glBindBuffer(GL_ARRAY_BUFFER, kopiVBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(kKopiVerts), kKopiVerts, GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, kopiEBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(kIdxs), kIdxs, GL_STATIC_DRAW);
-  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-
-  // Load textures
-  GLuint mapTexture = loadTexture("res/world_map.png");
-  GLuint kopiTexture = loadTexture("res/kopi.png");
-  if (!mapTexture || !kopiTexture) {
-    return -1;
+  kopiState.playbackTime = gTracks.startTime();
+  GLFWwindow* window = nullptr;
+  RenderThread renderThread;
+
+  if (!headless) {
+    // Initialize GLFW
+    if (!glfwInit()) {
+      std::cerr << "Failed to initialize GLFW\n";
+      return -1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // Create window
+    window = glfwCreateWindow(kWindowW, kWindowH, "World Map", nullptr, nullptr);
+    if (!window) {
+      std::cerr << "Failed to create GLFW window\n";
+      glfwTerminate();
+      return -1;
+    }
+
+    glfwSetWindowUserPointer(window, &kopiState);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetCursorPosCallback(window, cursor_position_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetWindowSizeCallback(window, window_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    if (!gReplay) glfwGetWindowSize(window, &gWinW, &gWinH);
+    if (gRecorder) {
+      // Recordings start from a known window size
+      InputEvent e;
+      e.type = EV_WINDOW_SIZE;
+      e.a = gWinW;
+      e.b = gWinH;
+      recorder.add(e);
+      gRecordStart = glfwGetTime();
+    }
+
+    // GL context, shaders, buffers and textures all live on the render thread
+    renderThread.latency = gLatency;
+    renderThread.regions = &gRegions;
+    renderThread.tracks = &gTracks;
+    renderThread.pacing = pacing;
+    if (visualizer) renderThread.spectrum = &kSpectrum.frames;
+    renderThread.heatmap = heatmap;
+    if (!renderThread.start(window)) {
+      return -1;
+    }
   }
 
-  // Render loop
-  while (!glfwWindowShouldClose(window)) {
-    glClear(GL_COLOR_BUFFER_BIT);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  gAudioEnabled = audioInit.valid() && audioInit.get();
+  if (gAudioEnabled && audioReport) kTracks.report(std::cout);
+  gSpatialEnabled = gAudioEnabled && spatialEmitters > 0;
+  if (spatial && !gSpatialEnabled) std::cerr << "No region emitters, continuing without spatial audio\n";
+  OfflineAudio offline;
+  if (renderAudioPath && (!gAudioEnabled || !offline.open(&engine, renderAudioPath))) {
+    if (window) {
+      renderThread.stop();
+      glfwDestroyWindow(window);
+      glfwTerminate();
+    }
+    return -1;
+  }
+  // Offline, the main thread applies commands itself between reads, so the
+  // output stays deterministic
+  if (gAudioEnabled && !renderAudioPath) kAudioControl.start(audioControlStep, std::chrono::milliseconds(5));
+
+  // Main loop: events and simulation only. Frame N+1 is simulated while the
+  // render thread is still submitting and swapping frame N.
+  auto replayStart = std::chrono::steady_clock::now();
+  // Replays must run the same frames as the recording, so only live runs
+  // are limited. Idle skipping is deterministic and stays on for replays.
+  FrameLimiter limiter(gReplay ? 0.0 : pacing.targetFps);
+  FramePacket next, last;
+  bool havePublished = false;
+  double lastTick = gReplay ? 0.0 : glfwGetTime();
+  while (window ? !glfwWindowShouldClose(window) : true) {
+    if (window) glfwPollEvents();
+
+    if (gReplay) {
+      if (gReplay->finished(gSimFrame)) break;
+      float due = gReplay->nextEventTime(gSimFrame);
+      if (!fast && due > 0.0f)
+        std::this_thread::sleep_until(replayStart + std::chrono::duration<float>(due));
+      gReplay->dispatch(gSimFrame, [&](const InputEvent& e) { applyInputEvent(&kopiState, e); });
+    } else {
+      // Playback follows the clock, not the frame count. The step is
+      // recorded like input so a replay advances exactly as far.
+      double now = glfwGetTime();
+      if (kopiState.playing) {
+        InputEvent tick;
+        tick.type = EV_TICK;
+        tick.frame = gSimFrame;
+        tick.time = static_cast<float>(now - gRecordStart);
+        tick.x = std::min(now - lastTick, kMaxTickSeconds);
+        if (gRecorder) gRecorder->add(tick);
+        applyInputEvent(&kopiState, tick);
+      }
+      lastTick = now;
+    }
 
     // Auto-pan map if kopi is near the edge
     maybeAutoPan(kopiState);
+    updateRegion(kopiState);
+    prefetchLikelyTrack(kopiState);
+    updateListener(kopiState);
+    if (gAudioEnabled && !renderAudioPath) kAudioControl.kick();
+
+    float aspect = static_cast<float>(gWinH) / gWinW;
+    buildFramePacket(kopiState, aspect, next);
+
+    // Idle: nothing on screen would change, so don't simulate a frame, don't
+    // draw, and block until input arrives
+    if (pacing.idle && havePublished && next.sameContent(last)) {
+      // Every event due this frame is already applied, so a replay that goes
+      // idle has reached the point where the recording stopped
+      if (gReplay) break;
+      // Input that changed nothing mustn't carry the idle wait into the
+      // next real frame's latency
+      if (gLatency) gLatency->dropPending();
+      if (window && gNeedsRedraw) {
+        // Same frame again; not a new simulation step
+        FramePacket& again = renderThread.packets.writeSlot();
+        again = last;
+        again.latency.inputCount = 0;
+        renderThread.packets.publish();
+        renderThread.kick();
+        gNeedsRedraw = false;
+      }
+      if (window) glfwWaitEventsTimeout(pacing.idleTimeout);
+      continue;
+    }
+
+    uint64_t frameId = gSimFrame + 1;
+    next.frameId = frameId;
+    if (gLatency) gLatency->stampFrame(next.latency);
+    gTrace.frameDone(next);
+    ++gSimFrame;
+    last = next;
+    havePublished = true;
+    // Offline, audio time advances with simulation time
+    if (offline.isOpen()) {
+      audioControlStep();
+      offline.render(kOfflineFramesPerSimFrame);
+    }
 
-    // Draw world map
-    glUseProgram(mapShaderProgram);
-    GLint zoomLoc = glGetUniformLocation(mapShaderProgram, "zoom");
-    GLint panLoc = glGetUniformLocation(mapShaderProgram, "pan");
-
-    glBindVertexArray(mapVAO);
-    glBindTexture(GL_TEXTURE_2D, mapTexture);
-    glUniform1f(zoomLoc, kZoom);
-    glUniform2f(panLoc, kopiState.panX, kopiState.panY);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-    // Draw kopi overlay
-    glUseProgram(kopiShaderProgram);
-    GLint offsetLoc = glGetUniformLocation(kopiShaderProgram, "offset");
-    GLint angleLoc = glGetUniformLocation(kopiShaderProgram, "angle");
-    GLint aspectLoc = glGetUniformLocation(kopiShaderProgram, "aspect");
-
-    int winW, winH;
-    glfwGetWindowSize(window, &winW, &winH);
-    float aspect = static_cast<float>(winH) / winW;
-
-    glBindVertexArray(kopiVAO);
-    glBindTexture(GL_TEXTURE_2D, kopiTexture);
-    glUniform2f(offsetLoc, kopiState.offX, kopiState.offY);
-    glUniform1f(angleLoc, kopiState.angle);
-    glUniform1f(aspectLoc, aspect);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    if (window) {
+      renderThread.packets.writeSlot() = next;
+      renderThread.packets.publish();
+      renderThread.kick();
+      // Keep handling input until the render thread has picked this frame up
+      while (renderThread.consumedFrame.load() < frameId && !glfwWindowShouldClose(window))
+        glfwWaitEventsTimeout(0.1);
+      limiter.wait(glfwWaitEventsTimeout);
+    }
+  }
+  gTrace.finish(kopiState);
+  if (offline.isOpen()) {
+    audioControlStep();
+    offline.render(kOfflineTailFrames);
+    offline.close();
+    offline.report(std::cout);
+  }
+
+  int exitCode = 0;
+  if (gRecorder && !recorder.finish(gTrace)) {
+    std::cerr << "Failed to write recording: " << recordPath << "\n";
+    exitCode = -1;
+  }
+  if (gReplay) {
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStart).count();
+    bool same = replayer.verify(gTrace);
+    std::cout << "Replayed " << gTrace.frameCount << " frames in " << secs * 1000.0 << " ms ("
+              << gTrace.frameCount / std::max(secs, 1e-9) << " frames/s): "
+              << (same ? "OK" : "MISMATCH") << "\n";
+    if (!same) exitCode = 1;
   }
 
   // Cleanup
-  glDeleteVertexArrays(1, &mapVAO);
-  glDeleteBuffers(1, &mapVBO);
-  glDeleteBuffers(1, &mapEBO);
-  glDeleteVertexArrays(1, &kopiVAO);
-  glDeleteBuffers(1, &kopiVBO);
-  glDeleteBuffers(1, &kopiEBO);
-  glDeleteProgram(mapShaderProgram);
-  glDeleteProgram(kopiShaderProgram);
-  glDeleteTextures(1, &mapTexture);
-  glDeleteTextures(1, &kopiTexture);
-  for (int i = 0; i < 4; ++i) ma_sound_uninit(&kSounds[i]);
-  ma_engine_uninit(&engine);
-
-  glfwDestroyWindow(window);
-  glfwTerminate();
-  return 0;
-}
\ No newline at end of file
+  if (window) {
+    renderThread.stop();
+    if (gLatency) gLatency->printReport();
+  }
+  if (gAudioEnabled) {
+    kAudioControl.stop();
+    // Waits for the audio thread to finish its current callback
+    ma_engine_stop(&engine);
+    gAudioReady = false;
+    kSpatial.uninit();
+    kVoices.uninit();
+    if (kEnterSfxLoaded) ma_sound_uninit(&kEnterSfx);
+    kTracks.uninit();
+    ma_engine_uninit(&engine);
+    if (ownResourceManager) ma_resource_manager_uninit(&kResourceManager);
+    if (audioReport) kAudioDevice.report(std::cout);
+    if (audioReport) kSpectrum.report(std::cout);
+    kAudioDevice.uninit();
+  }
+
+  if (window) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
+  return exitCode;
+}
@@ -0,0 +1,82 @@
+#include "marker_layer.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <cstddef>
+
+// Same layout as the kopi quad: position, then texture coordinate
+constexpr float kMarkerVerts[] = {
+  -1.0f,  1.0f,  0.0f, 1.0f, // top-left
+  -1.0f, -1.0f,  0.0f, 0.0f, // bottom-left
+   1.0f, -1.0f,  1.0f, 0.0f, // bottom-right
+   1.0f,  1.0f,  1.0f, 1.0f  // top-right
+};
+constexpr unsigned int kMarkerIdxs[] = {0, 1, 2, 0, 2, 3};
+
+bool MarkerLayer::init(const char* path) {
+  if (!set.load(path)) return false;
+
+  program = loadProgram("glsl/vertex_marker.glsl", "glsl/fragment_marker.glsl");
+  zoomLoc = glGetUniformLocation(program, "zoom");
+  panLoc = glGetUniformLocation(program, "pan");
+  viewportLoc = glGetUniformLocation(program, "viewport");
+  maxRadiusLoc = glGetUniformLocation(program, "maxRadius");
+
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &quadVBO);
+  glGenBuffers(1, &quadEBO);
+  glGenBuffers(1, &instanceVBO);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kMarkerVerts), kMarkerVerts, GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(kMarkerIdxs), kMarkerIdxs, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  glBufferData(GL_ARRAY_BUFFER, kMaxMarkers * sizeof(MarkerInstance), nullptr, GL_STREAM_DRAW);
+  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(MarkerInstance), (void*)0);
+  glEnableVertexAttribArray(2);
+  glVertexAttribDivisor(2, 1);
+  glBindVertexArray(0);
+
+  visible.reserve(kMaxMarkers);
+  return true;
+}
+
+void MarkerLayer::release() {
+  glDeleteVertexArrays(1, &vao);
+  glDeleteBuffers(1, &quadVBO);
+  glDeleteBuffers(1, &quadEBO);
+  glDeleteBuffers(1, &instanceVBO);
+  glDeleteProgram(program);
+  vao = quadVBO = quadEBO = instanceVBO = program = 0;
+}
+
+void MarkerLayer::draw(float zoom, float panX, float panY) {
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  float pixelsPerUnit = zoom * std::max(viewport[2], viewport[3]);
+  // Widen the view by the largest disc so markers don't pop at the edges
+  float margin = kMaxRadiusPx / (zoom * std::max(1, std::min(viewport[2], viewport[3])));
+  float half = 0.5f / zoom + margin;
+  visible.clear();
+  set.query(0.5f + panX - half, 0.5f + panY - half, 0.5f + panX + half, 0.5f + panY + half,
+            kClusterPx / pixelsPerUnit, visible, kMaxMarkers);
+  if (visible.empty()) return;
+
+  glUseProgram(program);
+  glUniform1f(zoomLoc, zoom);
+  glUniform2f(panLoc, panX, panY);
+  glUniform2f(viewportLoc, static_cast<float>(viewport[2]), static_cast<float>(viewport[3]));
+  glUniform1f(maxRadiusLoc, kMaxRadiusPx);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  // Orphan last frame's instances instead of waiting on them
+  glBufferData(GL_ARRAY_BUFFER, kMaxMarkers * sizeof(MarkerInstance), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, visible.size() * sizeof(MarkerInstance), visible.data());
+  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(visible.size()));
+  glBindVertexArray(0);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "markers.h"
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// Draws a MarkerSet over the map. Each frame queries the quadtree for the
+// view, with clusters sized to kClusterPx, and draws every marker and
+// cluster as an instance of one quad (set up like the kopi's) in a single
+// call. Discs are shaded in the fragment shader, with clusters growing with
+// their count.
+//
+// Render thread only, with the GL context current.
+class MarkerLayer {
+public:
+  // Nodes smaller than this on screen are drawn as one cluster
+  static constexpr float kClusterPx = 48.0f;
+  // Largest cluster disc, so one reaching in from off screen still shows
+  static constexpr float kMaxRadiusPx = 20.0f;
+  static constexpr size_t kMaxMarkers = 16384;
+
+  // False if there is no marker file at `path`
+  bool init(const char* path);
+  void release();
+  bool enabled() const { return program != 0; }
+
+  void draw(float zoom, float panX, float panY);
+
+private:
+  MarkerSet set;
+  GLuint program = 0;
+  GLuint vao = 0, quadVBO = 0, quadEBO = 0, instanceVBO = 0;
+  GLint zoomLoc = -1, panLoc = -1, viewportLoc = -1, maxRadiusLoc = -1;
+  // Per-frame scratch, reserved in init()
+  std::vector<MarkerInstance> visible;
+};
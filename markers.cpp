@@ -0,0 +1,80 @@
+#include "markers.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+constexpr char kMarkerMagic[4] = {'K', 'M', 'R', 'K'};
+constexpr uint16_t kMarkerVersion = 2;
+
+template <typename T>
+static bool read(std::ifstream& in, T& v) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+template <typename T>
+static bool readArray(std::ifstream& in, std::vector<T>& v, uint32_t count) {
+  v.resize(count);
+  return count == 0 || static_cast<bool>(in.read(reinterpret_cast<char*>(v.data()), count * sizeof(T)));
+}
+
+bool MarkerSet::load(const char* path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+
+  char magic[4];
+  uint16_t version = 0;
+  uint32_t nodeCount = 0, pointCount = 0;
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMarkerMagic, sizeof(magic)) != 0 ||
+      !read(in, version) || version != kMarkerVersion || !read(in, nodeCount) || !read(in, pointCount)) {
+    std::cerr << "Not a marker file: " << path << "\n";
+    return false;
+  }
+
+  bool ok = nodeCount > 0 && readArray(in, nodes, nodeCount) && readArray(in, points, pointCount) &&
+            nodes[0].level == 0;
+  // Children always come after their parent, so the walk can't loop, and
+  // sit one level below it, so query()'s stack is deep enough
+  for (uint32_t i = 0; ok && i < nodeCount; ++i) {
+    const Node& n = nodes[i];
+    if (n.children) {
+      ok = n.children <= 4 && n.first > i && n.first + n.children <= nodeCount && n.level < kMaxDepth;
+      for (uint32_t c = 0; ok && c < n.children; ++c) ok = nodes[n.first + c].level == n.level + 1;
+    } else {
+      ok = n.first + n.count <= pointCount && n.level <= kMaxDepth;
+    }
+  }
+  if (!ok) {
+    std::cerr << "Truncated or corrupt marker file: " << path << "\n";
+    nodes.clear();
+    points.clear();
+    return false;
+  }
+  return true;
+}
+
+void MarkerSet::query(float u0, float v0, float u1, float v1, float clusterSize, std::vector<MarkerInstance>& out,
+                      size_t maxOut) const {
+  if (nodes.empty()) return;
+  // Depth first; at most three siblings wait per level
+  uint32_t stack[kMaxDepth * 3 + 1];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0 && out.size() < maxOut) {
+    const Node& n = nodes[stack[--top]];
+    float side = 1.0f / static_cast<float>(1u << n.level);
+    float x0 = n.cellX * side, y0 = n.cellY * side;
+    if (x0 > u1 || x0 + side < u0 || y0 > v1 || y0 + side < v0) continue;
+    if (n.count == 1 || side < clusterSize) {
+      out.push_back({n.u, n.v, static_cast<float>(n.count), n.weight});
+    } else if (n.children == 0) {
+      // A leaf that is big on screen: its points are far enough apart
+      for (uint32_t i = n.first; i < n.first + n.count && out.size() < maxOut; ++i) {
+        const MarkerPoint& p = points[i];
+        if (p.u >= u0 && p.u <= u1 && p.v >= v0 && p.v <= v1) out.push_back({p.u, p.v, 1.0f, p.weight});
+      }
+    } else {
+      for (uint32_t c = 0; c < n.children; ++c) stack[top++] = n.first + c;
+    }
+  }
+}
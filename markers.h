@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A point on the map in texture coordinates (v = 0 at the bottom), with the
+// weight it carries in a heatmap
+struct MarkerPoint {
+  float u, v;
+  float weight;
+};
+
+// One marker to draw: a single point (count 1) or a cluster standing in for
+// `count` points at their centroid, with their total weight
+struct MarkerInstance {
+  float u, v;
+  float count;
+  float weight;
+};
+
+// Point markers in a static quadtree, built offline by tools/build_markers.
+// Points are stored in Morton order, so every node's points are one run of
+// the array, and every node knows its point count and centroid. A query
+// walks down only as far as the screen needs: a node smaller than the
+// cluster size is drawn as one cluster, so the work per frame depends on the
+// size of the view, not on the number of points.
+//
+// File layout (little endian):
+//   "KMRK" u16 version, u32 nodeCount, u32 pointCount,
+//   nodeCount x Node, pointCount x (f32 u, v, weight)
+// The root is node 0 and covers the unit square; a node's children are
+// stored next to each other.
+class MarkerSet {
+public:
+  static constexpr int kMaxDepth = 24;
+
+  struct Node {
+    float u, v;       // centroid, by weight
+    float weight;     // total weight under the node
+    uint32_t count;   // points under the node
+    uint32_t first;   // first child, or first point for a leaf
+    uint32_t cellX, cellY;
+    uint8_t level;    // side is 2^-level
+    uint8_t children; // 0 for a leaf
+    uint16_t pad;
+  };
+
+  bool load(const char* path);
+  bool empty() const { return nodes.empty(); }
+
+  // Appends what to draw for the rectangle (u0, v0)-(u1, v1): single points
+  // where nodes are at least `clusterSize` across, clusters below that.
+  // Stops at `maxOut` instances in total.
+  void query(float u0, float v0, float u1, float v1, float clusterSize, std::vector<MarkerInstance>& out,
+             size_t maxOut) const;
+
+  std::vector<Node> nodes;
+  std::vector<MarkerPoint> points;
+};
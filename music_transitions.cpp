@@ -0,0 +1,145 @@
+#include "music_transitions.h"
+#include "audio_assets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+constexpr ma_uint64 kNever = ~(ma_uint64)0;
+
+bool loadTrackTempo(const std::string& base, TrackTempo* out) {
+  std::ifstream in(base + ".tempo");
+  if (!in) return false;
+  TrackTempo t;
+  if (!(in >> t.bpm) || !(t.bpm > 0.0f)) {
+    std::cerr << "Invalid tempo file: " << base << ".tempo\n";
+    return false;
+  }
+  if (!(in >> t.beatsPerBar) || t.beatsPerBar < 1) t.beatsPerBar = 4;
+  *out = t;
+  return true;
+}
+
+void MusicTransitions::init(ma_engine* engine, AudioAssets* tracks, const TrackTempo* tempos, int count,
+                            const TransitionConfig& config) {
+  this->engine = engine;
+  this->tracks = tracks;
+  this->tempos = tempos;
+  this->count = count;
+  this->config = config;
+}
+
+void MusicTransitions::start(int track) {
+  tracks->play(track);
+  playing = track;
+  pending = Pending();
+}
+
+ma_uint64 MusicTransitions::framesPerUnit(int track, SyncUnit unit) const {
+  const TrackTempo& t = tempos[track];
+  // Fades on tracks of unknown tempo are timed as if at 120 bpm
+  float bpm = t.bpm > 0.0f ? t.bpm : 120.0f;
+  double beat = 60.0 / bpm * ma_engine_get_sample_rate(engine);
+  if (unit == SYNC_BAR) beat *= std::max(t.beatsPerBar, 1);
+  return std::max<ma_uint64>(1, static_cast<ma_uint64>(std::llround(beat)));
+}
+
+// The grid is anchored on the track's own cursor, so it stays musically
+// aligned however the track was started. Cursor and engine time are both
+// advanced at the end of each audio callback, so they agree with each other.
+ma_uint64 MusicTransitions::nextBoundary(int track, ma_uint64 now) const {
+  ma_uint64 lookahead = config.lookaheadMs * ma_engine_get_sample_rate(engine) / 1000;
+  // Without a tempo there is no grid to land on
+  if (!(tempos[track].bpm > 0.0f)) return now + lookahead;
+  ma_uint64 unit = framesPerUnit(track, config.unit);
+  ma_uint64 cursor = 0;
+  ma_sound_get_cursor_in_pcm_frames(tracks->sound(track), &cursor);
+  ma_uint64 toBoundary = unit - cursor % unit;
+  while (toBoundary < lookahead) toBoundary += unit;
+  return now + toBoundary;
+}
+
+void MusicTransitions::scheduleOut(int track, ma_uint64 at, ma_uint64 fade) {
+  // Fade from the current volume starting at the boundary, then stop
+  ma_sound_set_stop_time_with_fade_in_pcm_frames(tracks->sound(track), at + fade, fade);
+}
+
+void MusicTransitions::scheduleIn(int track, ma_uint64 at, ma_uint64 fade) {
+  ma_sound* s = tracks->sound(track);
+  if (!s) return;
+  if (!tracks->ready(track)) {
+    // Can't be sample accurate before the data exists; start once loaded
+    tracks->play(track);
+    return;
+  }
+  ma_node_set_state_time(s, ma_node_state_stopped, kNever);
+  if (ma_sound_is_playing(s)) {
+    // Still fading out from an earlier transition: bring it back up in place
+    ma_sound_set_fade_start_in_pcm_frames(s, -1.0f, 1.0f, fade, at);
+    return;
+  }
+  // The seek is applied by the mixer when the sound first plays
+  ma_sound_seek_to_pcm_frame(s, 0);
+  ma_sound_set_fade_start_in_pcm_frames(s, 0.0f, 1.0f, fade, at);
+  ma_sound_set_start_time_in_pcm_frames(s, at);
+  ma_sound_start(s);
+}
+
+void MusicTransitions::cancelOut(int track) {
+  ma_sound* s = tracks->sound(track);
+  if (!s) return;
+  ma_node_set_state_time(s, ma_node_state_stopped, kNever);
+  ma_sound_set_fade_in_pcm_frames(s, -1.0f, 1.0f, 0);
+}
+
+void MusicTransitions::cancelIn(int track) {
+  ma_sound* s = tracks->sound(track);
+  if (!s) return;
+  tracks->stop(track);
+  // Clear the schedule so a later plain start isn't delayed
+  ma_node_set_state_time(s, ma_node_state_started, 0);
+  ma_sound_set_fade_in_pcm_frames(s, 1.0f, 1.0f, 0);
+}
+
+void MusicTransitions::request(int target) {
+  if (target < 0 || target >= count) return;
+  ma_uint64 now = ma_engine_get_time_in_pcm_frames(engine);
+
+  // A transition whose boundary has passed is simply the new state
+  if (pending.to >= 0 && now >= pending.at) {
+    playing = pending.to;
+    pending = Pending();
+  }
+
+  if (pending.to >= 0) {
+    // Coalesce into the transition that is still waiting
+    if (target == pending.to) return;
+    cancelIn(pending.to);
+    if (target == pending.from) {
+      cancelOut(pending.from);
+      pending = Pending();
+      return;
+    }
+    scheduleIn(target, pending.at, pending.fade);
+    pending.to = target;
+    return;
+  }
+
+  if (target == playing) return;
+  if (playing < 0 || !tracks->sound(playing) || !tracks->ready(playing)) {
+    // No grid to sync to
+    tracks->stop(playing);
+    start(target);
+    return;
+  }
+
+  Pending p;
+  p.from = playing;
+  p.to = target;
+  p.at = nextBoundary(playing, now);
+  p.fade = static_cast<ma_uint64>(config.fadeBeats * framesPerUnit(playing, SYNC_BEAT));
+  scheduleOut(p.from, p.at, p.fade);
+  scheduleIn(p.to, p.at, p.fade);
+  pending = p;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <miniaudio.h>
+
+#include <cstdint>
+#include <string>
+
+class AudioAssets;
+
+// 0 bpm means the tempo isn't known and transitions aren't synced
+struct TrackTempo {
+  float bpm = 0.0f;
+  int beatsPerBar = 4;
+};
+
+// Tempo shipped next to a track as `base`.tempo, a text file holding the
+// measured bpm and optionally the beats per bar. False (leaving `out`
+// alone) if there is none or it doesn't parse.
+bool loadTrackTempo(const std::string& base, TrackTempo* out);
+
+enum SyncUnit: uint8_t { SYNC_BEAT = 0, SYNC_BAR = 1 };
+
+struct TransitionConfig {
+  SyncUnit unit = SYNC_BAR;
+  float fadeBeats = 1.0f;     // crossfade length, in beats of the outgoing track
+  uint32_t lookaheadMs = 30;  // never schedule closer than this to "now"
+};
+
+// Schedules crossfades between the quadrant tracks on the outgoing track's
+// next beat or bar boundary, in engine PCM frames. Everything it calls on
+// miniaudio is a lock-free atomic store, so it is cheap enough to call on
+// every mouse release. A request made while another transition is still
+// waiting for its boundary retargets that transition instead of stacking.
+class MusicTransitions {
+public:
+  void init(ma_engine* engine, AudioAssets* tracks, const TrackTempo* tempos, int count,
+            const TransitionConfig& config);
+  // Start `track` right away with no transition
+  void start(int track);
+  // Crossfade to `target` on the next boundary
+  void request(int target);
+  // The track that is audible, or will be once the pending transition runs
+  int target() const { return pending.to >= 0 ? pending.to : playing; }
+
+private:
+  struct Pending {
+    int from = -1, to = -1;
+    ma_uint64 at = 0;     // engine frame of the boundary
+    ma_uint64 fade = 0;   // fade length in frames
+  };
+
+  ma_uint64 framesPerUnit(int track, SyncUnit unit) const;
+  ma_uint64 nextBoundary(int track, ma_uint64 now) const;
+  void scheduleOut(int track, ma_uint64 at, ma_uint64 fade);
+  void scheduleIn(int track, ma_uint64 at, ma_uint64 fade);
+  void cancelOut(int track);
+  void cancelIn(int track);
+
+  ma_engine* engine = nullptr;
+  AudioAssets* tracks = nullptr;
+  const TrackTempo* tempos = nullptr;
+  int count = 0;
+  TransitionConfig config;
+  int playing = -1;
+  Pending pending;
+};
@@ -0,0 +1,54 @@
+#include "offline_audio.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+OfflineAudio::~OfflineAudio() {
+  close();
+}
+
+bool OfflineAudio::open(ma_engine* engine, const char* path) {
+  this->engine = engine;
+  // f32 straight from the mixer: no conversion, so no dither noise
+  ma_encoder_config config = ma_encoder_config_init(ma_encoding_format_wav, ma_format_f32,
+                                                    ma_engine_get_channels(engine), ma_engine_get_sample_rate(engine));
+  if (ma_encoder_init_file(path, &config, &encoder) != MA_SUCCESS) {
+    std::cerr << "Failed to open " << path << " for writing\n";
+    return false;
+  }
+  buffer.resize(static_cast<size_t>(kChunkFrames) * ma_engine_get_channels(engine));
+  framesWritten = 0;
+  mixTime = 0.0;
+  opened = true;
+  return true;
+}
+
+void OfflineAudio::close() {
+  if (!opened) return;
+  // Finalizes the RIFF sizes
+  ma_encoder_uninit(&encoder);
+  opened = false;
+}
+
+void OfflineAudio::render(ma_uint64 frames) {
+  if (!opened) return;
+  while (frames > 0) {
+    ma_uint64 chunk = std::min<ma_uint64>(frames, kChunkFrames);
+    auto begin = std::chrono::steady_clock::now();
+    ma_engine_read_pcm_frames(engine, buffer.data(), chunk, NULL);
+    mixTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    ma_encoder_write_pcm_frames(&encoder, buffer.data(), chunk, NULL);
+    framesWritten += chunk;
+    frames -= chunk;
+  }
+}
+
+double OfflineAudio::audioSeconds() const {
+  return engine ? static_cast<double>(framesWritten) / ma_engine_get_sample_rate(engine) : 0.0;
+}
+
+void OfflineAudio::report(std::ostream& out) const {
+  out << "Rendered " << audioSeconds() << " s of audio in " << mixTime * 1000.0 << " ms of mixing ("
+      << audioSeconds() / std::max(mixTime, 1e-9) << "x realtime)\n";
+}
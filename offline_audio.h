@@ -0,0 +1,39 @@
+#pragma once
+
+#include <miniaudio.h>
+
+#include <ostream>
+#include <vector>
+
+// Drives an engine initialized with noDevice: every render() mixes the
+// next frames by hand and appends them to a 32-bit float WAV. Nothing
+// waits on a clock, so it runs as fast as the mixer allows, and with the
+// same input and fully loaded assets the file is identical run to run.
+class OfflineAudio {
+public:
+  OfflineAudio() = default;
+  OfflineAudio(const OfflineAudio&) = delete;
+  OfflineAudio& operator=(const OfflineAudio&) = delete;
+  ~OfflineAudio();
+
+  bool open(ma_engine* engine, const char* path);
+  void close();
+  bool isOpen() const { return opened; }
+
+  void render(ma_uint64 frames);
+
+  double audioSeconds() const;
+  // Time spent inside ma_engine_read_pcm_frames
+  double mixSeconds() const { return mixTime; }
+  void report(std::ostream& out) const;
+
+private:
+  static constexpr ma_uint32 kChunkFrames = 1024;
+
+  ma_engine* engine = nullptr;
+  ma_encoder encoder;
+  bool opened = false;
+  std::vector<float> buffer;
+  ma_uint64 framesWritten = 0;
+  double mixTime = 0.0;
+};
@@ -0,0 +1,98 @@
+#include "playback_layer.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <cstddef>
+
+// Same layout as the kopi quad: position, then texture coordinate
+constexpr float kSpriteVerts[] = {
+  -1.0f,  1.0f,  0.0f, 1.0f, // top-left
+  -1.0f, -1.0f,  0.0f, 0.0f, // bottom-left
+   1.0f, -1.0f,  1.0f, 0.0f, // bottom-right
+   1.0f,  1.0f,  1.0f, 1.0f  // top-right
+};
+constexpr unsigned int kSpriteIdxs[] = {0, 1, 2, 0, 2, 3};
+
+bool PlaybackLayer::init(const TrackSet* from) {
+  if (!from || from->empty()) return false;
+  tracks = from;
+
+  program = loadProgram("glsl/vertex_track.glsl", "glsl/fragment_track.glsl");
+  zoomLoc = glGetUniformLocation(program, "zoom");
+  panLoc = glGetUniformLocation(program, "pan");
+  viewportLoc = glGetUniformLocation(program, "viewport");
+  radiusLoc = glGetUniformLocation(program, "radius");
+
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &quadVBO);
+  glGenBuffers(1, &quadEBO);
+  glGenBuffers(1, &instanceVBO);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kSpriteVerts), kSpriteVerts, GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(kSpriteIdxs), kSpriteIdxs, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  glBufferData(GL_ARRAY_BUFFER, kMaxSprites * sizeof(TrackInstance), nullptr, GL_STREAM_DRAW);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TrackInstance), (void*)offsetof(TrackInstance, u));
+  glEnableVertexAttribArray(2);
+  glVertexAttribDivisor(2, 1);
+  // The id stays an integer for the colour hash
+  glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(TrackInstance), (void*)offsetof(TrackInstance, id));
+  glEnableVertexAttribArray(3);
+  glVertexAttribDivisor(3, 1);
+  glBindVertexArray(0);
+
+  live.reserve(kMaxLive);
+  u.resize(kMaxLive);
+  v.resize(kMaxLive);
+  visible.reserve(kMaxSprites);
+  return true;
+}
+
+void PlaybackLayer::release() {
+  glDeleteVertexArrays(1, &vao);
+  glDeleteBuffers(1, &quadVBO);
+  glDeleteBuffers(1, &quadEBO);
+  glDeleteBuffers(1, &instanceVBO);
+  glDeleteProgram(program);
+  vao = quadVBO = quadEBO = instanceVBO = program = 0;
+  tracks = nullptr;
+}
+
+void PlaybackLayer::draw(double time, float zoom, float panX, float panY) {
+  tracks->gather(time, live, kMaxLive);
+  if (live.size() == 0) return;
+  interpolateTracks(live, u.data(), v.data());
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  // Widen the view by a sprite so they don't pop at the edges
+  float margin = (kRadiusPx + 1.0f) / (zoom * std::max(1, std::min(viewport[2], viewport[3])));
+  float half = 0.5f / zoom + margin;
+  float minU = 0.5f + panX - half, maxU = 0.5f + panX + half;
+  float minV = 0.5f + panY - half, maxV = 0.5f + panY + half;
+  visible.clear();
+  for (size_t i = 0, n = live.size(); i < n && visible.size() < kMaxSprites; ++i) {
+    if (u[i] < minU || u[i] > maxU || v[i] < minV || v[i] > maxV) continue;
+    visible.push_back({u[i], v[i], live.id[i]});
+  }
+  if (visible.empty()) return;
+
+  glUseProgram(program);
+  glUniform1f(zoomLoc, zoom);
+  glUniform2f(panLoc, panX, panY);
+  glUniform2f(viewportLoc, static_cast<float>(viewport[2]), static_cast<float>(viewport[3]));
+  glUniform1f(radiusLoc, kRadiusPx);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  // Orphan last frame's instances instead of waiting on them
+  glBufferData(GL_ARRAY_BUFFER, kMaxSprites * sizeof(TrackInstance), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, visible.size() * sizeof(TrackInstance), visible.data());
+  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(visible.size()));
+  glBindVertexArray(0);
+}
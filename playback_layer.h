@@ -0,0 +1,39 @@
+#pragma once
+
+#include "tracks.h"
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// Draws a TrackSet at the playback time over the map. Each frame gathers
+// what is live from the mapped file, interpolates it, keeps what is in view
+// and draws it as instances of one quad (set up like the kopi's) in a single
+// call. Sprites are small discs, coloured by id.
+//
+// Render thread only, with the GL context current.
+class PlaybackLayer {
+public:
+  static constexpr float kRadiusPx = 3.0f;
+  // Live samples read per frame, and sprites drawn of those
+  static constexpr size_t kMaxLive = 262144;
+  static constexpr size_t kMaxSprites = 65536;
+
+  // The tracks stay owned by the caller and must outlive the layer.
+  // False if there are none.
+  bool init(const TrackSet* tracks);
+  void release();
+  bool enabled() const { return program != 0; }
+
+  void draw(double time, float zoom, float panX, float panY);
+
+private:
+  const TrackSet* tracks = nullptr;
+  GLuint program = 0;
+  GLuint vao = 0, quadVBO = 0, quadEBO = 0, instanceVBO = 0;
+  GLint zoomLoc = -1, panLoc = -1, viewportLoc = -1, radiusLoc = -1;
+  // Per-frame scratch, reserved in init()
+  TrackSlice live;
+  std::vector<float> u, v;
+  std::vector<TrackInstance> visible;
+};
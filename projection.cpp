@@ -0,0 +1,102 @@
+#include "projection.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Robinson's table: parallel length X and distance from the equator Y at
+// every 5 degrees of latitude, both relative to the equator and the pole
+constexpr int kRobinsonRows = 19;
+constexpr double kRobinsonX[kRobinsonRows] = {1.0000, 0.9986, 0.9954, 0.9900, 0.9822, 0.9730, 0.9600,
+                                              0.9427, 0.9216, 0.8962, 0.8679, 0.8350, 0.7986, 0.7597,
+                                              0.7186, 0.6732, 0.6213, 0.5722, 0.5322};
+constexpr double kRobinsonY[kRobinsonRows] = {0.0000, 0.0620, 0.1240, 0.1860, 0.2480, 0.3100, 0.3720,
+                                              0.4340, 0.4958, 0.5571, 0.6176, 0.6769, 0.7346, 0.7903,
+                                              0.8435, 0.8936, 0.9394, 0.9761, 1.0000};
+
+// Catmull-Rom through the table at |latitude| in degrees, mirrored about
+// the equator and extended straight past the pole
+static double robinsonTable(const double* t, double absLatDeg, bool odd) {
+  auto at = [&](int i) {
+    if (i < 0) return odd ? -t[-i] : t[-i];
+    if (i >= kRobinsonRows) return 2.0 * t[kRobinsonRows - 1] - t[2 * (kRobinsonRows - 1) - i];
+    return t[i];
+  };
+  double f = std::min(absLatDeg, 90.0) / 5.0;
+  int i = std::min(static_cast<int>(f), kRobinsonRows - 2);
+  double s = f - i;
+  double p0 = at(i - 1), p1 = at(i), p2 = at(i + 1), p3 = at(i + 2);
+  return p1 + 0.5 * s * (p2 - p0 + s * (2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3 + s * (3.0 * (p1 - p2) + p3 - p0)));
+}
+
+// Latitude in degrees with Robinson Y = `y` (0..1), by bisection; Y rises
+// monotonically with latitude
+static double robinsonLatitude(double y) {
+  double lo = 0.0, hi = 90.0;
+  for (int i = 0; i < 52; ++i) {
+    double mid = 0.5 * (lo + hi);
+    (robinsonTable(kRobinsonY, mid, true) < y ? lo : hi) = mid;
+  }
+  return 0.5 * (lo + hi);
+}
+
+// Map v and |latitude| in degrees of the view row at `viewY`. Past the
+// pole v keeps going, so the LUT stays continuous.
+static void robinsonRow(double viewY, double* v, double* absLatDeg) {
+  double y = std::fabs(viewY - 0.5) * 2.0;
+  *absLatDeg = robinsonLatitude(std::min(y, 1.0));
+  *v = 0.5 + std::copysign(*absLatDeg / 180.0 + std::max(y - 1.0, 0.0), viewY - 0.5);
+}
+
+bool projectionNeedsLut(Projection p) {
+  return p == PROJ_ROBINSON;
+}
+
+bool viewToMap(Projection p, glm::dvec2 view, glm::dvec2* map) {
+  const double pi = glm::pi<double>();
+  switch (p) {
+  case PROJ_WEB_MERCATOR: {
+    double lat = std::atan(std::sinh((view.y - 0.5) * 2.0 * pi));
+    *map = {view.x, lat / pi + 0.5};
+    return view.x >= 0.0 && view.x <= 1.0 && view.y >= 0.0 && view.y <= 1.0;
+  }
+  case PROJ_ROBINSON: {
+    double absLat;
+    robinsonRow(view.y, &map->y, &absLat);
+    double x = robinsonTable(kRobinsonX, absLat, false);
+    map->x = 0.5 + (view.x - 0.5) / x;
+    // The outline is where the parallel ends; a little slack keeps its own
+    // points (which round either way) on the map
+    return std::fabs(view.x - 0.5) <= 0.5 * x + 1e-12 && view.y >= 0.0 && view.y <= 1.0;
+  }
+  default:
+    *map = view;
+    return view.x >= 0.0 && view.x <= 1.0 && view.y >= 0.0 && view.y <= 1.0;
+  }
+}
+
+void buildInverseLut(Projection p, int width, int height, std::vector<float>& rg) {
+  rg.resize(static_cast<size_t>(width) * height * 2);
+  for (int j = 0; j < height; ++j) {
+    double viewY = (j + 0.5) / height;
+    // Robinson's latitude depends on the row alone and is the slow part
+    double rowV = 0.0, invX = 1.0;
+    if (p == PROJ_ROBINSON) {
+      double absLat;
+      robinsonRow(viewY, &rowV, &absLat);
+      invX = 1.0 / robinsonTable(kRobinsonX, absLat, false);
+    }
+    float* out = &rg[static_cast<size_t>(j) * width * 2];
+    for (int i = 0; i < width; ++i) {
+      double viewX = (i + 0.5) / width;
+      glm::dvec2 map;
+      if (p == PROJ_ROBINSON)
+        map = {0.5 + (viewX - 0.5) * invX, rowV};
+      else
+        viewToMap(p, {viewX, viewY}, &map);
+      out[2 * i] = static_cast<float>(map.x);
+      out[2 * i + 1] = static_cast<float>(map.y);
+    }
+  }
+}
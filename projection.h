@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// How the globe is laid out on screen. The map image, region IDs and the
+// vector layers are all equirectangular ("map" coordinates: u linear in
+// longitude, v linear in latitude, v = 0 at the bottom). A projection maps
+// those into "view" coordinates, the projected map scaled into the unit
+// square, which is what zoom and pan move around in and what
+// vertex_map.glsl hands the fragment shader. fragment_map.glsl goes back
+// from view to map per pixel: closed form where there is one, otherwise
+// through a LUT built from the CPU inverse below.
+enum Projection : uint8_t {
+  PROJ_EQUIRECTANGULAR = 0,
+  PROJ_WEB_MERCATOR = 1, // cut at +-85.0511 degrees, where it is square
+  PROJ_ROBINSON = 2,     // no closed-form inverse
+  kProjectionCount
+};
+
+// True if fragment_map.glsl needs the inverse LUT for `p`
+bool projectionNeedsLut(Projection p);
+
+// Map coordinate shown at `view`; false where the projection shows no map
+// (outside Robinson's outline, past Mercator's cut)
+bool viewToMap(Projection p, glm::dvec2 view, glm::dvec2* map);
+
+// Inverse LUT for fragment_map.glsl: map (u, v) at the centre of each of
+// width x height view texels, two floats per texel, bottom row first.
+// Points the projection doesn't cover get values just outside [0, 1] that
+// continue smoothly from the inside, so a filtered lookup still finds the
+// outline in the right place.
+void buildInverseLut(Projection p, int width, int height, std::vector<float>& rg);
@@ -0,0 +1,108 @@
+#include "region_map.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+constexpr char kRegionMagic[4] = {'K', 'R', 'I', 'D'};
+constexpr uint16_t kRegionVersion = 1;
+
+template <typename T>
+bool read(std::ifstream& in, T& v) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+bool RegionMap::load(const char* path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+
+  char magic[4];
+  uint16_t version = 0;
+  uint32_t w = 0, h = 0, nameCount = 0;
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kRegionMagic, sizeof(magic)) != 0 ||
+      !read(in, version) || version != kRegionVersion ||
+      !read(in, w) || !read(in, h) || !read(in, nameCount) || w == 0 || h == 0) {
+    std::cerr << "Not a region map: " << path << "\n";
+    return false;
+  }
+
+  for (uint32_t i = 0; i < nameCount; ++i) {
+    uint16_t id;
+    uint8_t len;
+    std::string name;
+    bool ok = read(in, id) && read(in, len);
+    if (ok) {
+      name.resize(len);
+      ok = len == 0 || in.read(&name[0], len);
+    }
+    if (!ok) {
+      std::cerr << "Truncated region map: " << path << "\n";
+      names.clear();
+      return false;
+    }
+    names[id] = std::move(name);
+  }
+
+  ids.resize(static_cast<size_t>(w) * h);
+  // Flip to bottom-up while reading
+  for (uint32_t row = 0; row < h; ++row) {
+    char* dst = reinterpret_cast<char*>(&ids[static_cast<size_t>(h - 1 - row) * w]);
+    if (!in.read(dst, w * sizeof(uint16_t))) {
+      std::cerr << "Truncated region map: " << path << "\n";
+      ids.clear();
+      return false;
+    }
+  }
+  width = w;
+  height = h;
+  return true;
+}
+
+uint16_t RegionMap::at(float u, float v) const {
+  if (ids.empty() || u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f) return 0;
+  int x = static_cast<int>(u * width);
+  int y = static_cast<int>(v * height);
+  return ids[static_cast<size_t>(y) * width + x];
+}
+
+const std::string& RegionMap::name(uint16_t id) const {
+  static const std::string kNone;
+  auto it = names.find(id);
+  return it == names.end() ? kNone : it->second;
+}
+
+std::vector<RegionCentroid> RegionMap::centroids() const {
+  struct Sum { double x = 0.0, y = 0.0; size_t n = 0; };
+  std::vector<Sum> sums(65536);
+  for (int y = 0; y < height; ++y) {
+    const uint16_t* row = &ids[static_cast<size_t>(y) * width];
+    for (int x = 0; x < width; ++x) {
+      Sum& s = sums[row[x]];
+      s.x += x;
+      s.y += y;
+      ++s.n;
+    }
+  }
+  std::vector<RegionCentroid> out;
+  for (size_t id = 1; id < sums.size(); ++id) {
+    const Sum& s = sums[id];
+    if (s.n == 0) continue;
+    out.push_back({static_cast<uint16_t>(id),
+                   static_cast<float>((s.x / s.n + 0.5) / width),
+                   static_cast<float>((s.y / s.n + 0.5) / height)});
+  }
+  return out;
+}
+
+bool ndcToMapUV(Projection projection, float xNdc, float yNdc, float zoom, float panX, float panY, float* u,
+                float* v) {
+  // vertex_map.glsl: TexCoord = (aTexCoord - 0.5) / zoom + 0.5 + pan,
+  // with aTexCoord = ndc * 0.5 + 0.5 on the fullscreen quad. That is the
+  // view coordinate; fragment_map.glsl takes it back to the map.
+  glm::dvec2 view(xNdc * 0.5 / zoom + 0.5 + panX, yNdc * 0.5 / zoom + 0.5 + panY);
+  glm::dvec2 map;
+  bool inside = viewToMap(projection, view, &map);
+  *u = static_cast<float>(map.x);
+  *v = static_cast<float>(map.y);
+  return inside;
+}
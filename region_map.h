@@ -0,0 +1,44 @@
+#pragma once
+
+#include "projection.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct RegionCentroid {
+  uint16_t id;
+  float u, v; // texture coordinate, v = 0 at the bottom
+};
+
+// Region index: a 16-bit region ID per texel, aligned with world_map.png and
+// produced offline by tools/rasterize_regions. Lookups are a single array
+// read regardless of how many regions there are. ID 0 means "no region".
+//
+// File layout (little endian):
+//   "KRID" u16 version, u32 width, u32 height, u32 nameCount,
+//   nameCount x (u16 id, u8 length, chars), width*height x u16 (top row first)
+class RegionMap {
+public:
+  bool load(const char* path);
+  bool empty() const { return ids.empty(); }
+
+  // Region at texture coordinate (u, v), v = 0 at the bottom like GL
+  uint16_t at(float u, float v) const;
+  const std::string& name(uint16_t id) const;
+  // Mean texel position of every region present, in ID order
+  std::vector<RegionCentroid> centroids() const;
+
+  int width = 0, height = 0;
+  // Rows stored bottom-up so they upload to GL as-is
+  std::vector<uint16_t> ids;
+
+private:
+  std::unordered_map<uint16_t, std::string> names;
+};
+
+// Inverse of vertex_map.glsl and fragment_map.glsl: the map texture
+// coordinate under an NDC point, false where `projection` shows no map
+bool ndcToMapUV(Projection projection, float xNdc, float yNdc, float zoom, float panX, float panY, float* u,
+                float* v);
@@ -0,0 +1,611 @@
+#include "render_thread.h"
+#include "border_layer.h"
+#include "gl_util.h"
+#include "heatmap_layer.h"
+#include "kopi.h"
+#include "latency.h"
+#include "layer_compositor.h"
+#include "marker_layer.h"
+#include "playback_layer.h"
+#include "projection.h"
+#include "region_map.h"
+#include "spectrum.h"
+#include "tile_layer.h"
+#include "tile_pyramid.h"
+#include "xyz_tiles.h"
+#ifdef HAVE_FREETYPE
+#include "text_renderer.h"
+#endif
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Fullscreen quad for world map (constexpr)
+constexpr float kMapVerts[] = {
+  // positions   // tex coords
+  -1.0f,  1.0f,  0.0f, 1.0f, // top-left
+  -1.0f, -1.0f,  0.0f, 0.0f, // bottom-left
+   1.0f, -1.0f,  1.0f, 0.0f, // bottom-right
+   1.0f,  1.0f,  1.0f, 1.0f  // top-right
+};
+
+// Quad for kopi (smaller, centered at offset, uses kKopiHalfW/kKopiHalfH)
+constexpr float kKopiVerts[] = {
+  // positions         // tex coords
+  -kKopiHalfW,  kKopiHalfH,  0.0f, 1.0f, // top-left
+  -kKopiHalfW, -kKopiHalfH,  0.0f, 0.0f, // bottom-left
+   kKopiHalfW, -kKopiHalfH,  1.0f, 0.0f, // bottom-right
+   kKopiHalfW,  kKopiHalfH,  1.0f, 1.0f  // top-right
+};
+
+constexpr unsigned int kIdxs[] = {
+  0, 1, 2,
+  0, 2, 3
+};
+
+// An image decoded but not yet uploaded, bottom row first for GL
+struct DecodedImage {
+  unsigned char* data = nullptr;
+  int width = 0, height = 0, channels = 0;
+};
+
+// Safe off the render thread; takes no GL calls
+DecodedImage decodeImage(const char* path) {
+  DecodedImage image;
+  stbi_set_flip_vertically_on_load_thread(true);
+  image.data = stbi_load(path, &image.width, &image.height, &image.channels, 0);
+  if (!image.data) std::cerr << "Failed to load texture: " << path << "\n";
+  return image;
+}
+
+// Uploads and frees `image`; 0 if it failed to decode
+GLuint uploadTexture(DecodedImage& image, int* outWidth = nullptr, int* outHeight = nullptr) {
+  if (!image.data) return 0;
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // Zooming out minifies the map well past 2:1
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  GLenum format = image.channels == 4 ? GL_RGBA : GL_RGB;
+  glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  stbi_image_free(image.data);
+  image.data = nullptr;
+  if (outWidth) *outWidth = image.width;
+  if (outHeight) *outHeight = image.height;
+  return texture;
+}
+
+GLuint loadTexture(const char* path, int* outWidth = nullptr, int* outHeight = nullptr) {
+  DecodedImage image = decodeImage(path);
+  return uploadTexture(image, outWidth, outHeight);
+}
+
+// Region IDs as an integer texture; 1x1 "no region" when there is no map
+GLuint loadRegionTexture(const RegionMap* regions) {
+  static const uint16_t kNoRegion = 0;
+  bool have = regions && !regions->empty();
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // Integer textures cannot be filtered
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, have ? regions->width : 1, have ? regions->height : 1, 0,
+               GL_RED_INTEGER, GL_UNSIGNED_SHORT, have ? regions->ids.data() : &kNoRegion);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  return texture;
+}
+
+// Band levels as a float 1D texture, one texel per band; a single zero
+// texel when there is no analyzer
+GLuint makeSpectrumTexture(bool enabled) {
+  static const float kSilent = 0.0f;
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_1D, texture);
+  glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  std::vector<float> zeros(enabled ? kSpectrumBands : 1, 0.0f);
+  glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, static_cast<GLsizei>(zeros.size()), 0, GL_RED, GL_FLOAT,
+               enabled ? zeros.data() : &kSilent);
+  return texture;
+}
+
+// The map's tiles: a directory of z/x/y.png tiles when there is one, else
+// the prebuilt pyramid; null when there is neither. Probes the backend, so
+// not on the render thread.
+std::unique_ptr<TileSource> openTileSource() {
+  auto xyz = std::make_unique<XyzTileSource>();
+  // The cache only comes into play for remote backends
+  if (xyz->open(std::make_unique<DirectoryTileBackend>("res/tiles"), "cache/tiles")) return xyz;
+  auto pyramid = std::make_unique<TilePyramid>();
+  if (pyramid->open("res/world.kpyr")) return pyramid;
+  return nullptr;
+}
+
+// Inverse of `p` over the view square for fragment_map.glsl, two floats
+// per texel; 1024 x 512 keeps Robinson within 1e-5 of the exact inverse
+constexpr int kInverseLutW = 1024;
+constexpr int kInverseLutH = 512;
+
+GLuint makeInverseLutTexture(Projection p) {
+  std::vector<float> rg;
+  buildInverseLut(p, kInverseLutW, kInverseLutH, rg);
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // Filtered, so the outline falls between texels where it really is
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, kInverseLutW, kInverseLutH, 0, GL_RG, GL_FLOAT, rg.data());
+  return texture;
+}
+
+// The map's cached layers, bottom first
+enum MapLayer { LAYER_MAP, LAYER_OVERLAYS, LAYER_TRACKS, LAYER_LABELS, kMapLayerCount };
+
+// Minimap inset, bottom right, shown from this zoom on
+constexpr float kMinimapMinZoom = 2.0f;
+constexpr float kMinimapFraction = 0.2f; // of the viewport's width
+constexpr int kMinimapMarginPx = 12;
+constexpr float kMinimapFrame[] = {0.9f, 0.9f, 0.9f, 1.0f};
+constexpr float kMinimapBackground[] = {0.05f, 0.05f, 0.08f, 1.0f};
+constexpr float kMinimapView[] = {1.0f, 0.85f, 0.3f, 1.0f};
+
+// Solid rectangle in window pixels, as a scissored clear; needs
+// GL_SCISSOR_TEST on and leaves the clear colour changed
+void fillRect(int x, int y, int w, int h, const float* rgba) {
+  glScissor(x, y, w, h);
+  glClearColor(rgba[0], rgba[1], rgba[2], rgba[3]);
+  glClear(GL_COLOR_BUFFER_BIT);
+}
+
+// One-pixel outline, four scissored clears
+void strokeRect(int x, int y, int w, int h, const float* rgba) {
+  fillRect(x, y, w, 1, rgba);
+  fillRect(x, y + h - 1, w, 1, rgba);
+  fillRect(x, y, 1, h, rgba);
+  fillRect(x + w - 1, y, 1, h, rgba);
+}
+
+#ifdef HAVE_FREETYPE
+// A name placed at a point on the map
+struct MapLabel {
+  int layout;   // TextRenderer layout
+  float u, v;   // anchor in texture coordinates
+  float extent; // width of what it names, in texture coordinates
+};
+constexpr float kLabelPx = 14.0f;
+constexpr uint32_t kLabelColor = 0xFFF0F0F0;
+
+// Country names from the border file, largest first so they win collisions
+std::vector<MapLabel> makeBorderLabels(TextRenderer& text, const BorderLayer& borders) {
+  std::vector<MapLabel> labels;
+  for (const BorderSet::Feature& f : borders.features()) {
+    if (f.name.empty()) continue;
+    labels.push_back({text.layout(f.name), 0.5f * (f.minU + f.maxU), 0.5f * (f.minV + f.maxV), f.maxU - f.minU});
+  }
+  std::stable_sort(labels.begin(), labels.end(), [](const MapLabel& a, const MapLabel& b) { return a.extent > b.extent; });
+  return labels;
+}
+
+void drawMapLabels(TextRenderer& text, const std::vector<MapLabel>& labels, float zoom, float panX, float panY) {
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  float w = static_cast<float>(viewport[2]), h = static_cast<float>(viewport[3]);
+  text.begin(viewport[2], viewport[3]);
+  for (const MapLabel& l : labels) {
+    // Same mapping as the map shaders, then NDC to pixels
+    float x = ((l.u - 0.5f - panX) * zoom + 0.5f) * w;
+    float y = ((l.v - 0.5f - panY) * zoom + 0.5f) * h;
+    if (x < 0.0f || x > w || y < 0.0f || y > h) continue;
+    // Don't name something smaller than its name
+    if (l.extent * zoom * w < text.width(l.layout, kLabelPx)) continue;
+    text.add(l.layout, x, y, kLabelPx, kLabelColor);
+  }
+  text.draw();
+}
+#endif
+
+void makeQuad(const float* verts, size_t size, GLuint* vao, GLuint* vbo, GLuint* ebo) {
+  glGenVertexArrays(1, vao);
+  glGenBuffers(1, vbo);
+  glGenBuffers(1, ebo);
+
+  glBindVertexArray(*vao);
+  glBindBuffer(GL_ARRAY_BUFFER, *vbo);
+  glBufferData(GL_ARRAY_BUFFER, size, verts, GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(kIdxs), kIdxs, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+}
+
+bool RenderThread::start(GLFWwindow* window) {
+  quit = false;
+  initState = 0;
+  // The context can only be current on one thread at a time
+  glfwMakeContextCurrent(nullptr);
+  thread = std::thread(&RenderThread::run, this, window);
+  while (initState.load() == 0) std::this_thread::yield();
+  if (initState.load() < 0) {
+    thread.join();
+    return false;
+  }
+  return true;
+}
+
+void RenderThread::stop() {
+  quit = true;
+  kick();
+  if (thread.joinable()) thread.join();
+}
+
+void RenderThread::kick() {
+  std::lock_guard<std::mutex> lock(wakeMutex);
+  wakeCv.notify_one();
+}
+
+void applySwapInterval(const FramePacingConfig& pacing) {
+  // Adaptive vsync: tear instead of stalling a whole interval on a late frame
+  if (pacing.adaptiveVsync && pacing.swapInterval > 0 &&
+      (glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+       glfwExtensionSupported("GLX_EXT_swap_control_tear"))) {
+    glfwSwapInterval(-pacing.swapInterval);
+    return;
+  }
+  glfwSwapInterval(pacing.swapInterval);
+}
+
+void RenderThread::run(GLFWwindow* window) {
+  glfwMakeContextCurrent(window);
+
+  // Load OpenGL functions
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    std::cerr << "Failed to initialize GLAD\n";
+    glfwMakeContextCurrent(nullptr);
+    initState = -1;
+    return;
+  }
+  applySwapInterval(pacing);
+
+  // Load shaders from files
+  GLuint mVtxShader = compileShader(GL_VERTEX_SHADER, loadShaderSource("glsl/vertex_map.glsl"));
+  GLuint kVtxShader = compileShader(GL_VERTEX_SHADER, loadShaderSource("glsl/vertex_kopi.glsl"));
+  GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, loadShaderSource("glsl/fragment.glsl"));
+  GLuint mFragShader = compileShader(GL_FRAGMENT_SHADER, loadShaderSource("glsl/fragment_map.glsl"));
+
+  GLuint mapShaderProgram = linkProgram(mVtxShader, mFragShader);
+  GLuint kopiShaderProgram = linkProgram(kVtxShader, fragmentShader);
+
+  glDeleteShader(mVtxShader);
+  glDeleteShader(kVtxShader);
+  glDeleteShader(fragmentShader);
+  glDeleteShader(mFragShader);
+
+  GLuint mapVBO, mapVAO, mapEBO;
+  makeQuad(kMapVerts, sizeof(kMapVerts), &mapVAO, &mapVBO, &mapEBO);
+  GLuint kopiVBO, kopiVAO, kopiEBO;
+  makeQuad(kKopiVerts, sizeof(kKopiVerts), &kopiVAO, &kopiVBO, &kopiEBO);
+
+  // The map comes from tiles when there are some, otherwise from the single
+  // full-resolution image. Opening the source probes its backend, which may
+  // be slow, so it happens on the side and the map is drawn once it's done.
+  // The single image is only decoded if it finds no tiles.
+  TileLayer tiles;
+  std::future<std::unique_ptr<TileSource>> tileSource = std::async(std::launch::async, [this] {
+    std::unique_ptr<TileSource> source = openTileSource();
+    tilesArrived = true;
+    kick();
+    return source;
+  });
+
+  // Optional, drawn over the map when res/borders.kbrd and res/markers.kmrk
+  // exist
+  BorderLayer borders;
+  borders.init("res/borders.kbrd");
+  // The same points, either as markers or as a density heatmap
+  MarkerLayer markers;
+  HeatmapLayer heat;
+  if (heatmap)
+    heat.init("res/markers.kmrk");
+  else
+    markers.init("res/markers.kmrk");
+  PlaybackLayer playback;
+  playback.init(tracks);
+
+#ifdef HAVE_FREETYPE
+  // Labels need a font; without res/font.ttf the map is just unlabelled
+  TextRenderer text;
+  std::vector<MapLabel> labels;
+  if (borders.enabled() && text.init("res/font.ttf")) labels = makeBorderLabels(text, borders);
+  bool labelled = !labels.empty();
+#else
+  // Built without FreeType, so there is nothing to draw labels with
+  bool labelled = false;
+#endif
+
+  // Each layer is only redrawn when its inputs change
+  LayerCompositor layers;
+  layers.init(kMapLayerCount);
+  bool overlays = borders.enabled() || markers.enabled() || heat.enabled();
+  uint16_t lastHighlight = 0;
+  uint8_t lastProjection = PROJ_EQUIRECTANGULAR;
+  double lastPlaybackTime = 0.0;
+
+  // Load textures
+  GLuint mapTexture = 0;
+  GLuint kopiTexture = loadTexture("res/kopi.png");
+  GLuint regionTexture = loadRegionTexture(regions);
+  GLuint spectrumTexture = makeSpectrumTexture(spectrum != nullptr);
+  GLuint inverseLuts[kProjectionCount] = {};
+  for (int i = 0; i < kProjectionCount; ++i)
+    if (projectionNeedsLut(static_cast<Projection>(i))) inverseLuts[i] = makeInverseLutTexture(static_cast<Projection>(i));
+  // The single image is only needed when there are no tiles, or once
+  // another projection is picked. Decoding it takes long enough to drop
+  // frames, so it also happens on the side and is uploaded once ready.
+  std::future<DecodedImage> mapImage;
+  bool mapImageStarted = false;
+  auto startMapImage = [&] {
+    if (mapImageStarted) return;
+    mapImageStarted = true;
+    mapImage = std::async(std::launch::async, [this] {
+      DecodedImage image = decodeImage("res/world_map.png");
+      tilesArrived = true;
+      kick();
+      return image;
+    });
+  };
+  bool ok = kopiTexture != 0;
+
+  GLint zoomLoc = glGetUniformLocation(mapShaderProgram, "zoom");
+  GLint panLoc = glGetUniformLocation(mapShaderProgram, "pan");
+  GLint highlightLoc = glGetUniformLocation(mapShaderProgram, "highlightRegion");
+  GLint projectionLoc = glGetUniformLocation(mapShaderProgram, "projection");
+  GLint tileHighlightLoc = -1;
+  glUseProgram(mapShaderProgram);
+  glUniform1i(glGetUniformLocation(mapShaderProgram, "texture1"), 0);
+  glUniform1i(glGetUniformLocation(mapShaderProgram, "inverseLut"), 4);
+  // Overlays shared by both map shaders
+  auto setOverlayUniforms = [&](GLuint program) {
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "regionIds"), 1);
+    glUniform1i(glGetUniformLocation(program, "spectrum"), 2);
+    glUniform1ui(glGetUniformLocation(program, "spectrumBands"), spectrum ? kSpectrumBands : 0);
+  };
+  setOverlayUniforms(mapShaderProgram);
+  GLint offsetLoc = glGetUniformLocation(kopiShaderProgram, "offset");
+  GLint angleLoc = glGetUniformLocation(kopiShaderProgram, "angle");
+  GLint aspectLoc = glGetUniformLocation(kopiShaderProgram, "aspect");
+
+  if (ok && latency) latency->initGL();
+  initState = ok ? 1 : -1;
+
+  // Render loop
+  while (ok && !quit.load()) {
+    bool fresh = packets.acquire();
+    // Tiles arriving or fading in redraw the last frame on their own. The
+    // flag is cleared even before the first frame, which draws everything
+    // anyway, or the wait below would return straight away.
+    bool arrived = tilesArrived.exchange(false);
+    bool tilesChanged = consumedFrame.load() > 0 && (arrived || tiles.animating());
+    if (!fresh && !tilesChanged) {
+      // Nothing new from the main thread; the last frame stays on screen
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      wakeCv.wait_for(lock, std::chrono::milliseconds(100),
+                      [this] { return quit.load() || packets.pending() || tilesArrived.load(); });
+      continue;
+    }
+    const FramePacket& p = packets.readSlot();
+    if (fresh) {
+      consumedFrame.store(p.frameId);
+      // Let the main thread start simulating the next frame
+      glfwPostEmptyEvent();
+    }
+
+    // 128 bytes, and only when the analyzer has published since last frame
+    bool spectrumChanged = spectrum && spectrum->acquire();
+    if (spectrumChanged) {
+      glActiveTexture(GL_TEXTURE2);
+      glBindTexture(GL_TEXTURE_1D, spectrumTexture);
+      glTexSubImage1D(GL_TEXTURE_1D, 0, 0, kSpectrumBands, GL_RED, GL_FLOAT, spectrum->readSlot().bands);
+      glActiveTexture(GL_TEXTURE0);
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    glEnable(GL_BLEND);
+    setBlendOver();
+
+    // The pyramid and the vector layers are equirectangular; the other
+    // projections are reprojected from the single image
+    bool equirect = p.projection == PROJ_EQUIRECTANGULAR;
+    if (tileSource.valid() && tileSource.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      if (tiles.init(tileSource.get(), [this] {
+            tilesArrived = true;
+            kick();
+          })) {
+        setOverlayUniforms(tiles.shader());
+        tileHighlightLoc = glGetUniformLocation(tiles.shader(), "highlightRegion");
+        layers.invalidate(LAYER_MAP);
+      } else {
+        startMapImage();
+      }
+    }
+    if (!equirect) startMapImage();
+    if (mapImage.valid() && mapImage.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      DecodedImage image = mapImage.get();
+      mapTexture = uploadTexture(image);
+    }
+
+    // Draw world map, through the projection
+    auto drawMapImage = [&](float zoom, float panX, float panY) {
+      glUseProgram(mapShaderProgram);
+      glBindVertexArray(mapVAO);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, mapTexture);
+      glUniform1f(zoomLoc, zoom);
+      glUniform2f(panLoc, panX, panY);
+      glUniform1ui(highlightLoc, p.highlightRegion);
+      glUniform1i(projectionLoc, p.projection);
+      glActiveTexture(GL_TEXTURE4);
+      glBindTexture(GL_TEXTURE_2D, inverseLuts[p.projection]);
+      glActiveTexture(GL_TEXTURE0);
+      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    };
+
+    for (int i = 0; i < p.drawCount; ++i) {
+      switch (p.draws[i].kind) {
+      case DRAW_MAP: {
+        // The map itself changes with what's under it; the overlays only
+        // with the camera
+        if (tilesChanged || spectrumChanged || p.highlightRegion != lastHighlight || p.projection != lastProjection)
+          layers.invalidate(LAYER_MAP);
+        if (p.playbackTime != lastPlaybackTime) layers.invalidate(LAYER_TRACKS);
+        lastHighlight = p.highlightRegion;
+        lastProjection = p.projection;
+        lastPlaybackTime = p.playbackTime;
+        layers.begin(p.zoom, p.panX, p.panY);
+        // Tile requests and uploads happen once here; the layer may draw in
+        // two strips
+        if (tiles.enabled() && equirect) tiles.prepare(p.zoom, layers.panX(), layers.panY(), latencyNowMs());
+        layers.update(LAYER_MAP, true, [&](float zoom, float panX, float panY) {
+          glActiveTexture(GL_TEXTURE2);
+          glBindTexture(GL_TEXTURE_1D, spectrumTexture);
+          glActiveTexture(GL_TEXTURE1);
+          glBindTexture(GL_TEXTURE_2D, regionTexture);
+          if (tiles.enabled() && equirect) {
+            glUseProgram(tiles.shader());
+            glUniform1ui(tileHighlightLoc, p.highlightRegion);
+            tiles.draw(zoom, panX, panY);
+          } else {
+            drawMapImage(zoom, panX, panY);
+          }
+        });
+        if (equirect) {
+          // Vector borders stay sharp at any zoom. The heatmap re-splats the
+          // whole view whenever the camera moves, so scrolling it saves nothing.
+          if (overlays)
+            layers.update(LAYER_OVERLAYS, !heat.enabled(), [&](float zoom, float panX, float panY) {
+              if (borders.enabled()) borders.draw(zoom, panX, panY);
+              if (markers.enabled()) markers.draw(zoom, panX, panY);
+              if (heat.enabled()) heat.draw(zoom, panX, panY);
+            });
+          if (playback.enabled())
+            layers.update(LAYER_TRACKS, true, [&](float zoom, float panX, float panY) {
+              playback.draw(p.playbackTime, zoom, panX, panY);
+            });
+#ifdef HAVE_FREETYPE
+          // Placement depends on what else is in view
+          if (labelled)
+            layers.update(LAYER_LABELS, false, [&](float zoom, float panX, float panY) {
+              drawMapLabels(text, labels, zoom, panX, panY);
+            });
+#endif
+        }
+        layers.composite(LAYER_MAP);
+        if (!equirect) break;
+        if (overlays) layers.composite(LAYER_OVERLAYS);
+        if (playback.enabled()) layers.composite(LAYER_TRACKS);
+        if (labelled) layers.composite(LAYER_LABELS);
+        break;
+      }
+      case DRAW_KOPI:
+        // Draw kopi overlay
+        glUseProgram(kopiShaderProgram);
+        glBindVertexArray(kopiVAO);
+        glBindTexture(GL_TEXTURE_2D, kopiTexture);
+        glUniform2f(offsetLoc, p.offX, p.offY);
+        glUniform1f(angleLoc, p.angle);
+        glUniform1f(aspectLoc, p.aspect);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        break;
+      }
+    }
+
+    // Once zoomed in, a minimap of the whole map with the view's rectangle
+    // on it, last in the same pass and scissored into a corner. That small,
+    // the map samples one of its smallest mips, and tiles only level 0,
+    // which is always resident: two small draws and no extra textures.
+    if (p.zoom >= kMinimapMinZoom) {
+      GLint viewport[4];
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      int w = static_cast<int>(viewport[2] * kMinimapFraction);
+      int h = w * viewport[3] / std::max(viewport[2], 1);
+      int x = viewport[0] + viewport[2] - w - kMinimapMarginPx, y = viewport[1] + kMinimapMarginPx;
+      glEnable(GL_SCISSOR_TEST);
+      fillRect(x - 1, y - 1, w + 2, h + 2, kMinimapFrame);
+      fillRect(x, y, w, h, kMinimapBackground);
+      glDisable(GL_SCISSOR_TEST);
+      // Same aspect as the main view, so the view's rectangle maps straight
+      glViewport(x, y, w, h);
+      glActiveTexture(GL_TEXTURE2);
+      glBindTexture(GL_TEXTURE_1D, spectrumTexture);
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D, regionTexture);
+      if (tiles.enabled() && equirect)
+        tiles.drawOverview();
+      else
+        drawMapImage(1.0f, 0.0f, 0.0f);
+      glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+      glEnable(GL_SCISSOR_TEST);
+      strokeRect(x + static_cast<int>((0.5f + p.panX - 0.5f / p.zoom) * w),
+                 y + static_cast<int>((0.5f + p.panY - 0.5f / p.zoom) * h),
+                 std::max(static_cast<int>(w / p.zoom), 3), std::max(static_cast<int>(h / p.zoom), 3), kMinimapView);
+      glDisable(GL_SCISSOR_TEST);
+      glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    if (latency && fresh) latency->frameSubmitted(p.latency);
+    glfwSwapBuffers(window);
+    if (latency && fresh) latency->frameSwapped();
+  }
+
+  // Cleanup
+  if (ok && latency) latency->releaseGL();
+  tiles.release();
+  borders.release();
+  markers.release();
+  heat.release();
+  playback.release();
+#ifdef HAVE_FREETYPE
+  text.release();
+#endif
+  layers.release();
+  glDeleteVertexArrays(1, &mapVAO);
+  glDeleteBuffers(1, &mapVBO);
+  glDeleteBuffers(1, &mapEBO);
+  glDeleteVertexArrays(1, &kopiVAO);
+  glDeleteBuffers(1, &kopiVBO);
+  glDeleteBuffers(1, &kopiEBO);
+  glDeleteProgram(mapShaderProgram);
+  glDeleteProgram(kopiShaderProgram);
+  glDeleteTextures(1, &mapTexture);
+  glDeleteTextures(1, &kopiTexture);
+  glDeleteTextures(1, &regionTexture);
+  glDeleteTextures(1, &spectrumTexture);
+  glDeleteTextures(kProjectionCount, inverseLuts);
+  if (mapImage.valid()) stbi_image_free(mapImage.get().data);
+  // Waits out a probe still in flight
+  if (tileSource.valid()) tileSource.get();
+  glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "frame_packet.h"
+#include "frame_pacer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+struct GLFWwindow;
+class LatencyTracker;
+class RegionMap;
+struct SpectrumFrame;
+class TrackSet;
+
+// Owns the GL context and all GL objects. The main thread keeps polling
+// events and simulating, and hands frames over through `packets`.
+class RenderThread {
+public:
+  // Joins a thread still running on an early exit
+  ~RenderThread() {
+    if (thread.joinable()) stop();
+  }
+
+  // Spawns the thread, makes the window's context current on it and creates
+  // GL resources. Blocks until setup is done; returns false if it failed.
+  bool start(GLFWwindow* window);
+  // Asks the thread to finish its current frame, frees GL resources and joins.
+  void stop();
+  // Wakes the thread after a packet has been published
+  void kick();
+
+  TripleBuffer<FramePacket> packets;
+  // frameId of the newest packet the render thread has picked up
+  std::atomic<uint64_t> consumedFrame{0};
+  // Optional, set before start()
+  LatencyTracker* latency = nullptr;
+  // Uploaded as an integer texture for highlighting; may be empty
+  const RegionMap* regions = nullptr;
+  // Played back over the map at the packet's playbackTime; may be empty
+  const TrackSet* tracks = nullptr;
+  // Band levels from the audio thread, uploaded each frame as a 1D texture
+  // for the map shader; null leaves the visualizer off
+  TripleBuffer<SpectrumFrame>* spectrum = nullptr;
+  // Draw res/markers.kmrk as a weighted density heatmap instead of markers
+  bool heatmap = false;
+  FramePacingConfig pacing;
+
+private:
+  void run(GLFWwindow* window);
+
+  std::thread thread;
+  std::atomic<bool> quit{false};
+  std::atomic<int> initState{0}; // 0 = pending, 1 = ok, -1 = failed
+  // Set by the tile loader, or the map image decode, when there is
+  // something new to upload
+  std::atomic<bool> tilesArrived{false};
+  // Only used to sleep while there is nothing to draw, never to pass data
+  std::mutex wakeMutex;
+  std::condition_variable wakeCv;
+};
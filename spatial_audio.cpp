@@ -0,0 +1,367 @@
+#include "spatial_audio.h"
+
+#include "audio_assets.h"
+#include "region_map.h"
+#include "voice_manager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SPATIAL_SEND_SSE 1
+#endif
+
+// Writes both outputs while the input is in cache; four samples per step
+// where SSE is available. Replaces a splitter plus two bus volumes, which
+// would copy the input and then scale it again while mixing.
+static void sendNodeProcess(ma_node* node, const float** ppFramesIn, ma_uint32*,
+                            float** ppFramesOut, ma_uint32* pFrameCountOut) {
+  SendNode* n = static_cast<SendNode*>(node);
+  const float* in = ppFramesIn[0];
+  float* dry = ppFramesOut[0];
+  float* send = ppFramesOut[1];
+  size_t count = static_cast<size_t>(*pFrameCountOut) * n->channels;
+  float dryGain = n->dry.load(std::memory_order_relaxed);
+  float sendGain = n->send.load(std::memory_order_relaxed);
+  size_t i = 0;
+#ifdef SPATIAL_SEND_SSE
+  __m128 d = _mm_set1_ps(dryGain);
+  __m128 s = _mm_set1_ps(sendGain);
+  for (; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(in + i);
+    _mm_storeu_ps(dry + i, _mm_mul_ps(x, d));
+    _mm_storeu_ps(send + i, _mm_mul_ps(x, s));
+  }
+#endif
+  for (; i < count; ++i) {
+    dry[i] = in[i] * dryGain;
+    send[i] = in[i] * sendGain;
+  }
+}
+
+static ma_node_vtable kSendNodeVtable = {
+  sendNodeProcess,
+  NULL, // same frame count in and out
+  1,    // input buses
+  2,    // output buses: dry, send
+  0
+};
+
+static ma_result sendNodeInit(ma_node_graph* graph, ma_uint32 channels, SendNode* n) {
+  ma_uint32 outChannels[2] = { channels, channels };
+  ma_node_config config = ma_node_config_init();
+  config.vtable = &kSendNodeVtable;
+  config.pInputChannels = &channels;
+  config.pOutputChannels = outChannels;
+  n->channels = channels;
+  n->dry.store(1.0f, std::memory_order_relaxed);
+  n->send.store(0.0f, std::memory_order_relaxed);
+  return ma_node_init(graph, &config, NULL, &n->base);
+}
+
+// Fraction of the remaining distance to the target cutoff, in octaves,
+// covered per period; a listener jump glides over a few tens of ms
+constexpr float kCutoffGlide = 0.35f;
+
+static void lowpassNodeProcess(ma_node* node, const float** ppFramesIn, ma_uint32*,
+                               float** ppFramesOut, ma_uint32* pFrameCountOut) {
+  LowpassNode* n = static_cast<LowpassNode*>(node);
+  float target = n->target.load(std::memory_order_relaxed);
+  // Biquad coefficients are recomputed on reinit; skip changes nobody hears
+  if (std::fabs(target - n->cutoff) > n->cutoff * 0.02f) {
+    float cutoff = n->cutoff * std::pow(target / n->cutoff, kCutoffGlide);
+    ma_lpf2_config config = ma_lpf2_config_init(ma_format_f32, n->channels, n->sampleRate, cutoff, 0.707107);
+    // Reinit keeps the filter's state, so the glide doesn't click
+    if (ma_lpf2_reinit(&config, &n->lpf) == MA_SUCCESS) n->cutoff = cutoff;
+  }
+  ma_lpf2_process_pcm_frames(&n->lpf, ppFramesOut[0], ppFramesIn[0], *pFrameCountOut);
+}
+
+static ma_node_vtable kLowpassNodeVtable = {
+  lowpassNodeProcess,
+  NULL, // same frame count in and out
+  1,
+  1,
+  0
+};
+
+static ma_result lowpassNodeInit(ma_node_graph* graph, ma_uint32 channels, ma_uint32 sampleRate, float cutoff,
+                                 LowpassNode* n) {
+  n->channels = channels;
+  n->sampleRate = sampleRate;
+  n->cutoff = cutoff;
+  n->target.store(cutoff, std::memory_order_relaxed);
+  ma_lpf2_config lpfConfig = ma_lpf2_config_init(ma_format_f32, channels, sampleRate, cutoff, 0.707107);
+  ma_result result = ma_lpf2_init(&lpfConfig, NULL, &n->lpf);
+  if (result != MA_SUCCESS) return result;
+  ma_node_config config = ma_node_config_init();
+  config.vtable = &kLowpassNodeVtable;
+  config.pInputChannels = &channels;
+  config.pOutputChannels = &channels;
+  result = ma_node_init(graph, &config, NULL, &n->base);
+  if (result != MA_SUCCESS) ma_lpf2_uninit(&n->lpf, NULL);
+  return result;
+}
+
+static void lowpassNodeUninit(LowpassNode* n) {
+  ma_node_uninit(&n->base, NULL);
+  ma_lpf2_uninit(&n->lpf, NULL);
+}
+
+SpatialAudio::~SpatialAudio() {
+  uninit();
+}
+
+bool SpatialAudio::init(ma_engine* engine, const SpatialConfig& config) {
+  this->engine = engine;
+  this->config = config;
+  ma_node_graph* graph = ma_engine_get_node_graph(engine);
+  ma_uint32 channels = ma_engine_get_channels(engine);
+  ma_uint32 sampleRate = ma_engine_get_sample_rate(engine);
+
+  if (ma_fence_init(&loadFence) != MA_SUCCESS) return false;
+  // Both buses feed the endpoint; voices attach to them, not to it
+  if (ma_sound_group_init(engine, 0, NULL, &dryBus) != MA_SUCCESS) {
+    ma_fence_uninit(&loadFence);
+    return false;
+  }
+  // miniaudio has no reverb node; a feedback delay on a shared bus is the
+  // nearest built-in, and costs the same however many voices send to it
+  ma_uint32 delayFrames = static_cast<ma_uint32>(config.reverbDelayMs * sampleRate / 1000.0f);
+  ma_delay_node_config delayConfig = ma_delay_node_config_init(channels, sampleRate, std::max(delayFrames, 1u), config.reverbDecay);
+  if (ma_delay_node_init(graph, &delayConfig, NULL, &reverb) != MA_SUCCESS) {
+    ma_sound_group_uninit(&dryBus);
+    ma_fence_uninit(&loadFence);
+    return false;
+  }
+  ma_delay_node_set_dry(&reverb, 0.0f);
+  ma_node_attach_output_bus(&reverb, 0, ma_engine_get_endpoint(engine), 0);
+  initialized = true;
+  return true;
+}
+
+void SpatialAudio::uninit() {
+  if (!initialized) return;
+  // Sounds must not be torn down under a running load job
+  ma_fence_wait(&loadFence);
+  for (auto& e : emitters) destroy(*e);
+  emitters.clear();
+  ma_delay_node_uninit(&reverb, NULL);
+  ma_sound_group_uninit(&dryBus);
+  ma_fence_uninit(&loadFence);
+  initialized = false;
+}
+
+void SpatialAudio::waitAll() {
+  if (initialized) ma_fence_wait(&loadFence);
+}
+
+void SpatialAudio::toWorld(float u, float v, float* x, float* z) const {
+  // Map up is the listener's forward, -Z
+  *x = (u - 0.5f) * config.worldW;
+  *z = (0.5f - v) * config.worldH;
+}
+
+bool SpatialAudio::attach(Emitter& e, float u, float v) {
+  ma_node_graph* graph = ma_engine_get_node_graph(engine);
+  ma_uint32 channels = ma_engine_get_channels(engine);
+  ma_uint32 sampleRate = ma_engine_get_sample_rate(engine);
+
+  toWorld(u, v, &e.x, &e.z);
+  float distance = std::hypot(e.x - listenerX, e.z - listenerZ);
+  // Start at the right cutoff rather than gliding to it
+  if (lowpassNodeInit(graph, channels, sampleRate, cutoffAt(distance), &e.lpf) != MA_SUCCESS) return false;
+  e.lpfInitialized = true;
+  if (sendNodeInit(graph, channels, &e.send) != MA_SUCCESS) return false;
+  e.sendInitialized = true;
+
+  // Tune before attaching, while the audio thread can't see the nodes yet
+  retune(e, distance);
+  ma_node_attach_output_bus(&e.lpf, 0, &e.send, 0);
+  ma_node_attach_output_bus(&e.send, 0, &dryBus, 0);
+  ma_node_attach_output_bus(&e.send, 1, &reverb, 0);
+  return true;
+}
+
+void SpatialAudio::destroy(Emitter& e) {
+  if (e.soundInitialized) ma_sound_uninit(&e.sound);
+  if (e.sendInitialized) ma_node_uninit(&e.send.base, NULL);
+  if (e.lpfInitialized) lowpassNodeUninit(&e.lpf);
+}
+
+bool SpatialAudio::addEmitter(const char* path, ma_uint32 flags, float u, float v) {
+  ma_sound_config soundConfig = ma_sound_config_init_2(engine);
+  soundConfig.pFilePath = path;
+  // Plays silence until the shared buffer has decoded, or the stream's
+  // first pages are in
+  soundConfig.flags = flags | MA_SOUND_FLAG_ASYNC;
+  soundConfig.initNotifications = ma_resource_manager_pipeline_notifications_init();
+  // miniaudio never releases a stream's done fence, only its init fence
+  if (flags & MA_SOUND_FLAG_STREAM) soundConfig.initNotifications.init.pFence = &loadFence;
+  else soundConfig.initNotifications.done.pFence = &loadFence;
+  return addEmitter(soundConfig, u, v);
+}
+
+bool SpatialAudio::addEmitter(ma_data_source* source, float u, float v) {
+  ma_sound_config soundConfig = ma_sound_config_init_2(engine);
+  soundConfig.pDataSource = source;
+  return addEmitter(soundConfig, u, v);
+}
+
+bool SpatialAudio::addEmitter(ma_sound_config& soundConfig, float u, float v) {
+  if (!initialized) return false;
+  auto e = std::make_unique<Emitter>();
+  if (!attach(*e, u, v)) {
+    destroy(*e);
+    return false;
+  }
+  soundConfig.pInitialAttachment = &e->lpf;
+  soundConfig.flags |= MA_SOUND_FLAG_LOOPING;
+  if (ma_sound_init_ex(engine, &soundConfig, &e->sound) != MA_SUCCESS) {
+    destroy(*e);
+    return false;
+  }
+  e->soundInitialized = true;
+  ma_sound_set_position(&e->sound, e->x, 0.0f, e->z);
+  ma_sound_set_min_distance(&e->sound, config.minDistance);
+  ma_sound_set_max_distance(&e->sound, config.maxDistance);
+  if (voices) voices->add(&e->sound, 0, {&e->lpf, &e->send.base});
+  else ma_sound_start(&e->sound);
+  emitters.push_back(std::move(e));
+  return true;
+}
+
+int SpatialAudio::addRegionEmitters(const RegionMap& regions, AudioAssets& tracks) {
+  int count = tracks.count();
+  if (count <= 0) return 0;
+  int added = 0;
+  for (const RegionCentroid& c : regions.centroids()) {
+    int track = c.id % count;
+    // Missing files would only produce silent voices
+    if (!tracks.sound(track)) continue;
+    if (!addEmitter(tracks.path(track).c_str(), tracks.userFlags(track), c.u, c.v)) continue;
+    tracks.addUser(track);
+    ++added;
+  }
+  return added;
+}
+
+float SpatialAudio::falloff(float distance) const {
+  float t = (distance - config.minDistance) / std::max(config.maxDistance - config.minDistance, 1e-3f);
+  return std::clamp(t, 0.0f, 1.0f);
+}
+
+float SpatialAudio::cutoffAt(float distance) const {
+  // Cutoff falls off exponentially, i.e. linearly in octaves
+  return config.nearCutoffHz * std::pow(config.farCutoffHz / config.nearCutoffHz, falloff(distance));
+}
+
+void SpatialAudio::retune(Emitter& e, float distance) {
+  // The filter glides there itself, on the audio thread
+  e.lpf.target.store(cutoffAt(distance), std::memory_order_relaxed);
+  e.send.send.store(config.reverbSend * falloff(distance), std::memory_order_relaxed);
+}
+
+void SpatialAudio::setListener(float u, float v) {
+  if (!initialized) return;
+  toWorld(u, v, &listenerX, &listenerZ);
+  ma_engine_listener_set_position(engine, 0, listenerX, 0.0f, listenerZ);
+  for (auto& e : emitters) retune(*e, std::hypot(e->x - listenerX, e->z - listenerZ));
+}
+
+constexpr ma_uint32 kBenchRate = 48000;
+constexpr ma_uint32 kBenchChannels = 2;
+constexpr ma_uint32 kBenchPeriod = 480; // 10 ms
+
+// One config of the bench; maxReal 0 mixes every emitter. Returns the mean
+// milliseconds spent per period, or a negative value on failure.
+static double benchGraph(const std::vector<float>& pcm, int voices, int maxReal) {
+  constexpr int kPeriods = 300;
+  constexpr int kWarmup = 20;
+
+  ma_engine_config engineConfig = ma_engine_config_init();
+  engineConfig.noDevice = MA_TRUE;
+  engineConfig.channels = kBenchChannels;
+  engineConfig.sampleRate = kBenchRate;
+  ma_engine engine;
+  if (ma_engine_init(&engineConfig, &engine) != MA_SUCCESS) return -1.0;
+
+  std::vector<std::unique_ptr<ma_audio_buffer>> buffers;
+  double totalMs = 0.0;
+  {
+    VoiceManager manager;
+    manager.init(&engine, VoiceConfig{maxReal});
+    SpatialAudio spatial;
+    if (maxReal > 0) spatial.voices = &manager;
+    spatial.init(&engine, SpatialConfig());
+    uint32_t seed = 12345;
+    auto rand01 = [&] {
+      seed = seed * 1664525u + 1013904223u;
+      return (seed >> 8) / 16777216.0f;
+    };
+    for (int i = 0; i < voices; ++i) {
+      buffers.push_back(std::make_unique<ma_audio_buffer>());
+      ma_audio_buffer_config bufferConfig = ma_audio_buffer_config_init(ma_format_f32, kBenchChannels, kBenchRate, pcm.data(), NULL);
+      ma_audio_buffer_init(&bufferConfig, buffers.back().get());
+      // Start each voice at a different offset so they don't sum coherently
+      ma_audio_buffer_seek_to_pcm_frame(buffers.back().get(), static_cast<ma_uint64>(rand01() * (kBenchRate - 1)));
+      spatial.addEmitter(buffers.back().get(), rand01(), rand01());
+    }
+
+    std::vector<float> mix(kBenchPeriod * kBenchChannels);
+    for (int p = 0; p < kWarmup + kPeriods; ++p) {
+      // The listener sweeps the map once over the run, as a drag would
+      float t = static_cast<float>(p) / (kWarmup + kPeriods);
+      auto begin = std::chrono::steady_clock::now();
+      spatial.setListener(t, 0.5f + 0.25f * std::sin(6.2831853f * t));
+      if (maxReal > 0) manager.update();
+      ma_engine_read_pcm_frames(&engine, mix.data(), kBenchPeriod, NULL);
+      auto end = std::chrono::steady_clock::now();
+      if (p >= kWarmup) totalMs += std::chrono::duration<double, std::milli>(end - begin).count();
+    }
+    spatial.uninit();
+  }
+  for (auto& b : buffers) ma_audio_buffer_uninit(b.get());
+  ma_engine_uninit(&engine);
+  return totalMs / kPeriods;
+}
+
+void runSpatialBench(std::ostream& out) {
+  const double periodMs = 1000.0 * kBenchPeriod / kBenchRate;
+  constexpr int kCappedVoices = 32;
+
+  // One second of a two-tone signal shared by every voice, so the numbers
+  // measure the graph rather than decoding
+  std::vector<float> pcm(kBenchRate * kBenchChannels);
+  for (ma_uint32 i = 0; i < kBenchRate; ++i) {
+    float s = 0.25f * std::sin(2.0f * 3.14159265f * 220.0f * i / kBenchRate) +
+              0.10f * std::sin(2.0f * 3.14159265f * 1375.0f * i / kBenchRate);
+    pcm[i * kBenchChannels] = pcm[i * kBenchChannels + 1] = s;
+  }
+
+  out << "Spatial audio bench: " << kBenchRate << " Hz, " << kBenchPeriod << " frame periods ("
+      << periodMs << " ms)\n";
+  for (int maxReal : {0, kCappedVoices}) {
+    if (maxReal) out << "At most " << maxReal << " real voices:\n";
+    else out << "All voices mixed:\n";
+    out << " voices  ms/period    load  voices/ms  realtime\n";
+    for (int voices = 16; voices <= 512; voices *= 2) {
+      double ms = benchGraph(pcm, voices, maxReal);
+      if (ms < 0.0) {
+        out << "Failed to initialize miniaudio engine\n";
+        return;
+      }
+      out << std::fixed << std::setprecision(3)
+          << std::setw(7) << voices
+          << std::setw(11) << ms
+          << std::setw(7) << std::setprecision(1) << 100.0 * ms / periodMs << "%"
+          << std::setw(11) << voices / std::max(ms, 1e-9)
+          << std::setw(9) << periodMs / std::max(ms, 1e-9) << "x\n"
+          << std::defaultfloat << std::setprecision(6);
+    }
+  }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <miniaudio.h>
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+class AudioAssets;
+class RegionMap;
+class VoiceManager;
+
+struct SpatialConfig {
+  // Size of the map in world units; distances below are in the same units
+  float worldW = 100.0f;
+  float worldH = 50.0f;
+  float minDistance = 4.0f;    // full volume and full bandwidth inside this
+  float maxDistance = 60.0f;   // attenuation and filtering stop growing here
+  float nearCutoffHz = 16000.0f;
+  float farCutoffHz = 600.0f;
+  float reverbSend = 0.6f;     // send level at maxDistance, 0 at minDistance
+  float reverbDelayMs = 80.0f;
+  float reverbDecay = 0.5f;
+};
+
+// Per-voice dry/send split: one input, two outputs (0 = dry, 1 = send), both
+// written in one pass over the input
+struct SendNode {
+  ma_node_base base; // must be first
+  ma_uint32 channels;
+  std::atomic<float> dry;
+  std::atomic<float> send;
+};
+
+// Second-order low-pass whose cutoff is set from any thread: the node glides
+// towards `target` on its own thread, recomputing its coefficients there, so
+// the filter is never reinitialised under the mixer
+struct LowpassNode {
+  ma_node_base base; // must be first
+  ma_lpf2 lpf;
+  ma_uint32 channels;
+  ma_uint32 sampleRate;
+  float cutoff;               // audio thread only
+  std::atomic<float> target;
+};
+
+// Looping emitters placed in map space and heard from a listener that
+// follows the kopi. Each voice runs
+//
+//   ma_sound (spatialized) -> LowpassNode -> SendNode -+-> dry bus ----> endpoint
+//                                                      +-> reverb bus -> endpoint
+//
+// where the low-pass cutoff and the reverb send follow the voice's distance
+// to the listener. Emitters loaded from a file share the resource manager's
+// decoded buffer with every other sound using that file, so adding one only
+// costs its cursor and its nodes.
+//
+// With a VoiceManager, emitters are handed to it instead of started, and a
+// virtual emitter's filter and send nodes stop along with its sound.
+//
+// Same threading rule as AudioAssets: emitters are added before the audio
+// control thread takes over, after which only that thread may call in.
+class SpatialAudio {
+public:
+  SpatialAudio() = default;
+  SpatialAudio(const SpatialAudio&) = delete;
+  SpatialAudio& operator=(const SpatialAudio&) = delete;
+  ~SpatialAudio();
+
+  bool init(ma_engine* engine, const SpatialConfig& config);
+  void uninit();
+  // Blocks until every emitter's file has decoded
+  void waitAll();
+
+  // Emitter at map coordinate (u, v) playing `path` on a loop, loaded with
+  // `flags` (MA_SOUND_FLAG_DECODE or MA_SOUND_FLAG_STREAM)
+  bool addEmitter(const char* path, ma_uint32 flags, float u, float v);
+  // Same, reading from a caller-owned data source that outlives the emitter
+  bool addEmitter(ma_data_source* source, float u, float v);
+  // One emitter at the centroid of each region, region ID modulo the track
+  // count picking the track. Each loads its track the way `tracks` does, so
+  // the memory budget holds. Returns the number added.
+  int addRegionEmitters(const RegionMap& regions, AudioAssets& tracks);
+
+  // Move the listener to map coordinate (u, v) and retune every voice
+  void setListener(float u, float v);
+  int emitterCount() const { return static_cast<int>(emitters.size()); }
+
+  // Optional, set before init()
+  VoiceManager* voices = nullptr;
+
+private:
+  struct Emitter {
+    ma_sound sound;
+    LowpassNode lpf;
+    SendNode send;
+    float x = 0.0f, z = 0.0f;
+    bool soundInitialized = false;
+    bool lpfInitialized = false;
+    bool sendInitialized = false;
+  };
+
+  bool addEmitter(ma_sound_config& soundConfig, float u, float v);
+  bool attach(Emitter& e, float u, float v);
+  void destroy(Emitter& e);
+  void retune(Emitter& e, float distance);
+  // 0 inside minDistance to 1 at maxDistance
+  float falloff(float distance) const;
+  float cutoffAt(float distance) const;
+  void toWorld(float u, float v, float* x, float* z) const;
+
+  ma_engine* engine = nullptr;
+  SpatialConfig config;
+  std::vector<std::unique_ptr<Emitter>> emitters;
+  ma_sound_group dryBus;
+  ma_delay_node reverb;
+  ma_fence loadFence;
+  bool initialized = false;
+  float listenerX = 0.0f, listenerZ = 0.0f;
+};
+
+// Renders the graph with no device for 16 to 512 emitters and reports how
+// many voices fit in a millisecond of audio callback time
+void runSpatialBench(std::ostream& out);
@@ -0,0 +1,155 @@
+#include "spectrum.h"
+
+#include "latency.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SPECTRUM_FFT_SSE 1
+#endif
+
+constexpr float kPi = 3.14159265358979f;
+constexpr float kLowestHz = 40.0f;
+constexpr float kFloorDb = -60.0f;
+constexpr float kReleaseSeconds = 0.15f;
+
+void SpectrumAnalyzer::init(uint32_t sampleRate, uint32_t channels) {
+  this->sampleRate = sampleRate;
+  this->channels = channels;
+  history.assign(kFftSize, 0.0f);
+  re.assign(kFftSize, 0.0f);
+  im.assign(kFftSize, 0.0f);
+
+  window.resize(kFftSize);
+  for (int i = 0; i < kFftSize; ++i)
+    window[i] = 0.5f - 0.5f * std::cos(2.0f * kPi * i / (kFftSize - 1));
+
+  int bits = 0;
+  while ((1 << bits) < kFftSize) ++bits;
+  bitReverse.resize(kFftSize);
+  for (int i = 0; i < kFftSize; ++i) {
+    int r = 0;
+    for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+    bitReverse[i] = static_cast<uint16_t>(r);
+  }
+
+  // Stage with half-size h keeps its h twiddles at offset h - 1
+  twiddleRe.resize(kFftSize - 1);
+  twiddleIm.resize(kFftSize - 1);
+  for (int half = 1; half < kFftSize; half <<= 1) {
+    for (int j = 0; j < half; ++j) {
+      float a = -kPi * j / half;
+      twiddleRe[half - 1 + j] = std::cos(a);
+      twiddleIm[half - 1 + j] = std::sin(a);
+    }
+  }
+
+  // Log-spaced band edges, each band at least one bin wide
+  float nyquist = sampleRate * 0.5f;
+  float highest = std::min(16000.0f, nyquist);
+  float binHz = static_cast<float>(sampleRate) / kFftSize;
+  int prev = 0;
+  for (int b = 0; b <= kSpectrumBands; ++b) {
+    float hz = kLowestHz * std::pow(highest / kLowestHz, static_cast<float>(b) / kSpectrumBands);
+    int bin = std::max(1, static_cast<int>(hz / binHz));
+    if (b > 0) bin = std::max(bin, prev + 1);
+    bandFirst[b] = std::min(bin, kFftSize / 2);
+    prev = bandFirst[b];
+  }
+
+  release = std::exp(-static_cast<float>(kHop) / (sampleRate * kReleaseSeconds));
+  writePos = sinceLast = 0;
+  busyMs = 0.0;
+  framesSeen = 0;
+}
+
+void SpectrumAnalyzer::process(const float* frames, uint64_t frameCount) {
+  if (history.empty() || !frames) return;
+  double begin = latencyNowMs();
+  float scale = 1.0f / channels;
+  for (uint64_t f = 0; f < frameCount; ++f) {
+    float sum = 0.0f;
+    for (uint32_t c = 0; c < channels; ++c) sum += frames[f * channels + c];
+    history[writePos] = sum * scale;
+    writePos = (writePos + 1) & (kFftSize - 1);
+    if (++sinceLast == kHop) {
+      sinceLast = 0;
+      analyze();
+    }
+  }
+  framesSeen += frameCount;
+  busyMs += latencyNowMs() - begin;
+}
+
+void SpectrumAnalyzer::analyze() {
+  // Oldest sample first, windowed, into bit-reversed order
+  for (int i = 0; i < kFftSize; ++i) {
+    int r = bitReverse[i];
+    re[r] = history[(writePos + i) & (kFftSize - 1)] * window[i];
+    im[r] = 0.0f;
+  }
+  fft();
+
+  // Hann window has a coherent gain of 0.5, so a full-scale sine peaks at 0 dB
+  const float norm = 4.0f / kFftSize;
+  SpectrumFrame& out = this->frames.writeSlot();
+  for (int b = 0; b < kSpectrumBands; ++b) {
+    float peak = 0.0f;
+    int last = std::max(bandFirst[b] + 1, bandFirst[b + 1]);
+    for (int k = bandFirst[b]; k < last && k <= kFftSize / 2; ++k)
+      peak = std::max(peak, re[k] * re[k] + im[k] * im[k]);
+    float db = 10.0f * std::log10(peak * norm * norm + 1e-12f);
+    float level = std::clamp((db - kFloorDb) / -kFloorDb, 0.0f, 1.0f);
+    // Instant attack, exponential release
+    levels[b] = std::max(level, levels[b] * release);
+    out.bands[b] = levels[b];
+  }
+  this->frames.publish();
+}
+
+void SpectrumAnalyzer::fft() {
+  float* xr = re.data();
+  float* xi = im.data();
+  for (int half = 1; half < kFftSize; half <<= 1) {
+    const float* wr = &twiddleRe[half - 1];
+    const float* wi = &twiddleIm[half - 1];
+    for (int k = 0; k < kFftSize; k += 2 * half) {
+      float* ar = xr + k;
+      float* ai = xi + k;
+      float* br = ar + half;
+      float* bi = ai + half;
+      int j = 0;
+#ifdef SPECTRUM_FFT_SSE
+      // Four butterflies at a time once stages are wide enough
+      for (; j + 4 <= half; j += 4) {
+        __m128 cr = _mm_loadu_ps(wr + j), ci = _mm_loadu_ps(wi + j);
+        __m128 vbr = _mm_loadu_ps(br + j), vbi = _mm_loadu_ps(bi + j);
+        __m128 tr = _mm_sub_ps(_mm_mul_ps(vbr, cr), _mm_mul_ps(vbi, ci));
+        __m128 ti = _mm_add_ps(_mm_mul_ps(vbr, ci), _mm_mul_ps(vbi, cr));
+        __m128 var = _mm_loadu_ps(ar + j), vai = _mm_loadu_ps(ai + j);
+        _mm_storeu_ps(ar + j, _mm_add_ps(var, tr));
+        _mm_storeu_ps(ai + j, _mm_add_ps(vai, ti));
+        _mm_storeu_ps(br + j, _mm_sub_ps(var, tr));
+        _mm_storeu_ps(bi + j, _mm_sub_ps(vai, ti));
+      }
+#endif
+      for (; j < half; ++j) {
+        float tr = br[j] * wr[j] - bi[j] * wi[j];
+        float ti = br[j] * wi[j] + bi[j] * wr[j];
+        br[j] = ar[j] - tr;
+        bi[j] = ai[j] - ti;
+        ar[j] += tr;
+        ai[j] += ti;
+      }
+    }
+  }
+}
+
+void SpectrumAnalyzer::report(std::ostream& out) const {
+  if (framesSeen == 0) return;
+  double audioMs = 1000.0 * framesSeen / sampleRate;
+  out << "Spectrum analysis: " << busyMs << " ms for " << audioMs / 1000.0 << " s of audio ("
+      << 100.0 * busyMs / audioMs << "% of the callback budget)\n";
+}
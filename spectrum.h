@@ -0,0 +1,53 @@
+#pragma once
+
+#include "frame_packet.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+constexpr int kSpectrumBands = 32;
+
+// Band levels in [0, 1], log-spaced from 40 Hz up, -60 dB..0 dB mapped linearly
+struct SpectrumFrame {
+  float bands[kSpectrumBands];
+};
+
+// Windowed FFT over the engine's output mix. process() runs on the audio
+// thread and never allocates: the sample history, FFT scratch, twiddles and
+// bin-to-band table are all built in init(). Every hop it publishes fresh
+// band levels through `frames`, read by the render thread.
+class SpectrumAnalyzer {
+public:
+  static constexpr int kFftSize = 1024;
+  static constexpr int kHop = 512;
+
+  void init(uint32_t sampleRate, uint32_t channels);
+  // Interleaved f32 frames, as handed to ma_engine_config::onProcess
+  void process(const float* frames, uint64_t frameCount);
+
+  // Time spent in process() against the audio it covered
+  void report(std::ostream& out) const;
+
+  TripleBuffer<SpectrumFrame> frames;
+
+private:
+  void analyze();
+  void fft();
+
+  uint32_t sampleRate = 0;
+  uint32_t channels = 0;
+  std::vector<float> history;    // mono ring, kFftSize
+  int writePos = 0;
+  int sinceLast = 0;
+  std::vector<float> window;
+  std::vector<float> re, im;
+  std::vector<uint16_t> bitReverse;
+  std::vector<float> twiddleRe, twiddleIm; // per stage, contiguous
+  int bandFirst[kSpectrumBands + 1];       // first bin of each band
+  float levels[kSpectrumBands] = {};
+  float release = 0.0f;
+
+  double busyMs = 0.0;
+  uint64_t framesSeen = 0;
+};
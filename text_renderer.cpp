@@ -0,0 +1,165 @@
+#include "text_renderer.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+// Unit quad, drawn as a strip and stretched over each glyph
+constexpr float kCorners[] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+
+// Next codepoint from UTF-8, advancing `i`; malformed bytes come out as
+// U+FFFD one at a time
+static uint32_t decodeUtf8(const std::string& s, size_t& i) {
+  unsigned char c = static_cast<unsigned char>(s[i++]);
+  if (c < 0x80) return c;
+  int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : -1;
+  if (extra < 0 || i + extra > s.size()) return 0xFFFD;
+  uint32_t cp = c & (0x3F >> extra);
+  for (int k = 0; k < extra; ++k) {
+    unsigned char cc = static_cast<unsigned char>(s[i + k]);
+    if ((cc & 0xC0) != 0x80) return 0xFFFD;
+    cp = (cp << 6) | (cc & 0x3F);
+  }
+  i += extra;
+  return cp;
+}
+
+bool TextRenderer::init(const char* fontPath) {
+  if (!atlas.init(fontPath)) return false;
+
+  program = loadProgram("glsl/vertex_text.glsl", "glsl/fragment_text.glsl");
+  viewportLoc = glGetUniformLocation(program, "viewport");
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "glyphs"), 0);
+
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &quadVBO);
+  glGenBuffers(1, &instanceVBO);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kCorners), kCorners, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  glBufferData(GL_ARRAY_BUFFER, kMaxGlyphs * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, rect));
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, texRect));
+  glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (void*)offsetof(Instance, color));
+  for (int a = 1; a <= 3; ++a) {
+    glEnableVertexAttribArray(a);
+    glVertexAttribDivisor(a, 1);
+  }
+  glBindVertexArray(0);
+
+  instances.reserve(kMaxGlyphs);
+  return true;
+}
+
+void TextRenderer::release() {
+  atlas.release();
+  glDeleteVertexArrays(1, &vao);
+  glDeleteBuffers(1, &quadVBO);
+  glDeleteBuffers(1, &instanceVBO);
+  glDeleteProgram(program);
+  vao = quadVBO = instanceVBO = program = 0;
+  layoutIds.clear();
+  layouts.clear();
+  placed.clear();
+}
+
+int TextRenderer::layout(const std::string& utf8) {
+  auto it = layoutIds.find(utf8);
+  if (it != layoutIds.end()) return it->second;
+
+  Layout l = {static_cast<uint32_t>(placed.size()), 0, 0.0f};
+  float pen = 0.0f;
+  uint32_t prev = UINT32_MAX;
+  for (size_t i = 0; i < utf8.size();) {
+    uint32_t id = atlas.glyphId(decodeUtf8(utf8, i));
+    if (prev != UINT32_MAX) pen += atlas.kerning(prev, id);
+    placed.push_back({id, pen});
+    pen += atlas.glyph(id).advance;
+    prev = id;
+  }
+  l.count = static_cast<uint32_t>(placed.size()) - l.first;
+  l.width = pen;
+  int id = static_cast<int>(layouts.size());
+  layouts.push_back(l);
+  layoutIds.emplace(utf8, id);
+  return id;
+}
+
+float TextRenderer::width(int layoutId, float sizePx) const {
+  return layouts[layoutId].width * sizePx / GlyphAtlas::kGlyphPx;
+}
+
+void TextRenderer::begin(int w, int h) {
+  viewW = w;
+  viewH = h;
+  gridW = (w + kGridCell - 1) / kGridCell;
+  gridH = (h + kGridCell - 1) / kGridCell;
+  grid.assign(static_cast<size_t>(gridW) * gridH, 0);
+  instances.clear();
+  atlas.nextFrame();
+}
+
+bool TextRenderer::claim(float x0, float y0, float x1, float y1) {
+  int cx0 = std::max(0, static_cast<int>(std::floor(x0 / kGridCell)));
+  int cy0 = std::max(0, static_cast<int>(std::floor(y0 / kGridCell)));
+  int cx1 = std::min(gridW - 1, static_cast<int>(std::floor(x1 / kGridCell)));
+  int cy1 = std::min(gridH - 1, static_cast<int>(std::floor(y1 / kGridCell)));
+  if (cx0 > cx1 || cy0 > cy1) return false; // entirely off screen
+  for (int y = cy0; y <= cy1; ++y) {
+    const uint8_t* row = &grid[static_cast<size_t>(y) * gridW];
+    for (int x = cx0; x <= cx1; ++x)
+      if (row[x]) return false;
+  }
+  for (int y = cy0; y <= cy1; ++y) std::memset(&grid[static_cast<size_t>(y) * gridW + cx0], 1, cx1 - cx0 + 1);
+  return true;
+}
+
+bool TextRenderer::add(int layoutId, float x, float y, float sizePx, uint32_t rgba) {
+  const Layout& l = layouts[layoutId];
+  if (instances.size() + l.count > kMaxGlyphs) return false;
+  float scale = sizePx / GlyphAtlas::kGlyphPx;
+  float halfW = 0.5f * l.width * scale;
+  float top = atlas.ascender * scale, bottom = atlas.descender * scale;
+  float baseline = y - 0.5f * (top + bottom);
+  if (!claim(x - halfW - kPaddingPx, baseline + bottom - kPaddingPx, x + halfW + kPaddingPx,
+             baseline + top + kPaddingPx))
+    return false;
+
+  const float texel = 1.0f / GlyphAtlas::kAtlasSize;
+  for (uint32_t i = l.first; i < l.first + l.count; ++i) {
+    const Placed& p = placed[i];
+    int slot = atlas.acquire(p.glyph);
+    const GlyphAtlas::Glyph& g = atlas.glyph(p.glyph);
+    if (slot < 0 || g.width == 0) continue;
+    float gx = x - halfW + (p.x + g.left) * scale;
+    float gy = baseline + g.top * scale;
+    float s = (slot % GlyphAtlas::kCellsPerRow) * GlyphAtlas::kCellSize * texel;
+    float t = (slot / GlyphAtlas::kCellsPerRow) * GlyphAtlas::kCellSize * texel;
+    // The atlas has the glyph's top row first
+    instances.push_back({{gx, gy - g.height * scale, gx + g.width * scale, gy},
+                         {s, t + g.height * texel, s + g.width * texel, t},
+                         rgba});
+  }
+  return true;
+}
+
+void TextRenderer::draw() {
+  if (instances.empty()) return;
+  glUseProgram(program);
+  glUniform2f(viewportLoc, static_cast<float>(viewW), static_cast<float>(viewH));
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, atlas.atlasTexture());
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  // Orphan last frame's instances instead of waiting on them
+  glBufferData(GL_ARRAY_BUFFER, kMaxGlyphs * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(Instance), instances.data());
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instances.size()));
+  glBindVertexArray(0);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "glyph_atlas.h"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Batched label text over a GlyphAtlas. Strings are laid out once (UTF-8
+// decoding, advances and kerning) and cached by their text; SDF glyphs
+// scale, so one layout serves every size. Each frame, labels are offered in
+// priority order between begin() and draw(): one that would overlap an
+// already placed label in a coarse screen-space occupancy grid is dropped,
+// the rest become glyph instances that go out in one instanced draw.
+//
+// Render thread only, with the GL context current.
+class TextRenderer {
+public:
+  static constexpr size_t kMaxGlyphs = 32768;
+  static constexpr int kGridCell = 8; // pixels per collision cell
+  static constexpr float kPaddingPx = 2.0f;
+
+  // False if the font at `fontPath` can't be loaded
+  bool init(const char* fontPath);
+  void release();
+  bool enabled() const { return program != 0; }
+
+  // Id of the laid-out string, laying it out on first use
+  int layout(const std::string& utf8);
+  // Width in pixels of a layout drawn at `sizePx`
+  float width(int layoutId, float sizePx) const;
+
+  // Starts a frame of labels for a viewport of width x height pixels
+  void begin(int viewW, int viewH);
+  // Centres a label on (x, y), in pixels from the bottom left, unless it
+  // would overlap one placed before it this frame. True if it was placed.
+  bool add(int layoutId, float x, float y, float sizePx, uint32_t rgba);
+  // Draws everything placed since begin()
+  void draw();
+
+private:
+  struct Placed {
+    uint32_t glyph; // GlyphAtlas id
+    float x;        // pen position in pixels at kGlyphPx
+  };
+  struct Layout {
+    uint32_t first, count; // in `placed`
+    float width;
+  };
+  struct Instance {
+    float rect[4];    // pixels x0, y0, x1, y1
+    float texRect[4]; // atlas coordinates at (x0, y0) and (x1, y1)
+    uint32_t color;   // RGBA, red in the low byte
+  };
+
+  // Marks the cells under a box; false (marking nothing) if any is taken
+  bool claim(float x0, float y0, float x1, float y1);
+
+  GlyphAtlas atlas;
+  GLuint program = 0;
+  GLuint vao = 0, quadVBO = 0, instanceVBO = 0;
+  GLint viewportLoc = -1;
+
+  std::unordered_map<std::string, int> layoutIds;
+  std::vector<Layout> layouts;
+  std::vector<Placed> placed;
+
+  int viewW = 0, viewH = 0;
+  int gridW = 0, gridH = 0;
+  std::vector<uint8_t> grid;
+  // Per-frame scratch, reserved in init()
+  std::vector<Instance> instances;
+};
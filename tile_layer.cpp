@@ -0,0 +1,351 @@
+#include "tile_layer.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+// Unit quad, drawn as a strip and stretched over each tile's rectangle
+constexpr float kCorners[] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+// Stand-ins plus tiles; chooseLevel() keeps the tiles to half the cache
+constexpr int kMaxInstances = TileLayer::kCacheLayers;
+
+bool TileLayer::init(std::unique_ptr<TileSource> from, std::function<void()> onTileReady) {
+  if (!from) return false;
+  source = std::move(from);
+  int size = source->tileSize;
+  if (size <= 0 || size > kMaxTileSize || (size & (size - 1)) != 0 ||
+      source->tilesX * source->tilesY > kCacheLayers / 4) {
+    std::cerr << "Unsupported map tile layout\n";
+    source.reset();
+    return false;
+  }
+  mipLevels = 0;
+  while ((size >> mipLevels) > 0) ++mipLevels;
+
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  for (int m = 0; m < mipLevels; ++m)
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, m, GL_RGBA8, size >> m, size >> m, kCacheLayers, 0, GL_RGB,
+                 GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, mipLevels - 1);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  program = loadProgram("glsl/vertex_tile.glsl", "glsl/fragment_tile.glsl");
+  zoomLoc = glGetUniformLocation(program, "zoom");
+  panLoc = glGetUniformLocation(program, "pan");
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "tiles"), 0);
+
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &quadVBO);
+  glGenBuffers(1, &instanceVBO);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kCorners), kCorners, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  glBufferData(GL_ARRAY_BUFFER, kMaxInstances * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, rect));
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, texRect));
+  glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, layer));
+  for (int a = 1; a <= 3; ++a) {
+    glEnableVertexAttribArray(a);
+    glVertexAttribDivisor(a, 1);
+  }
+  glBindVertexArray(0);
+
+  ranked.reserve(kMaxInstances);
+  wanted.reserve(kMaxInstances);
+  ahead.reserve(kMaxInstances);
+  under.reserve(kMaxInstances);
+  over.reserve(kMaxInstances);
+  overview.reserve(kCacheLayers / 4);
+  resident.reserve(kCacheLayers);
+  loader.start(source.get(), std::move(onTileReady));
+  return true;
+}
+
+void TileLayer::release() {
+  loader.stop();
+  glDeleteVertexArrays(1, &vao);
+  glDeleteBuffers(1, &quadVBO);
+  glDeleteBuffers(1, &instanceVBO);
+  glDeleteTextures(1, &texture);
+  glDeleteProgram(program);
+  vao = quadVBO = instanceVBO = texture = program = 0;
+  resident.clear();
+  std::fill(std::begin(layers), std::end(layers), Layer());
+  source.reset();
+}
+
+void TileLayer::upload(const DecodedTile& tile, int layer) {
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  const uint8_t* texels = tile.texels.data();
+  for (int m = 0; m < mipLevels; ++m) {
+    int s = source->tileSize >> m;
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, m, 0, 0, layer, s, s, 1, GL_RGB, GL_UNSIGNED_BYTE, texels);
+    texels += static_cast<size_t>(s) * s * 3;
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+int TileLayer::evictLayer() {
+  int best = -1;
+  for (int i = 0; i < kCacheLayers; ++i) {
+    const Layer& l = layers[i];
+    if (!l.used) return i;
+    // Never a tile drawn this frame
+    if (l.pinned || l.lastUsed == frame) continue;
+    if (best < 0 || l.lastUsed < layers[best].lastUsed) best = i;
+  }
+  if (best >= 0) {
+    resident.erase(layers[best].key);
+    layers[best].used = false;
+  }
+  return best;
+}
+
+int TileLayer::findResident(TileKey k, TileKey* found) const {
+  for (;;) {
+    auto it = resident.find(k.packed());
+    if (it != resident.end()) {
+      *found = k;
+      return it->second;
+    }
+    if (k.z == 0) return -1;
+    k = k.parent();
+  }
+}
+
+int TileLayer::chooseLevel(float zoom, int viewW, int viewH) const {
+  // Screen pixels per level-0 texel, across and down
+  float need = std::max(viewW * zoom / (source->tileSize * source->tilesX),
+                        viewH * zoom / (source->tileSize * source->tilesY));
+  int z = need > 1.0f ? static_cast<int>(std::ceil(std::log2(need))) : 0;
+  z = std::min(z, source->levels - 1);
+  // Bound the tile count; a view much larger than the cache gets blurrier
+  // rather than slower
+  while (z > 0) {
+    float across = source->columns(z) / zoom + 1.0f;
+    float down = source->rows(z) / zoom + 1.0f;
+    if (std::ceil(across) * std::ceil(down) <= kCacheLayers / 2) break;
+    --z;
+  }
+  return z;
+}
+
+TileLayer::Instance TileLayer::makeInstance(TileKey k, TileKey from, int layer, float alpha) const {
+  float cols = static_cast<float>(source->columns(k.z));
+  float rows = static_cast<float>(source->rows(k.z));
+  // Sub-rectangle of `from` that covers `k`; t = 0 is the tile's top row
+  int d = k.z - from.z;
+  float scale = 1.0f / static_cast<float>(1u << d);
+  float ox = (k.x - (from.x << d)) * scale;
+  float oy = (k.y - (from.y << d)) * scale;
+  Instance inst;
+  inst.rect[0] = k.x / cols;
+  inst.rect[1] = 1.0f - (k.y + 1) / rows;
+  inst.rect[2] = (k.x + 1) / cols;
+  inst.rect[3] = 1.0f - k.y / rows;
+  inst.texRect[0] = ox;
+  inst.texRect[1] = oy + scale;
+  inst.texRect[2] = ox + scale;
+  inst.texRect[3] = oy;
+  inst.layer = static_cast<float>(layer);
+  inst.alpha = alpha;
+  return inst;
+}
+
+void TileLayer::addInstance(TileKey k, TileKey from, int layer, float alpha) {
+  std::vector<Instance>& list = from.z == k.z ? over : under;
+  if (static_cast<int>(under.size() + over.size()) >= kMaxInstances) return;
+  list.push_back(makeInstance(k, from, layer, alpha));
+}
+
+void TileLayer::collectAhead(int z, float zoom, float panX, float panY, double nowMs) {
+  // Smoothed over a few frames; a zoom starts it over
+  if (zoom != lastZoom || lastMs <= 0.0) {
+    velX = velY = 0.0f;
+  } else if (nowMs > lastMs) {
+    float dt = static_cast<float>(nowMs - lastMs);
+    velX += 0.3f * ((panX - lastPanX) / dt - velX);
+    velY += 0.3f * ((panY - lastPanY) / dt - velY);
+  }
+  lastZoom = zoom;
+  lastPanX = panX;
+  lastPanY = panY;
+  lastMs = nowMs;
+
+  ahead.clear();
+  int cols = source->columns(z), rows = source->rows(z);
+  float dx = velX * static_cast<float>(kPrefetchMs), dy = velY * static_cast<float>(kPrefetchMs);
+  // Not worth it for less than half a tile
+  if (std::fabs(dx) * cols + std::fabs(dy) * rows < 0.5f) return;
+
+  auto range = [](float lo, float hi, int n, int* a, int* b) {
+    *a = std::clamp(static_cast<int>(std::floor(lo * n)), 0, n - 1);
+    *b = std::clamp(static_cast<int>(std::ceil(hi * n)) - 1, 0, n - 1);
+  };
+  float u0 = 0.5f + panX - 0.5f / zoom, u1 = 0.5f + panX + 0.5f / zoom;
+  float v0 = 0.5f + panY - 0.5f / zoom, v1 = 0.5f + panY + 0.5f / zoom;
+  int x0, x1, y0, y1, ax0, ax1, ay0, ay1;
+  range(u0, u1, cols, &x0, &x1);
+  range(1.0f - v1, 1.0f - v0, rows, &y0, &y1);
+  range(u0 + dx, u1 + dx, cols, &ax0, &ax1);
+  range(1.0f - v1 - dy, 1.0f - v0 - dy, rows, &ay0, &ay1);
+  float cx = (0.5f + panX + dx) * cols, cy = (0.5f - panY - dy) * rows;
+  ranked.clear();
+  for (int y = ay0; y <= ay1; ++y) {
+    for (int x = ax0; x <= ax1; ++x) {
+      if (x >= x0 && x <= x1 && y >= y0 && y <= y1) continue;
+      TileKey k{static_cast<uint8_t>(z), static_cast<uint32_t>(x), static_cast<uint32_t>(y)};
+      if (resident.count(k.packed())) continue;
+      ranked.push_back({std::fabs(x + 0.5f - cx) + std::fabs(y + 0.5f - cy), k.packed()});
+    }
+  }
+  // Half the loader's pool, so prefetching can't crowd out what's on screen
+  std::sort(ranked.begin(), ranked.end());
+  for (size_t i = 0; i < ranked.size() && i < TileLoader::kPoolTiles / 2; ++i) ahead.push_back(ranked[i].second);
+}
+
+void TileLayer::prepare(float zoom, float panX, float panY, double nowMs) {
+  ++frame;
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  int z = chooseLevel(zoom, viewport[2], viewport[3]);
+  int cols = source->columns(z), rows = source->rows(z);
+
+  // Visible world rectangle, as in vertex_map.glsl, then the tile range
+  float u0 = 0.5f + panX - 0.5f / zoom, u1 = 0.5f + panX + 0.5f / zoom;
+  float v0 = 0.5f + panY - 0.5f / zoom, v1 = 0.5f + panY + 0.5f / zoom;
+  int x0 = std::clamp(static_cast<int>(std::floor(u0 * cols)), 0, cols - 1);
+  int x1 = std::clamp(static_cast<int>(std::ceil(u1 * cols)) - 1, 0, cols - 1);
+  int y0 = std::clamp(static_cast<int>(std::floor((1.0f - v1) * rows)), 0, rows - 1);
+  int y1 = std::clamp(static_cast<int>(std::ceil((1.0f - v0) * rows)) - 1, 0, rows - 1);
+
+  // Mark what this frame draws so uploads can't evict it, and ask for the
+  // rest. A stand-in from d levels up is 2^d times blurrier on screen, so
+  // the worst stand-ins go first and the nearest the centre among equals.
+  // Level 0 stands in for everything else and comes before it all.
+  ranked.clear();
+  for (uint32_t y = 0; y < static_cast<uint32_t>(source->rows(0)); ++y)
+    for (uint32_t x = 0; x < static_cast<uint32_t>(source->columns(0)); ++x)
+      if (!resident.count(TileKey{0, x, y}.packed())) ranked.push_back({FLT_MAX, TileKey{0, x, y}.packed()});
+  float cx = (0.5f + panX) * cols, cy = (0.5f - panY) * rows;
+  for (int y = y0; y <= y1; ++y) {
+    for (int x = x0; x <= x1; ++x) {
+      TileKey k{static_cast<uint8_t>(z), static_cast<uint32_t>(x), static_cast<uint32_t>(y)};
+      TileKey found;
+      int layer = findResident(k, &found);
+      if (layer >= 0) layers[layer].lastUsed = frame;
+      if (layer >= 0 && found.z == z) {
+        if (found.z > 0) {
+          TileKey parentFound;
+          int parent = findResident(k.parent(), &parentFound);
+          if (parent >= 0) layers[parent].lastUsed = frame;
+        }
+      } else if (z > 0 && static_cast<int>(ranked.size()) < kMaxInstances) {
+        float error = static_cast<float>(1u << (layer >= 0 ? z - found.z : z + 1));
+        float dist = std::fabs(x + 0.5f - cx) + std::fabs(y + 0.5f - cy);
+        ranked.push_back({error / (1.0f + dist), k.packed()});
+      }
+    }
+  }
+  std::sort(ranked.begin(), ranked.end(),
+            [](const std::pair<float, uint64_t>& a, const std::pair<float, uint64_t>& b) { return a.first > b.first; });
+  wanted.clear();
+  for (const auto& r : ranked) wanted.push_back(r.second);
+  collectAhead(z, zoom, panX, panY, nowMs);
+  loader.want(wanted, ahead);
+
+  // Upload a few decoded tiles; the rest wait for the next frame
+  for (int n = 0; n < kMaxUploadsPerFrame; ++n) {
+    DecodedTile* tile = loader.takeReady();
+    if (!tile) break;
+    int layer = resident.count(tile->key) ? -1 : evictLayer();
+    if (layer >= 0) {
+      upload(*tile, layer);
+      layers[layer] = {tile->key, true, TileKey::unpack(tile->key).z == 0, frame, nowMs};
+      resident[tile->key] = layer;
+    }
+    loader.release(tile);
+  }
+
+  // Stand-ins under, tiles over, each fading in from its stand-in
+  under.clear();
+  over.clear();
+  fading = false;
+  for (int y = y0; y <= y1; ++y) {
+    for (int x = x0; x <= x1; ++x) {
+      TileKey k{static_cast<uint8_t>(z), static_cast<uint32_t>(x), static_cast<uint32_t>(y)};
+      TileKey found;
+      int layer = findResident(k, &found);
+      if (layer < 0) continue;
+      float alpha = 1.0f;
+      if (found.z == z) {
+        alpha = static_cast<float>(std::min(1.0, (nowMs - layers[layer].arrivedMs) / kFadeMs));
+        addInstance(k, found, layer, alpha);
+      }
+      if (alpha < 1.0f) {
+        fading = true;
+        if (z == 0) continue;
+        TileKey parentFound;
+        int parent = findResident(k.parent(), &parentFound);
+        if (parent >= 0) addInstance(k, parentFound, parent, 1.0f);
+      } else if (found.z != z) {
+        addInstance(k, found, layer, 1.0f);
+      }
+    }
+  }
+}
+
+void TileLayer::draw(float zoom, float panX, float panY) {
+  glUseProgram(program);
+  glUniform1f(zoomLoc, zoom);
+  glUniform2f(panLoc, panX, panY);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  // Orphan last frame's instances instead of waiting on them
+  glBufferData(GL_ARRAY_BUFFER, kMaxInstances * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, under.size() * sizeof(Instance), under.data());
+  glBufferSubData(GL_ARRAY_BUFFER, under.size() * sizeof(Instance), over.size() * sizeof(Instance), over.data());
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(under.size() + over.size()));
+}
+
+void TileLayer::drawOverview() {
+  // Its own list, so prepare()'s stays intact for the rest of the frame
+  overview.clear();
+  for (uint32_t y = 0; y < static_cast<uint32_t>(source->rows(0)); ++y) {
+    for (uint32_t x = 0; x < static_cast<uint32_t>(source->columns(0)); ++x) {
+      TileKey k{0, x, y};
+      auto it = resident.find(k.packed());
+      if (it != resident.end()) overview.push_back(makeInstance(k, k, it->second, 1.0f));
+    }
+  }
+  if (overview.empty()) return;
+  glUseProgram(program);
+  glUniform1f(zoomLoc, 1.0f);
+  glUniform2f(panLoc, 0.0f, 0.0f);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  glBufferData(GL_ARRAY_BUFFER, kMaxInstances * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, overview.size() * sizeof(Instance), overview.data());
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(overview.size()));
+}
+
+bool TileLayer::animating() {
+  return enabled() && (fading || loader.busy());
+}
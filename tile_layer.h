@@ -0,0 +1,110 @@
+#pragma once
+
+#include "tile_source.h"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Draws the map from a TileSource at any zoom. Each frame it picks the
+// level whose texels are just finer than the screen's pixels, collects the
+// tiles covering the view and draws them in one instanced call. Tiles that
+// aren't resident yet are stood in for by the nearest resident ancestor and
+// cross-fade in when they arrive. Missing tiles are asked for worst stand-in
+// first, and while the view pans, the tiles it is heading for are decoded
+// ahead of time.
+//
+// Resident tiles live in one texture array with a full mip chain per layer,
+// so fractional zoom between levels stays filtered. The array has a fixed
+// number of layers, uploads per frame are capped, and when a level would need
+// more tiles than half the cache a coarser one is used instead, so the cost
+// of a frame doesn't depend on the zoom or on the size of the source.
+//
+// Render thread only, with the GL context current.
+class TileLayer {
+public:
+  static constexpr int kCacheLayers = 128;
+  // Largest tile edge accepted; the cache alone is about 170 MB at 512
+  static constexpr int kMaxTileSize = 512;
+  static constexpr int kMaxUploadsPerFrame = 4;
+  static constexpr double kFadeMs = 200.0;
+  // How far ahead along the pan the loader decodes
+  static constexpr double kPrefetchMs = 400.0;
+
+  // False if `source` is null or has a layout or tile size the cache can't
+  // hold. onTileReady is called from a loader thread whenever a tile can be
+  // uploaded. Nothing is read here; level 0 is the first thing asked for.
+  bool init(std::unique_ptr<TileSource> source, std::function<void()> onTileReady);
+  void release();
+  bool enabled() const { return program != 0; }
+
+  // Shares the map shader's uniforms (zoom, pan, samplers); set them up
+  // through this before draw()
+  GLuint shader() const { return program; }
+
+  // Once per frame, before any draw(): picks the tiles for the camera and
+  // the current viewport, asks the loader for what's missing, uploads a few
+  // that arrived and lays out the instances draw() emits
+  void prepare(float zoom, float panX, float panY, double nowMs);
+  // Draws what prepare() laid out for the same camera; only emits the
+  // instances, so it can be called once per scissored strip
+  void draw(float zoom, float panX, float panY);
+  // The whole map from level 0 alone, which is always resident, for an
+  // overview inset; asks for nothing and uploads nothing
+  void drawOverview();
+  // True while tiles are still loading or fading in; keep drawing
+  bool animating();
+
+private:
+  struct Layer {
+    uint64_t key = 0;
+    bool used = false;
+    bool pinned = false;     // level 0, never evicted
+    uint64_t lastUsed = 0;   // frame counter
+    double arrivedMs = 0.0;
+  };
+  struct Instance {
+    float rect[4];    // world u0, v0, u1, v1
+    float texRect[4]; // tile coordinates at (u0, v0) and (u1, v1)
+    float layer;
+    float alpha;
+  };
+
+  int chooseLevel(float zoom, int viewW, int viewH) const;
+  void upload(const DecodedTile& tile, int layer);
+  int evictLayer();
+  // Resident tile or ancestor covering `k`; -1 if none
+  int findResident(TileKey k, TileKey* found) const;
+  Instance makeInstance(TileKey k, TileKey from, int layer, float alpha) const;
+  void addInstance(TileKey k, TileKey from, int layer, float alpha);
+  // Tiles at level z in the view pushed kPrefetchMs along the pan, but not
+  // in view now, into `ahead`
+  void collectAhead(int z, float zoom, float panX, float panY, double nowMs);
+
+  std::unique_ptr<TileSource> source;
+  TileLoader loader;
+  GLuint program = 0;
+  GLuint texture = 0;
+  GLuint vao = 0, quadVBO = 0, instanceVBO = 0;
+  GLint zoomLoc = -1, panLoc = -1;
+  int mipLevels = 0;
+
+  Layer layers[kCacheLayers];
+  std::unordered_map<uint64_t, int> resident; // key -> layer
+  uint64_t frame = 0;
+  bool fading = false;
+  // Pan velocity in map units per millisecond, and what it was measured from
+  float velX = 0.0f, velY = 0.0f;
+  float lastZoom = 0.0f, lastPanX = 0.0f, lastPanY = 0.0f;
+  double lastMs = 0.0;
+  // Per-frame scratch, reserved in init()
+  std::vector<std::pair<float, uint64_t>> ranked; // priority, key
+  std::vector<uint64_t> wanted, ahead;
+  std::vector<Instance> under, over; // stand-ins, then the tiles themselves
+  std::vector<Instance> overview;
+};
@@ -0,0 +1,60 @@
+#include "tile_pyramid.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+constexpr char kPyramidMagic[4] = {'K', 'P', 'Y', 'R'};
+constexpr uint16_t kPyramidVersion = 1;
+
+template <typename T>
+bool get(std::ifstream& in, T& v) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+bool TilePyramid::open(const char* path) {
+  in.open(path, std::ios::binary);
+  if (!in) return false;
+  char magic[4];
+  uint16_t version = 0, size = 0, tx = 0, ty = 0;
+  uint8_t levelCount = 0;
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kPyramidMagic, sizeof(magic)) != 0 ||
+      !get(in, version) || version != kPyramidVersion || !get(in, size) || !get(in, levelCount) ||
+      !get(in, tx) || !get(in, ty) || size == 0 || levelCount == 0 || levelCount > 20 || tx == 0 || ty == 0) {
+    std::cerr << "Not a tile pyramid: " << path << "\n";
+    in.close();
+    return false;
+  }
+  tileSize = size;
+  levels = levelCount;
+  tilesX = tx;
+  tilesY = ty;
+
+  uint64_t total = 0;
+  for (int z = 0; z < levels; ++z) {
+    levelStart.push_back(total);
+    total += static_cast<uint64_t>(columns(z)) * rows(z);
+  }
+  indexStart = static_cast<uint64_t>(in.tellg());
+  in.seekg(0, std::ios::end);
+  if (static_cast<uint64_t>(in.tellg()) < indexStart + total * kEntryBytes) {
+    std::cerr << "Truncated tile pyramid: " << path << "\n";
+    levelStart.clear();
+    in.close();
+    return false;
+  }
+  return true;
+}
+
+bool TilePyramid::read(TileKey k, uint8_t* rgb) {
+  if (!contains(k)) return false;
+  uint64_t index = levelStart[k.z] + static_cast<uint64_t>(k.y) * columns(k.z) + k.x;
+  std::lock_guard<std::mutex> lock(readMutex);
+  in.clear();
+  in.seekg(static_cast<std::streamoff>(indexStart + index * kEntryBytes));
+  uint64_t offset = 0;
+  uint32_t size = 0;
+  if (!get(in, offset) || !get(in, size) || size != tileBytes()) return false;
+  in.seekg(static_cast<std::streamoff>(offset));
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(rgb), size));
+}
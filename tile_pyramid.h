@@ -0,0 +1,35 @@
+#pragma once
+
+#include "tile_source.h"
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+// Quadtree of fixed-size RGB tiles cut from one large image, built offline
+// by tools/build_tiles. Level 0 is the whole image in tilesX x tilesY tiles
+// and every level below doubles the resolution.
+//
+// File layout (little endian):
+//   "KPYR" u16 version, u16 tileSize, u8 levels, u16 tilesX, u16 tilesY,
+//   one (u64 offset, u32 size) entry per tile, level by level, rows top first,
+//   then the tiles themselves: tileSize^2 RGB8 texels each, top row first
+class TilePyramid : public TileSource {
+public:
+  bool open(const char* path);
+  bool isOpen() const { return !levelStart.empty(); }
+
+  // One file, so reads take turns. The tile's index entry is read along
+  // with it, so memory stays flat however many levels there are.
+  bool read(TileKey k, uint8_t* rgb) override;
+
+private:
+  // Bytes per index entry: u64 offset, u32 size
+  static constexpr uint64_t kEntryBytes = 12;
+
+  std::mutex readMutex;
+  std::ifstream in; // guarded by readMutex once open
+  uint64_t indexStart = 0;          // file offset of the first entry
+  std::vector<uint64_t> levelStart; // index of each level's first entry
+};
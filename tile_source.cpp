@@ -0,0 +1,221 @@
+#include "tile_source.h"
+
+#include <algorithm>
+
+size_t mipChainBytes(int size) {
+  size_t bytes = 0;
+  for (int s = size; s > 0; s >>= 1) bytes += static_cast<size_t>(s) * s * 3;
+  return bytes;
+}
+
+// Fills in every level after the first with a 2x2 box filter
+static void buildMips(uint8_t* texels, int size) {
+  const uint8_t* src = texels;
+  for (int s = size; s > 1; s >>= 1) {
+    int half = s >> 1;
+    uint8_t* dst = const_cast<uint8_t*>(src) + static_cast<size_t>(s) * s * 3;
+    for (int y = 0; y < half; ++y) {
+      const uint8_t* r0 = src + static_cast<size_t>(2 * y) * s * 3;
+      const uint8_t* r1 = r0 + static_cast<size_t>(s) * 3;
+      uint8_t* out = dst + static_cast<size_t>(y) * half * 3;
+      for (int x = 0; x < half * 3; x += 3) {
+        int i = 2 * x;
+        for (int c = 0; c < 3; ++c)
+          out[x + c] = static_cast<uint8_t>((r0[i + c] + r0[i + 3 + c] + r1[i + c] + r1[i + 3 + c] + 2) >> 2);
+      }
+    }
+    src = dst;
+  }
+}
+
+TileLoader::~TileLoader() {
+  stop();
+}
+
+bool TileLoader::decode(TileSource& source, TileKey k, std::vector<uint8_t>& texels) {
+  if (!source.read(k, texels.data())) return false;
+  buildMips(texels.data(), source.tileSize);
+  return true;
+}
+
+bool TileLoader::start(TileSource* source, std::function<void()> onReady) {
+  this->source = source;
+  this->onReady = std::move(onReady);
+  if (!source || source->tileSize == 0) return false;
+  for (DecodedTile& t : pool) t.texels.resize(mipChainBytes(source->tileSize));
+  // Far more than a screenful of tiles
+  wanted.reserve(1024);
+  prefetch.reserve(1024);
+  quit = false;
+  int count = std::clamp(source->concurrency(), 1, kMaxWorkers);
+  for (int i = 0; i < count; ++i) workers.emplace_back(&TileLoader::run, this);
+  return true;
+}
+
+void TileLoader::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  cv.notify_all();
+  for (std::thread& t : workers) t.join();
+  workers.clear();
+}
+
+void TileLoader::want(const std::vector<uint64_t>& keys, const std::vector<uint64_t>& ahead) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    wanted.assign(keys.begin(), keys.begin() + std::min(keys.size(), wanted.capacity()));
+    prefetch.assign(ahead.begin(), ahead.begin() + std::min(ahead.size(), prefetch.capacity()));
+    nextWanted = nextPrefetch = 0;
+  }
+  cv.notify_all();
+}
+
+DecodedTile* TileLoader::takeReady() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (int i = 0; i < kPoolTiles; ++i) {
+    if (entries[i].state == ENTRY_READY) {
+      entries[i].state = ENTRY_TAKEN;
+      return &pool[i];
+    }
+  }
+  return nullptr;
+}
+
+void TileLoader::release(DecodedTile* tile) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& e = entries[tile - pool];
+    e.state = ENTRY_CACHED;
+    e.shown = false;
+    e.lastUsed = ++useClock;
+  }
+  cv.notify_all();
+}
+
+bool TileLoader::busy() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (nextWanted < wanted.size()) return true;
+  for (const Entry& e : entries)
+    if (e.state == ENTRY_READY || (e.state == ENTRY_DECODING && e.shown)) return true;
+  return false;
+}
+
+int TileLoader::find(uint64_t key) const {
+  for (int i = 0; i < kPoolTiles; ++i)
+    if (entries[i].state != ENTRY_FREE && pool[i].key == key) return i;
+  return -1;
+}
+
+int TileLoader::evictable() const {
+  int best = -1;
+  for (int i = 0; i < kPoolTiles; ++i) {
+    const Entry& e = entries[i];
+    if (e.state == ENTRY_FREE) return i;
+    if (e.state == ENTRY_CACHED && (best < 0 || e.lastUsed < entries[best].lastUsed)) best = i;
+  }
+  return best;
+}
+
+TileLoader::Failure* TileLoader::findFailure(uint64_t key) {
+  for (int i = 0; i < failedCount; ++i)
+    if (failed[i].attempts > 0 && failed[i].key == key) return &failed[i];
+  return nullptr;
+}
+
+bool TileLoader::hasFailed(uint64_t key) {
+  Failure* f = findFailure(key);
+  return f && std::chrono::steady_clock::now() < f->retryAt;
+}
+
+void TileLoader::markFailed(uint64_t key) {
+  Failure* f = findFailure(key);
+  if (!f) {
+    f = &failed[failedNext];
+    failedNext = (failedNext + 1) % kFailedTiles;
+    failedCount = std::min(failedCount + 1, kFailedTiles);
+    *f = {key, 0, {}};
+  }
+  int delay = kRetryMs << std::min(f->attempts, 6);
+  ++f->attempts;
+  f->retryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::min(delay, kMaxRetryMs));
+}
+
+void TileLoader::clearFailed(uint64_t key) {
+  // Its slot stays taken until the ring comes round to it
+  if (Failure* f = findFailure(key)) f->attempts = 0;
+}
+
+int TileLoader::nextRequest(bool* handedOver) {
+  for (int pass = 0; pass < 2; ++pass) {
+    bool shown = pass == 0;
+    const std::vector<uint64_t>& list = shown ? wanted : prefetch;
+    size_t& next = shown ? nextWanted : nextPrefetch;
+    while (next < list.size()) {
+      uint64_t key = list[next];
+      if (hasFailed(key)) {
+        ++next;
+        continue;
+      }
+      int i = find(key);
+      if (i >= 0) {
+        // Already decoded or on its way; a wanted one only needs handing over
+        Entry& e = entries[i];
+        e.lastUsed = ++useClock;
+        if (shown && e.state == ENTRY_CACHED) {
+          e.state = ENTRY_READY;
+          *handedOver = true;
+        }
+        if (shown) e.shown = true;
+        ++next;
+        continue;
+      }
+      i = evictable();
+      // Everything is in use; wait for the render thread to hand some back
+      if (i < 0) return -1;
+      ++next;
+      entries[i] = {ENTRY_DECODING, shown, ++useClock};
+      pool[i].key = key;
+      return i;
+    }
+  }
+  return -1;
+}
+
+void TileLoader::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!quit) {
+    bool handedOver = false;
+    int i = nextRequest(&handedOver);
+    if (handedOver && onReady) {
+      lock.unlock();
+      onReady();
+      lock.lock();
+    }
+    if (i < 0) {
+      if (!handedOver) cv.wait(lock);
+      continue;
+    }
+    uint64_t key = pool[i].key;
+
+    lock.unlock();
+    bool ok = decode(*source, TileKey::unpack(key), pool[i].texels);
+    lock.lock();
+    // A tile that can't be read is skipped until its retry comes round;
+    // its parent keeps standing in
+    Entry& e = entries[i];
+    e.state = !ok ? ENTRY_FREE : e.shown ? ENTRY_READY : ENTRY_CACHED;
+    if (ok)
+      clearFailed(key);
+    else
+      markFailed(key);
+    // Another worker may have been waiting for an entry to come free
+    if (e.state != ENTRY_READY) cv.notify_all();
+    if (ok && e.shown && onReady) {
+      lock.unlock();
+      onReady();
+      lock.lock();
+    }
+  }
+}
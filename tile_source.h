@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Address of one tile. Level z has (tilesX << z) x (tilesY << z) tiles and
+// y = 0 is the top (north) row, like XYZ web tiles.
+struct TileKey {
+  uint8_t z = 0;
+  uint32_t x = 0, y = 0;
+
+  uint64_t packed() const { return static_cast<uint64_t>(z) << 56 | static_cast<uint64_t>(x) << 28 | y; }
+  static TileKey unpack(uint64_t k) {
+    return {static_cast<uint8_t>(k >> 56), static_cast<uint32_t>(k >> 28) & 0xFFFFFFF,
+            static_cast<uint32_t>(k) & 0xFFFFFFF};
+  }
+  TileKey parent() const { return {static_cast<uint8_t>(z - 1), x >> 1, y >> 1}; }
+};
+
+// Somewhere the map's tiles come from: a quadtree of fixed-size RGB tiles.
+// Level 0 is the whole map in tilesX x tilesY tiles and every level below
+// doubles the resolution. The layout is known once the source is open.
+class TileSource {
+public:
+  virtual ~TileSource() = default;
+
+  int columns(int z) const { return tilesX << z; }
+  int rows(int z) const { return tilesY << z; }
+  bool contains(TileKey k) const {
+    return k.z < levels && static_cast<int>(k.x) < columns(k.z) && static_cast<int>(k.y) < rows(k.z);
+  }
+  size_t tileBytes() const { return static_cast<size_t>(tileSize) * tileSize * 3; }
+
+  // Level-0 texels of `k` into `rgb`, which holds tileBytes(), top row
+  // first. Called from the loader's worker threads, several at once when
+  // concurrency() allows.
+  virtual bool read(TileKey k, uint8_t* rgb) = 0;
+  // Reads worth having in flight at once; more for slow backends
+  virtual int concurrency() const { return 1; }
+
+  int tileSize = 0;
+  int levels = 0;
+  int tilesX = 0, tilesY = 0;
+};
+
+// Bytes for a square RGB8 mip chain with a base of `size` texels
+size_t mipChainBytes(int size);
+
+// A tile ready for upload: the full RGB8 mip chain, base level first
+struct DecodedTile {
+  uint64_t key = 0;
+  std::vector<uint8_t> texels;
+};
+
+// Reads and mips tiles on worker threads so the render thread only ever
+// uploads. Requests are replaced wholesale every frame by want(), so tiles
+// that scrolled or zoomed out of view before their turn are never read.
+//
+// Decoded tiles live in a fixed pool that doubles as an in-memory LRU:
+// once uploaded they stay decoded until the pool needs the room, so a tile
+// the GPU cache evicted comes back without another read, and tiles
+// prefetched ahead of the camera wait there until they're wanted. Nothing
+// is allocated once start() returns.
+class TileLoader {
+public:
+  static constexpr int kPoolTiles = 64;
+  static constexpr int kMaxWorkers = 4;
+  // Unreadable tiles remembered so they aren't read again every frame.
+  // Each is retried after kRetryMs, doubling with every further failure up
+  // to kMaxRetryMs, so a server that was briefly down fills in again.
+  static constexpr int kFailedTiles = 256;
+  static constexpr int kRetryMs = 1000;
+  static constexpr int kMaxRetryMs = 60000;
+
+  TileLoader() = default;
+  TileLoader(const TileLoader&) = delete;
+  TileLoader& operator=(const TileLoader&) = delete;
+  ~TileLoader();
+
+  // onReady is called on a worker thread each time a wanted tile is ready
+  bool start(TileSource* source, std::function<void()> onReady);
+  void stop();
+
+  // Render thread. The tiles to show, most important first, and tiles to
+  // decode into the pool only, in case they're shown soon
+  void want(const std::vector<uint64_t>& keys, const std::vector<uint64_t>& ahead);
+  // A decoded tile or null; hand it back with release() after uploading
+  DecodedTile* takeReady();
+  void release(DecodedTile* tile);
+  // Wanted tiles not yet decoded or taken
+  bool busy();
+
+private:
+  enum EntryState : uint8_t { ENTRY_FREE, ENTRY_DECODING, ENTRY_READY, ENTRY_TAKEN, ENTRY_CACHED };
+  struct Entry {
+    EntryState state = ENTRY_FREE;
+    bool shown = false; // hand over when decoded, rather than just keep
+    uint64_t lastUsed = 0;
+  };
+  struct Failure {
+    uint64_t key = 0;
+    int attempts = 0;
+    std::chrono::steady_clock::time_point retryAt;
+  };
+
+  void run();
+  // Pool entry holding `key`, or -1
+  int find(uint64_t key) const;
+  // Free entry, else the cached one unused for longest; -1 if all are busy
+  int evictable() const;
+  // Next request that needs reading, visible ones first; any already in
+  // the pool are handed over or kept on the way. -1 when there is none or
+  // nowhere to decode it.
+  int nextRequest(bool* handedOver);
+  Failure* findFailure(uint64_t key);
+  // True while `key` is backing off after a failed read
+  bool hasFailed(uint64_t key);
+  // Past kFailedTiles the oldest failure is forgotten, and retried
+  void markFailed(uint64_t key);
+  void clearFailed(uint64_t key);
+  static bool decode(TileSource& source, TileKey k, std::vector<uint8_t>& texels);
+
+  TileSource* source = nullptr;
+  std::function<void()> onReady;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable cv;
+  // Guarded by mutex
+  bool quit = false;
+  std::vector<uint64_t> wanted, prefetch;
+  size_t nextWanted = 0, nextPrefetch = 0;
+  Failure failed[kFailedTiles];
+  int failedCount = 0, failedNext = 0;
+  DecodedTile pool[kPoolTiles];
+  Entry entries[kPoolTiles];
+  uint64_t useClock = 0;
+};
@@ -0,0 +1,558 @@
+// Offline step: convert GeoJSON country or province polygons into the
+// border file BorderSet loads at runtime (see borders.h for the layout).
+//
+// Every Polygon and MultiPolygon feature becomes one feature named after
+// its "name" (or "NAME", "admin", "ADMIN") property. For each level of
+// detail the rings are simplified with Douglas-Peucker, rings that collapse
+// are dropped, and what is left is triangulated by ear clipping with holes
+// bridged into their outer ring. Coordinates are lon/lat in degrees and come
+// out equirectangular, like world_map.png.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Level 0 keeps every vertex; each level after it tolerates 4x the error
+constexpr int kLods = 6;
+constexpr double kCoarsestTolerance = 1.0 / 1024.0;
+
+// --- Minimal JSON reader, enough for GeoJSON ---
+
+struct Json {
+  enum Type { NUL, BOOL, NUM, STR, ARR, OBJ } type = NUL;
+  double num = 0.0;
+  std::string str;
+  std::vector<Json> arr;
+  std::vector<std::pair<std::string, Json>> obj;
+
+  const Json* get(const char* key) const {
+    for (const auto& kv : obj)
+      if (kv.first == key) return &kv.second;
+    return nullptr;
+  }
+};
+
+class JsonParser {
+public:
+  explicit JsonParser(const std::string& text) : s(text) {}
+
+  bool parse(Json& out) {
+    bool ok = value(out);
+    ws();
+    return ok && pos == s.size();
+  }
+  size_t offset() const { return pos; }
+
+private:
+  void ws() {
+    while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\n' || s[pos] == '\r' || s[pos] == '\t')) ++pos;
+  }
+  bool literal(const char* word) {
+    size_t n = std::strlen(word);
+    if (s.compare(pos, n, word) != 0) return false;
+    pos += n;
+    return true;
+  }
+  bool string(std::string& out) {
+    if (s[pos] != '"') return false;
+    ++pos;
+    while (pos < s.size() && s[pos] != '"') {
+      char c = s[pos++];
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (pos >= s.size()) return false;
+      char e = s[pos++];
+      switch (e) {
+      case 'n': out += '\n'; break;
+      case 't': out += '\t'; break;
+      case 'r': out += '\r'; break;
+      case 'b': out += '\b'; break;
+      case 'f': out += '\f'; break;
+      case 'u': {
+        if (pos + 4 > s.size()) return false;
+        unsigned cp = std::strtoul(s.substr(pos, 4).c_str(), nullptr, 16);
+        pos += 4;
+        // UTF-8; surrogate pairs are passed through as two code points
+        if (cp < 0x80) {
+          out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+          out += static_cast<char>(0xC0 | (cp >> 6));
+          out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+          out += static_cast<char>(0xE0 | (cp >> 12));
+          out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+          out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        break;
+      }
+      default: out += e; break;
+      }
+    }
+    if (pos >= s.size()) return false;
+    ++pos;
+    return true;
+  }
+  bool value(Json& out) {
+    ws();
+    if (pos >= s.size()) return false;
+    char c = s[pos];
+    if (c == '{') {
+      out.type = Json::OBJ;
+      ++pos;
+      ws();
+      if (pos < s.size() && s[pos] == '}') return ++pos, true;
+      for (;;) {
+        ws();
+        std::string key;
+        if (pos >= s.size() || !string(key)) return false;
+        ws();
+        if (pos >= s.size() || s[pos++] != ':') return false;
+        out.obj.emplace_back(std::move(key), Json());
+        if (!value(out.obj.back().second)) return false;
+        ws();
+        if (pos >= s.size()) return false;
+        if (s[pos] == ',') { ++pos; continue; }
+        if (s[pos] == '}') return ++pos, true;
+        return false;
+      }
+    }
+    if (c == '[') {
+      out.type = Json::ARR;
+      ++pos;
+      ws();
+      if (pos < s.size() && s[pos] == ']') return ++pos, true;
+      for (;;) {
+        out.arr.emplace_back();
+        if (!value(out.arr.back())) return false;
+        ws();
+        if (pos >= s.size()) return false;
+        if (s[pos] == ',') { ++pos; continue; }
+        if (s[pos] == ']') return ++pos, true;
+        return false;
+      }
+    }
+    if (c == '"') {
+      out.type = Json::STR;
+      return string(out.str);
+    }
+    if (literal("true")) { out.type = Json::BOOL; out.num = 1.0; return true; }
+    if (literal("false")) { out.type = Json::BOOL; return true; }
+    if (literal("null")) return true;
+    char* end = nullptr;
+    out.num = std::strtod(s.c_str() + pos, &end);
+    if (end == s.c_str() + pos) return false;
+    out.type = Json::NUM;
+    pos = end - s.c_str();
+    return true;
+  }
+
+  const std::string& s;
+  size_t pos = 0;
+};
+
+// --- Geometry ---
+
+struct Pt {
+  double x, y;
+};
+using Ring = std::vector<Pt>;
+struct Polygon {
+  std::vector<Ring> rings; // outer first, then holes
+};
+struct Feature {
+  std::string name;
+  std::vector<Polygon> polygons;
+  double minX = 1.0, minY = 1.0, maxX = 0.0, maxY = 0.0;
+};
+
+bool readRing(const Json& coords, Ring& ring) {
+  if (coords.type != Json::ARR) return false;
+  for (const Json& p : coords.arr) {
+    if (p.type != Json::ARR || p.arr.size() < 2) return false;
+    double lon = p.arr[0].num, lat = p.arr[1].num;
+    ring.push_back({(lon + 180.0) / 360.0, (lat + 90.0) / 180.0});
+  }
+  // GeoJSON rings repeat their first point at the end
+  if (ring.size() > 1 && ring.front().x == ring.back().x && ring.front().y == ring.back().y) ring.pop_back();
+  return true;
+}
+
+bool readPolygon(const Json& coords, Polygon& poly) {
+  if (coords.type != Json::ARR) return false;
+  for (const Json& r : coords.arr) {
+    poly.rings.emplace_back();
+    if (!readRing(r, poly.rings.back())) return false;
+  }
+  return !poly.rings.empty();
+}
+
+double signedArea(const Ring& r) {
+  double a = 0.0;
+  for (size_t i = 0, j = r.size() - 1; i < r.size(); j = i++) a += (r[j].x - r[i].x) * (r[j].y + r[i].y);
+  return a * 0.5;
+}
+
+double segmentDistance(Pt p, Pt a, Pt b) {
+  double dx = b.x - a.x, dy = b.y - a.y;
+  double len2 = dx * dx + dy * dy;
+  double t = len2 > 0.0 ? std::clamp(((p.x - a.x) * dx + (p.y - a.y) * dy) / len2, 0.0, 1.0) : 0.0;
+  double ex = a.x + t * dx - p.x, ey = a.y + t * dy - p.y;
+  return std::sqrt(ex * ex + ey * ey);
+}
+
+// Douglas-Peucker on a closed ring, anchored at its first point and the
+// point farthest from it
+Ring simplify(const Ring& r, double tolerance) {
+  if (tolerance <= 0.0 || r.size() < 4) return r;
+  size_t far = 0;
+  double farD = -1.0;
+  for (size_t i = 1; i < r.size(); ++i) {
+    double d = std::hypot(r[i].x - r[0].x, r[i].y - r[0].y);
+    if (d > farD) {
+      farD = d;
+      far = i;
+    }
+  }
+  std::vector<bool> keep(r.size() + 1, false);
+  keep[0] = keep[far] = keep[r.size()] = true;
+  std::vector<std::pair<size_t, size_t>> stack = {{0, far}, {far, r.size()}};
+  auto at = [&](size_t i) { return r[i % r.size()]; };
+  while (!stack.empty()) {
+    auto [a, b] = stack.back();
+    stack.pop_back();
+    double maxD = 0.0;
+    size_t idx = 0;
+    for (size_t i = a + 1; i < b; ++i) {
+      double d = segmentDistance(at(i), at(a), at(b));
+      if (d > maxD) {
+        maxD = d;
+        idx = i;
+      }
+    }
+    if (maxD > tolerance) {
+      keep[idx] = true;
+      stack.push_back({a, idx});
+      stack.push_back({idx, b});
+    }
+  }
+  Ring out;
+  for (size_t i = 0; i < r.size(); ++i)
+    if (keep[i]) out.push_back(r[i]);
+  return out;
+}
+
+// --- Ear clipping ---
+
+double cross(Pt a, Pt b, Pt c) {
+  return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+bool inTriangle(Pt p, Pt a, Pt b, Pt c) {
+  return cross(a, b, p) >= 0.0 && cross(b, c, p) >= 0.0 && cross(c, a, p) >= 0.0;
+}
+
+// Splices a hole (clockwise) into the outer ring (counter-clockwise) through
+// a bridge from the hole's rightmost point to a visible outer point
+void bridgeHole(const std::vector<Pt>& pts, std::vector<uint32_t>& outer, const std::vector<uint32_t>& hole) {
+  size_t m = 0;
+  for (size_t i = 1; i < hole.size(); ++i)
+    if (pts[hole[i]].x > pts[hole[m]].x) m = i;
+  Pt M = pts[hole[m]];
+
+  // Nearest edge hit by a ray from M towards +x
+  size_t best = SIZE_MAX;
+  double bestX = 1e300;
+  for (size_t i = 0; i < outer.size(); ++i) {
+    Pt a = pts[outer[i]], b = pts[outer[(i + 1) % outer.size()]];
+    if ((a.y > M.y) == (b.y > M.y)) continue;
+    double x = a.x + (M.y - a.y) / (b.y - a.y) * (b.x - a.x);
+    if (x >= M.x && x < bestX) {
+      bestX = x;
+      best = a.x > b.x ? i : (i + 1) % outer.size();
+    }
+  }
+  if (best == SIZE_MAX) return; // hole outside its ring; drop it
+  // A reflex vertex inside (M, hit, candidate) would block the bridge; take
+  // the one closest in angle to the ray instead
+  Pt I = {bestX, M.y}, P = pts[outer[best]];
+  double bestTan = 1e300;
+  for (size_t i = 0; i < outer.size(); ++i) {
+    Pt q = pts[outer[i]];
+    Pt prev = pts[outer[(i + outer.size() - 1) % outer.size()]], next = pts[outer[(i + 1) % outer.size()]];
+    if (i == best || q.x < M.x || cross(prev, q, next) >= 0.0) continue;
+    bool inside = P.y > M.y ? inTriangle(q, M, I, P) : inTriangle(q, M, P, I);
+    if (!inside) continue;
+    double tan = std::fabs(q.y - M.y) / std::max(q.x - M.x, 1e-300);
+    if (tan < bestTan) {
+      bestTan = tan;
+      best = i;
+    }
+  }
+
+  std::vector<uint32_t> merged(outer.begin(), outer.begin() + best + 1);
+  for (size_t i = 0; i <= hole.size(); ++i) merged.push_back(hole[(m + i) % hole.size()]);
+  merged.insert(merged.end(), outer.begin() + best, outer.end());
+  outer = std::move(merged);
+}
+
+// Vertices that could block an ear are looked up in a uniform grid over the
+// ring rather than by walking the whole ring, which keeps 100k-point
+// coastlines from going quadratic
+void earClip(const std::vector<Pt>& pts, std::vector<uint32_t> ring, std::vector<uint32_t>& tris) {
+  size_t n = ring.size();
+  if (n < 3) return;
+  std::vector<size_t> prev(n), next(n);
+  std::vector<bool> clipped(n, false);
+  for (size_t i = 0; i < n; ++i) {
+    prev[i] = (i + n - 1) % n;
+    next[i] = (i + 1) % n;
+  }
+  auto P = [&](size_t i) { return pts[ring[i]]; };
+
+  Pt lo = P(0), hi = P(0);
+  for (size_t i = 1; i < n; ++i) {
+    lo = {std::min(lo.x, P(i).x), std::min(lo.y, P(i).y)};
+    hi = {std::max(hi.x, P(i).x), std::max(hi.y, P(i).y)};
+  }
+  int side = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(n) / 4.0)));
+  double cellW = std::max(hi.x - lo.x, 1e-12) / side, cellH = std::max(hi.y - lo.y, 1e-12) / side;
+  auto cellX = [&](double x) { return std::min(side - 1, static_cast<int>((x - lo.x) / cellW)); };
+  auto cellY = [&](double y) { return std::min(side - 1, static_cast<int>((y - lo.y) / cellH)); };
+  std::vector<std::vector<uint32_t>> grid(static_cast<size_t>(side) * side);
+  for (size_t i = 0; i < n; ++i) grid[cellY(P(i).y) * side + cellX(P(i).x)].push_back(static_cast<uint32_t>(i));
+
+  auto isEar = [&](size_t a, size_t b, size_t c) {
+    Pt A = P(a), B = P(b), C = P(c);
+    if (cross(A, B, C) <= 0.0) return false;
+    int x0 = cellX(std::min({A.x, B.x, C.x})), x1 = cellX(std::max({A.x, B.x, C.x}));
+    int y0 = cellY(std::min({A.y, B.y, C.y})), y1 = cellY(std::max({A.y, B.y, C.y}));
+    for (int y = y0; y <= y1; ++y)
+      for (int x = x0; x <= x1; ++x)
+        for (uint32_t i : grid[y * side + x]) {
+          if (clipped[i] || i == a || i == b || i == c) continue;
+          Pt q = P(i);
+          // Bridge duplicates share a position with a corner; they don't block
+          bool corner = (q.x == A.x && q.y == A.y) || (q.x == B.x && q.y == B.y) || (q.x == C.x && q.y == C.y);
+          if (!corner && cross(P(prev[i]), q, P(next[i])) <= 0.0 && inTriangle(q, A, B, C)) return false;
+        }
+    return true;
+  };
+
+  size_t cur = 0, left = n, sinceEar = 0;
+  while (left > 3) {
+    size_t a = prev[cur], b = cur, c = next[cur];
+    // Self-intersecting input can leave no ear at all; clip anyway rather
+    // than loop forever
+    if (isEar(a, b, c) || sinceEar > left) {
+      tris.insert(tris.end(), {ring[a], ring[b], ring[c]});
+      next[a] = c;
+      prev[c] = a;
+      clipped[b] = true;
+      --left;
+      sinceEar = 0;
+      cur = c;
+    } else {
+      cur = next[cur];
+      ++sinceEar;
+    }
+  }
+  tris.insert(tris.end(), {ring[prev[cur]], ring[cur], ring[next[cur]]});
+}
+
+template <typename T>
+void put(std::ofstream& out, T v) {
+  out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+struct Range {
+  uint32_t firstPoint = 0, pointCount = 0, firstIndex = 0, indexCount = 0;
+};
+
+struct Lod {
+  float tolerance = 0.0f;
+  std::vector<Range> ranges;
+  std::vector<float> points; // u, v pairs
+  std::vector<uint32_t> indices;
+};
+
+void buildLod(const std::vector<Feature>& features, double tolerance, Lod& lod) {
+  lod.tolerance = static_cast<float>(tolerance);
+  std::vector<Pt> pts;
+  for (const Feature& f : features) {
+    Range r;
+    r.firstPoint = static_cast<uint32_t>(lod.points.size() / 2);
+    r.firstIndex = static_cast<uint32_t>(lod.indices.size());
+    for (const Polygon& poly : f.polygons) {
+      // Simplify, dropping rings that collapse; no outer ring, no polygon
+      std::vector<Ring> rings;
+      for (const Ring& ring : poly.rings) {
+        Ring s = simplify(ring, tolerance);
+        if (s.size() < 3 || std::fabs(signedArea(s)) < tolerance * tolerance) {
+          if (rings.empty()) break;
+          continue;
+        }
+        // Outer counter-clockwise, holes clockwise
+        if ((signedArea(s) > 0.0) != rings.empty()) std::reverse(s.begin(), s.end());
+        rings.push_back(std::move(s));
+      }
+      if (rings.empty()) continue;
+
+      pts.clear();
+      std::vector<std::vector<uint32_t>> ringIdx;
+      uint32_t base = static_cast<uint32_t>(lod.points.size() / 2);
+      for (const Ring& ring : rings) {
+        ringIdx.emplace_back();
+        for (const Pt& p : ring) {
+          ringIdx.back().push_back(static_cast<uint32_t>(pts.size()));
+          pts.push_back(p);
+          lod.points.push_back(static_cast<float>(p.x));
+          lod.points.push_back(static_cast<float>(p.y));
+        }
+        // Close the outline for the line pass, then break it off
+        lod.points.push_back(static_cast<float>(ring[0].x));
+        lod.points.push_back(static_cast<float>(ring[0].y));
+        lod.points.push_back(-1.0f);
+        lod.points.push_back(-1.0f);
+        pts.push_back(ring[0]);
+        pts.push_back({-1.0, -1.0});
+      }
+
+      // Holes right to left, each into the ring built so far
+      std::vector<uint32_t> outer = ringIdx[0];
+      std::vector<size_t> holes;
+      for (size_t h = 1; h < ringIdx.size(); ++h) holes.push_back(h);
+      auto maxX = [&](size_t h) {
+        double x = -1e300;
+        for (uint32_t i : ringIdx[h]) x = std::max(x, pts[i].x);
+        return x;
+      };
+      std::sort(holes.begin(), holes.end(), [&](size_t a, size_t b) { return maxX(a) > maxX(b); });
+      for (size_t h : holes) bridgeHole(pts, outer, ringIdx[h]);
+
+      std::vector<uint32_t> tris;
+      earClip(pts, outer, tris);
+      for (uint32_t i : tris) lod.indices.push_back(base + i);
+    }
+    r.pointCount = static_cast<uint32_t>(lod.points.size() / 2) - r.firstPoint;
+    r.indexCount = static_cast<uint32_t>(lod.indices.size()) - r.firstIndex;
+    lod.ranges.push_back(r);
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: build_borders <borders.geojson> <out.kbrd>\n";
+    return -1;
+  }
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    std::cerr << "Failed to open " << argv[1] << "\n";
+    return -1;
+  }
+  std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  Json root;
+  JsonParser parser(text);
+  if (!parser.parse(root)) {
+    std::cerr << argv[1] << ": invalid JSON near byte " << parser.offset() << "\n";
+    return -1;
+  }
+
+  std::vector<Feature> features;
+  const Json* list = root.get("features");
+  for (const Json& f : list ? list->arr : std::vector<Json>()) {
+    const Json* geom = f.get("geometry");
+    const Json* type = geom ? geom->get("type") : nullptr;
+    const Json* coords = geom ? geom->get("coordinates") : nullptr;
+    if (!type || !coords) continue;
+    Feature out;
+    if (const Json* props = f.get("properties")) {
+      for (const char* key : {"name", "NAME", "admin", "ADMIN"}) {
+        const Json* name = props->get(key);
+        if (name && name->type == Json::STR) {
+          out.name = name->str;
+          break;
+        }
+      }
+    }
+    bool ok = true;
+    if (type->str == "Polygon") {
+      out.polygons.emplace_back();
+      ok = readPolygon(*coords, out.polygons.back());
+    } else if (type->str == "MultiPolygon") {
+      for (const Json& p : coords->arr) {
+        out.polygons.emplace_back();
+        ok = ok && readPolygon(p, out.polygons.back());
+      }
+    } else {
+      continue;
+    }
+    if (!ok) {
+      std::cerr << argv[1] << ": malformed coordinates in feature \"" << out.name << "\"\n";
+      return -1;
+    }
+    for (const Polygon& p : out.polygons)
+      for (const Pt& q : p.rings[0]) {
+        out.minX = std::min(out.minX, q.x);
+        out.minY = std::min(out.minY, q.y);
+        out.maxX = std::max(out.maxX, q.x);
+        out.maxY = std::max(out.maxY, q.y);
+      }
+    features.push_back(std::move(out));
+  }
+  if (features.empty()) {
+    std::cerr << argv[1] << ": no Polygon or MultiPolygon features\n";
+    return -1;
+  }
+
+  std::vector<Lod> lods(kLods);
+  for (int i = 0; i < kLods; ++i) {
+    double tolerance = i == 0 ? 0.0 : kCoarsestTolerance / std::pow(4.0, kLods - 1 - i);
+    buildLod(features, tolerance, lods[i]);
+  }
+
+  std::ofstream out(argv[2], std::ios::binary);
+  if (!out) {
+    std::cerr << "Failed to open " << argv[2] << " for writing\n";
+    return -1;
+  }
+  out.write("KBRD", 4);
+  put<uint16_t>(out, 1);
+  put<uint8_t>(out, kLods);
+  put<uint32_t>(out, features.size());
+  for (const Feature& f : features) {
+    uint8_t len = static_cast<uint8_t>(std::min<size_t>(f.name.size(), 255));
+    put<float>(out, f.minX);
+    put<float>(out, f.minY);
+    put<float>(out, f.maxX);
+    put<float>(out, f.maxY);
+    put(out, len);
+    out.write(f.name.data(), len);
+  }
+  for (const Lod& lod : lods) {
+    put(out, lod.tolerance);
+    put<uint32_t>(out, lod.points.size() / 2);
+    put<uint32_t>(out, lod.indices.size());
+    out.write(reinterpret_cast<const char*>(lod.ranges.data()), lod.ranges.size() * sizeof(Range));
+    out.write(reinterpret_cast<const char*>(lod.points.data()), lod.points.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(lod.indices.data()), lod.indices.size() * sizeof(uint32_t));
+  }
+  if (!out) {
+    std::cerr << "Failed to write " << argv[2] << "\n";
+    return -1;
+  }
+  std::cout << "Wrote " << features.size() << " features to " << argv[2] << "\n";
+  for (int i = 0; i < kLods; ++i)
+    std::cout << "  tolerance " << lods[i].tolerance << ": " << lods[i].points.size() / 2 << " points, "
+              << lods[i].indices.size() / 3 << " triangles\n";
+  return 0;
+}
@@ -0,0 +1,183 @@
+// Offline step: build the marker quadtree MarkerSet loads at runtime (see
+// markers.h for the layout) from a list of points.
+//
+// Input is plain text, one point per line as lon/lat in degrees, separated
+// by spaces or commas, optionally followed by a weight for heatmaps
+// (default 1, negative clamps to 0). Anything after that is ignored, and
+// lines that don't start with two numbers (headers, '#' comments) are
+// skipped. Output coordinates are equirectangular, like world_map.png.
+//
+// Points are sorted along a Morton curve and the tree is built over the
+// sorted array breadth first, so a node's points are one run and its
+// children sit side by side. Counts and centroids are worked out here so the
+// runtime never has to. Centroids are weighted, falling back to plain
+// averages where a node's weight is zero.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A node is split while it has more points than this
+constexpr uint32_t kLeafPoints = 16;
+// Must match MarkerSet::kMaxDepth
+constexpr int kMaxDepth = 24;
+
+struct Point {
+  uint64_t key;
+  float u, v;
+  float weight;
+};
+
+struct Node {
+  float u, v;
+  float weight;
+  uint32_t count;
+  uint32_t first;
+  uint32_t cellX, cellY;
+  uint8_t level;
+  uint8_t children;
+  uint16_t pad;
+};
+static_assert(sizeof(Node) == 32, "layout must match MarkerSet::Node");
+
+template <typename T>
+void put(std::ofstream& out, T v) {
+  out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+// Interleaves the bits of x and y (y in the odd bits), most significant
+// level first, so sorting by key groups each quadtree cell together
+uint64_t morton(uint32_t x, uint32_t y) {
+  uint64_t key = 0;
+  for (int b = kMaxDepth - 1; b >= 0; --b) key = (key << 2) | (((y >> b) & 1u) << 1) | ((x >> b) & 1u);
+  return key;
+}
+
+bool readPoints(const char* path, std::vector<Point>& points, size_t& skipped) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "Failed to open " << path << "\n";
+    return false;
+  }
+  const double scale = static_cast<double>(1u << kMaxDepth);
+  std::string line;
+  while (std::getline(in, line)) {
+    std::replace(line.begin(), line.end(), ',', ' ');
+    double lon, lat, weight = 1.0;
+    int fields = std::sscanf(line.c_str(), "%lf %lf %lf", &lon, &lat, &weight);
+    if (fields < 2) {
+      if (line.find_first_not_of(" \t\r") != std::string::npos) ++skipped;
+      continue;
+    }
+    double u = std::min(std::max((lon + 180.0) / 360.0, 0.0), 1.0);
+    double v = std::min(std::max((lat + 90.0) / 180.0, 0.0), 1.0);
+    uint32_t x = static_cast<uint32_t>(std::min(u * scale, scale - 1.0));
+    uint32_t y = static_cast<uint32_t>(std::min(v * scale, scale - 1.0));
+    if (fields < 3) weight = 1.0;
+    points.push_back({morton(x, y), static_cast<float>(u), static_cast<float>(v),
+                      static_cast<float>(std::max(weight, 0.0))});
+  }
+  return true;
+}
+
+struct Pending {
+  uint32_t node;
+  size_t begin, end;
+};
+
+std::vector<Node> buildTree(const std::vector<Point>& points) {
+  std::vector<Node> nodes;
+  std::deque<Pending> queue;
+  nodes.push_back({});
+  queue.push_back({0, 0, points.size()});
+  while (!queue.empty()) {
+    Pending p = queue.front();
+    queue.pop_front();
+    Node& n = nodes[p.node];
+    double su = 0.0, sv = 0.0, wu = 0.0, wv = 0.0, w = 0.0;
+    for (size_t i = p.begin; i < p.end; ++i) {
+      su += points[i].u;
+      sv += points[i].v;
+      wu += static_cast<double>(points[i].u) * points[i].weight;
+      wv += static_cast<double>(points[i].v) * points[i].weight;
+      w += points[i].weight;
+    }
+    uint32_t count = static_cast<uint32_t>(p.end - p.begin);
+    n.u = static_cast<float>(w > 0.0 ? wu / w : su / count);
+    n.v = static_cast<float>(w > 0.0 ? wv / w : sv / count);
+    n.weight = static_cast<float>(w);
+    n.count = count;
+    if (count <= kLeafPoints || n.level == kMaxDepth) {
+      n.first = static_cast<uint32_t>(p.begin);
+      continue;
+    }
+
+    // Quadrant of each point is the next two key bits below this level
+    int shift = 2 * (kMaxDepth - 1 - n.level);
+    uint32_t cellX = n.cellX, cellY = n.cellY;
+    uint8_t level = n.level;
+    n.first = static_cast<uint32_t>(nodes.size());
+    uint8_t children = 0;
+    size_t begin = p.begin;
+    for (uint32_t q = 0; q < 4; ++q) {
+      size_t end = begin;
+      while (end < p.end && ((points[end].key >> shift) & 3u) == q) ++end;
+      if (end == begin) continue;
+      Node child = {};
+      child.cellX = cellX * 2 + (q & 1u);
+      child.cellY = cellY * 2 + (q >> 1);
+      child.level = static_cast<uint8_t>(level + 1);
+      queue.push_back({static_cast<uint32_t>(nodes.size()), begin, end});
+      nodes.push_back(child);
+      ++children;
+      begin = end;
+    }
+    // `n` may have moved when nodes grew
+    nodes[p.node].children = children;
+  }
+  return nodes;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: build_markers <points.txt> <out.kmrk>\n";
+    return -1;
+  }
+  std::vector<Point> points;
+  size_t skipped = 0;
+  if (!readPoints(argv[1], points, skipped)) return -1;
+  if (points.empty()) {
+    std::cerr << argv[1] << ": no points\n";
+    return -1;
+  }
+  std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) { return a.key < b.key; });
+  std::vector<Node> nodes = buildTree(points);
+
+  std::ofstream out(argv[2], std::ios::binary);
+  if (!out) {
+    std::cerr << "Failed to open " << argv[2] << " for writing\n";
+    return -1;
+  }
+  out.write("KMRK", 4);
+  put<uint16_t>(out, 2);
+  put<uint32_t>(out, nodes.size());
+  put<uint32_t>(out, points.size());
+  out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(Node));
+  for (const Point& p : points) {
+    put(out, p.u);
+    put(out, p.v);
+    put(out, p.weight);
+  }
+  if (!out) {
+    std::cerr << "Failed to write " << argv[2] << "\n";
+    return -1;
+  }
+  std::cout << "Wrote " << points.size() << " points in " << nodes.size() << " nodes to " << argv[2] << "\n";
+  if (skipped) std::cout << "  skipped " << skipped << " lines without coordinates\n";
+  return 0;
+}
@@ -0,0 +1,166 @@
+// Offline step: cut a large map image into the tile pyramid that TileLayer
+// streams at runtime (see tile_pyramid.h for the file layout).
+//
+// The deepest level is resampled from the source image, box-filtered when
+// shrinking and bilinear when growing; every level above it is a 2x2 box
+// filter of the one below, so a tile always matches its four children.
+// Level 0 is tilesX x 1 tiles, tilesX being the source's aspect ratio
+// rounded (2 for an equirectangular world map).
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+struct Image {
+  int width = 0, height = 0;
+  std::vector<uint8_t> rgb;
+};
+
+template <typename T>
+void put(std::ofstream& out, T v) {
+  out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+Image resample(const uint8_t* src, int srcW, int srcH, int width, int height) {
+  Image out;
+  out.width = width;
+  out.height = height;
+  out.rgb.resize(static_cast<size_t>(width) * height * 3);
+  double sx = static_cast<double>(srcW) / width, sy = static_cast<double>(srcH) / height;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8_t* o = &out.rgb[(static_cast<size_t>(y) * width + x) * 3];
+      if (sx >= 1.0 && sy >= 1.0) {
+        // Average every source texel the output texel covers
+        int x0 = static_cast<int>(x * sx), x1 = std::max(x0 + 1, static_cast<int>((x + 1) * sx));
+        int y0 = static_cast<int>(y * sy), y1 = std::max(y0 + 1, static_cast<int>((y + 1) * sy));
+        x1 = std::min(x1, srcW);
+        y1 = std::min(y1, srcH);
+        uint32_t sum[3] = {0, 0, 0};
+        for (int yy = y0; yy < y1; ++yy)
+          for (int xx = x0; xx < x1; ++xx)
+            for (int c = 0; c < 3; ++c) sum[c] += src[(static_cast<size_t>(yy) * srcW + xx) * 3 + c];
+        uint32_t n = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+        for (int c = 0; c < 3; ++c) o[c] = static_cast<uint8_t>((sum[c] + n / 2) / n);
+      } else {
+        double fx = std::clamp((x + 0.5) * sx - 0.5, 0.0, srcW - 1.0);
+        double fy = std::clamp((y + 0.5) * sy - 0.5, 0.0, srcH - 1.0);
+        int ix = static_cast<int>(fx), iy = static_cast<int>(fy);
+        int jx = std::min(ix + 1, srcW - 1), jy = std::min(iy + 1, srcH - 1);
+        double tx = fx - ix, ty = fy - iy;
+        for (int c = 0; c < 3; ++c) {
+          auto at = [&](int px, int py) { return src[(static_cast<size_t>(py) * srcW + px) * 3 + c]; };
+          double top = at(ix, iy) * (1 - tx) + at(jx, iy) * tx;
+          double bottom = at(ix, jy) * (1 - tx) + at(jx, jy) * tx;
+          o[c] = static_cast<uint8_t>(std::lround(top * (1 - ty) + bottom * ty));
+        }
+      }
+    }
+  }
+  return out;
+}
+
+Image halve(const Image& in) {
+  Image out;
+  out.width = in.width / 2;
+  out.height = in.height / 2;
+  out.rgb.resize(static_cast<size_t>(out.width) * out.height * 3);
+  for (int y = 0; y < out.height; ++y) {
+    const uint8_t* r0 = &in.rgb[static_cast<size_t>(2 * y) * in.width * 3];
+    const uint8_t* r1 = r0 + static_cast<size_t>(in.width) * 3;
+    uint8_t* o = &out.rgb[static_cast<size_t>(y) * out.width * 3];
+    for (int x = 0; x < out.width * 3; x += 3) {
+      int i = 2 * x;
+      for (int c = 0; c < 3; ++c)
+        o[x + c] = static_cast<uint8_t>((r0[i + c] + r0[i + 3 + c] + r1[i + c] + r1[i + 3 + c] + 2) >> 2);
+    }
+  }
+  return out;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3 || argc > 5) {
+    std::cerr << "Usage: build_tiles <image> <out.kpyr> [<levels> [<tileSize>]]\n"
+                 "  By default, enough levels that the deepest is about the source's size,\n"
+                 "  in 256x256 tiles.\n";
+    return -1;
+  }
+  int srcW = 0, srcH = 0, channels = 0;
+  uint8_t* src = stbi_load(argv[1], &srcW, &srcH, &channels, 3);
+  if (!src) {
+    std::cerr << "Failed to load " << argv[1] << "\n";
+    return -1;
+  }
+  int tileSize = argc > 4 ? std::atoi(argv[4]) : 256;
+  if (tileSize < 16 || tileSize > 4096 || (tileSize & (tileSize - 1)) != 0) {
+    std::cerr << "Tile size must be a power of two from 16 to 4096\n";
+    stbi_image_free(src);
+    return -1;
+  }
+  int tilesX = std::max(1, static_cast<int>(std::lround(static_cast<double>(srcW) / srcH)));
+  int tilesY = 1;
+  int levels = argc > 3 ? std::atoi(argv[3])
+                        : 1 + std::max(0, static_cast<int>(std::lround(std::log2(
+                                              static_cast<double>(srcW) / (tileSize * tilesX)))));
+  if (levels < 1 || levels > 20) {
+    std::cerr << "Levels must be 1..20\n";
+    stbi_image_free(src);
+    return -1;
+  }
+
+  // Deepest level from the source, then each coarser level from the last
+  std::vector<Image> pyramid(levels);
+  int deepest = levels - 1;
+  pyramid[deepest] = resample(src, srcW, srcH, (tileSize * tilesX) << deepest, (tileSize * tilesY) << deepest);
+  stbi_image_free(src);
+  for (int z = deepest - 1; z >= 0; --z) pyramid[z] = halve(pyramid[z + 1]);
+
+  std::ofstream out(argv[2], std::ios::binary);
+  if (!out) {
+    std::cerr << "Failed to open " << argv[2] << " for writing\n";
+    return -1;
+  }
+  out.write("KPYR", 4);
+  put<uint16_t>(out, 1);
+  put<uint16_t>(out, tileSize);
+  put<uint8_t>(out, levels);
+  put<uint16_t>(out, tilesX);
+  put<uint16_t>(out, tilesY);
+
+  // Every tile is the same size, so the index is known up front
+  uint32_t tileBytes = static_cast<uint32_t>(tileSize) * tileSize * 3;
+  uint64_t tileCount = 0;
+  for (int z = 0; z < levels; ++z) tileCount += static_cast<uint64_t>(tilesX << z) * (tilesY << z);
+  uint64_t offset = 4 + 2 + 2 + 1 + 2 + 2 + tileCount * (sizeof(uint64_t) + sizeof(uint32_t));
+  for (uint64_t i = 0; i < tileCount; ++i, offset += tileBytes) {
+    put<uint64_t>(out, offset);
+    put<uint32_t>(out, tileBytes);
+  }
+
+  std::vector<char> tile(tileBytes);
+  for (int z = 0; z < levels; ++z) {
+    const Image& img = pyramid[z];
+    for (int ty = 0; ty < (tilesY << z); ++ty) {
+      for (int tx = 0; tx < (tilesX << z); ++tx) {
+        for (int row = 0; row < tileSize; ++row) {
+          size_t from = (static_cast<size_t>(ty * tileSize + row) * img.width + tx * tileSize) * 3;
+          std::copy_n(&img.rgb[from], tileSize * 3, &tile[static_cast<size_t>(row) * tileSize * 3]);
+        }
+        out.write(tile.data(), tile.size());
+      }
+    }
+  }
+  if (!out) {
+    std::cerr << "Failed to write " << argv[2] << "\n";
+    return -1;
+  }
+  std::cout << "Wrote " << tileCount << " tiles in " << levels << " levels to " << argv[2] << " ("
+            << pyramid[deepest].width << "x" << pyramid[deepest].height << " at the deepest)\n";
+  return 0;
+}
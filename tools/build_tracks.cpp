@@ -0,0 +1,155 @@
+// Offline step: build the track file TrackSet maps at runtime (see tracks.h
+// for the layout) from timestamped positions.
+//
+// Input is plain text, one sample per line as time (seconds), id, lon and
+// lat in degrees, separated by spaces or commas. Lines that don't start with
+// four numbers (headers, '#' comments) are skipped. The samples are sorted
+// by time here, ties kept in input order, so the input needn't be.
+//
+// Each sample is linked to the next sample of its id. A gap longer than
+// maxGap (default 300 s) ends the track there instead, so the runtime only
+// ever has to look maxGap back from the playback time.
+//
+// Everything is held in memory while building; the runtime side is what
+// scales past it.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Samples per index entry
+constexpr uint32_t kIndexStride = 4096;
+
+struct Sample {
+  double time;
+  uint32_t id;
+  float lon, lat;
+};
+
+template <typename T>
+void put(std::ofstream& out, T v) {
+  out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+void putColumn(std::ofstream& out, const std::vector<T>& column) {
+  out.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+  // Keep the next column 8-byte aligned
+  static const char zeros[8] = {};
+  out.write(zeros, (8 - column.size() * sizeof(T) % 8) % 8);
+}
+
+uint64_t columnBytes(uint64_t count, uint64_t size) {
+  return (count * size + 7) / 8 * 8;
+}
+
+bool readSamples(const char* path, std::vector<Sample>& samples, size_t& skipped) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "Failed to open " << path << "\n";
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    std::replace(line.begin(), line.end(), ',', ' ');
+    double time, lon, lat;
+    unsigned long id;
+    if (std::sscanf(line.c_str(), "%lf %lu %lf %lf", &time, &id, &lon, &lat) != 4 || !std::isfinite(time)) {
+      if (line.find_first_not_of(" \t\r") != std::string::npos) ++skipped;
+      continue;
+    }
+    // Wrapped onto the map, so the runtime's antimeridian handling holds
+    lon = std::fmod(lon + 180.0, 360.0);
+    if (lon < 0.0) lon += 360.0;
+    lat = std::min(std::max(lat, -90.0), 90.0);
+    samples.push_back({time, static_cast<uint32_t>(id), static_cast<float>(lon - 180.0), static_cast<float>(lat)});
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3 && argc != 4) {
+    std::cerr << "Usage: build_tracks <samples.txt> <out.ktrk> [maxGap seconds]\n";
+    return -1;
+  }
+  double maxGap = argc == 4 ? std::atof(argv[3]) : 300.0;
+  if (!(maxGap > 0.0)) {
+    std::cerr << "maxGap must be positive\n";
+    return -1;
+  }
+  std::vector<Sample> samples;
+  size_t skipped = 0;
+  if (!readSamples(argv[1], samples, skipped)) return -1;
+  if (samples.empty()) {
+    std::cerr << argv[1] << ": no samples\n";
+    return -1;
+  }
+  std::stable_sort(samples.begin(), samples.end(), [](const Sample& a, const Sample& b) { return a.time < b.time; });
+
+  uint64_t count = samples.size();
+  std::vector<double> index, time(count);
+  std::vector<uint32_t> id(count), next(count, 0);
+  std::vector<float> lon(count), lat(count);
+  // Walking backwards, the last sample seen of an id is the next one
+  std::unordered_map<uint32_t, uint64_t> ahead;
+  size_t tracks = 0;
+  for (uint64_t i = count; i-- > 0;) {
+    const Sample& s = samples[i];
+    time[i] = s.time;
+    id[i] = s.id;
+    lon[i] = s.lon;
+    lat[i] = s.lat;
+    auto it = ahead.find(s.id);
+    if (it != ahead.end() && samples[it->second].time - s.time <= maxGap && it->second - i <= UINT32_MAX)
+      next[i] = static_cast<uint32_t>(it->second - i);
+    else
+      ++tracks;
+    ahead[s.id] = i;
+  }
+  for (uint64_t i = 0; i < count; i += kIndexStride) index.push_back(time[i]);
+
+  // Header, then the offsets table, then the index and columns
+  uint64_t offset = 96;
+  uint64_t indexOffset = offset;
+  uint64_t timeOffset = indexOffset + columnBytes(index.size(), sizeof(double));
+  uint64_t idOffset = timeOffset + columnBytes(count, sizeof(double));
+  uint64_t lonOffset = idOffset + columnBytes(count, sizeof(uint32_t));
+  uint64_t latOffset = lonOffset + columnBytes(count, sizeof(float));
+  uint64_t nextOffset = latOffset + columnBytes(count, sizeof(float));
+
+  std::ofstream out(argv[2], std::ios::binary);
+  if (!out) {
+    std::cerr << "Failed to open " << argv[2] << " for writing\n";
+    return -1;
+  }
+  out.write("KTRK", 4);
+  put<uint16_t>(out, 1);
+  put<uint16_t>(out, 0);
+  put<uint32_t>(out, kIndexStride);
+  put<uint32_t>(out, 0);
+  put<uint64_t>(out, count);
+  put(out, maxGap);
+  put(out, time.front());
+  put(out, time.back());
+  for (uint64_t o : {indexOffset, timeOffset, idOffset, lonOffset, latOffset, nextOffset}) put(out, o);
+  putColumn(out, index);
+  putColumn(out, time);
+  putColumn(out, id);
+  putColumn(out, lon);
+  putColumn(out, lat);
+  putColumn(out, next);
+  if (!out) {
+    std::cerr << "Failed to write " << argv[2] << "\n";
+    return -1;
+  }
+  std::cout << "Wrote " << count << " samples in " << tracks << " tracks to " << argv[2] << "\n";
+  if (skipped) std::cout << "  skipped " << skipped << " lines without a sample\n";
+  return 0;
+}
@@ -0,0 +1,165 @@
+// Offline step: rasterize region polygons into the 16-bit ID image that
+// RegionMap loads at runtime.
+//
+// Input is plain text, lon/lat in degrees, one vertex per line:
+//
+//   region <id> <name>
+//   <lon> <lat>
+//   ...
+//   ring            (optional, starts another ring of the same region)
+//   ...
+//   end
+//
+// Rings are filled with the even-odd rule, so holes are just extra rings.
+// The output is equirectangular and covers the whole world, like
+// world_map.png. Later regions overwrite earlier ones where they overlap.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Ring {
+  std::vector<double> xs, ys; // pixel coordinates
+};
+
+struct Region {
+  uint16_t id = 0;
+  std::string name;
+  std::vector<Ring> rings;
+};
+
+template <typename T>
+void put(std::ofstream& out, T v) {
+  out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+bool parseRegions(const char* path, int width, int height, std::vector<Region>& regions) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "Failed to open " << path << "\n";
+    return false;
+  }
+  std::string line;
+  Region* cur = nullptr;
+  int lineNo = 0;
+  while (std::getline(in, line)) {
+    ++lineNo;
+    std::istringstream ss(line);
+    std::string word;
+    if (!(ss >> word) || word[0] == '#') continue;
+    if (word == "region") {
+      unsigned id = 0;
+      regions.emplace_back();
+      cur = &regions.back();
+      if (!(ss >> id) || id == 0 || id > 0xFFFF) {
+        std::cerr << path << ":" << lineNo << ": region id must be 1..65535\n";
+        return false;
+      }
+      cur->id = static_cast<uint16_t>(id);
+      std::getline(ss >> std::ws, cur->name);
+      cur->rings.emplace_back();
+    } else if (word == "ring" && cur) {
+      cur->rings.emplace_back();
+    } else if (word == "end") {
+      cur = nullptr;
+    } else if (cur) {
+      char* end = nullptr;
+      double lon = std::strtod(word.c_str(), &end), lat = 0.0;
+      if (*end != '\0' || !(ss >> lat)) {
+        std::cerr << path << ":" << lineNo << ": expected <lon> <lat>\n";
+        return false;
+      }
+      cur->rings.back().xs.push_back((lon + 180.0) / 360.0 * width);
+      cur->rings.back().ys.push_back((90.0 - lat) / 180.0 * height);
+    } else {
+      std::cerr << path << ":" << lineNo << ": vertex outside of a region\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Scanline fill sampling at pixel centers
+void fillRegion(const Region& r, int width, int height, std::vector<uint16_t>& ids) {
+  double minY = height, maxY = 0.0;
+  for (const Ring& ring : r.rings)
+    for (double y : ring.ys) {
+      minY = std::min(minY, y);
+      maxY = std::max(maxY, y);
+    }
+  int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+  int y1 = std::min(height - 1, static_cast<int>(std::ceil(maxY)));
+
+  std::vector<double> xings;
+  for (int y = y0; y <= y1; ++y) {
+    double cy = y + 0.5;
+    xings.clear();
+    for (const Ring& ring : r.rings) {
+      size_t n = ring.xs.size();
+      for (size_t i = 0, j = n - 1; i < n; j = i++) {
+        double ya = ring.ys[j], yb = ring.ys[i];
+        if ((ya <= cy) == (yb <= cy)) continue;
+        double t = (cy - ya) / (yb - ya);
+        xings.push_back(ring.xs[j] + t * (ring.xs[i] - ring.xs[j]));
+      }
+    }
+    std::sort(xings.begin(), xings.end());
+    for (size_t k = 0; k + 1 < xings.size(); k += 2) {
+      int x0 = std::max(0, static_cast<int>(std::ceil(xings[k] - 0.5)));
+      int x1 = std::min(width - 1, static_cast<int>(std::floor(xings[k + 1] - 0.5)));
+      for (int x = x0; x <= x1; ++x) ids[static_cast<size_t>(y) * width + x] = r.id;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc != 5) {
+    std::cerr << "Usage: rasterize_regions <regions.txt> <width> <height> <out.rid>\n"
+                 "  Use the size of world_map.png (or an integer fraction of it).\n";
+    return -1;
+  }
+  int width = std::atoi(argv[2]);
+  int height = std::atoi(argv[3]);
+  if (width <= 0 || height <= 0) {
+    std::cerr << "Invalid output size\n";
+    return -1;
+  }
+
+  std::vector<Region> regions;
+  if (!parseRegions(argv[1], width, height, regions)) return -1;
+
+  std::vector<uint16_t> ids(static_cast<size_t>(width) * height, 0);
+  for (const Region& r : regions) fillRegion(r, width, height, ids);
+
+  std::ofstream out(argv[4], std::ios::binary);
+  if (!out) {
+    std::cerr << "Failed to open " << argv[4] << " for writing\n";
+    return -1;
+  }
+  out.write("KRID", 4);
+  put<uint16_t>(out, 1);
+  put<uint32_t>(out, width);
+  put<uint32_t>(out, height);
+  put<uint32_t>(out, regions.size());
+  for (const Region& r : regions) {
+    uint8_t len = static_cast<uint8_t>(std::min<size_t>(r.name.size(), 255));
+    put(out, r.id);
+    put(out, len);
+    out.write(r.name.data(), len);
+  }
+  out.write(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(uint16_t));
+  if (!out) {
+    std::cerr << "Failed to write " << argv[4] << "\n";
+    return -1;
+  }
+  std::cout << "Wrote " << regions.size() << " regions to " << argv[4]
+            << " (" << width << "x" << height << ")\n";
+  return 0;
+}
@@ -0,0 +1,202 @@
+#include "tracks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRACKS_SSE 1
+#endif
+
+constexpr char kTrackMagic[4] = {'K', 'T', 'R', 'K'};
+constexpr uint16_t kTrackVersion = 1;
+
+struct TrackHeader {
+  char magic[4];
+  uint16_t version;
+  uint16_t pad;
+  uint32_t indexStride;
+  uint32_t reserved;
+  uint64_t count;
+  double maxGap, startTime, endTime;
+  uint64_t indexOffset, timeOffset, idOffset, lonOffset, latOffset, nextOffset;
+};
+static_assert(sizeof(TrackHeader) == 96, "layout must match tools/build_tracks");
+
+void TrackSlice::reserve(size_t n) {
+  for (std::vector<float>* c : {&since, &span, &lon0, &lat0, &lon1, &lat1}) c->reserve(n);
+  id.reserve(n);
+}
+
+void TrackSlice::clear() {
+  for (std::vector<float>* c : {&since, &span, &lon0, &lat0, &lon1, &lat1}) c->clear();
+  id.clear();
+}
+
+TrackSet::~TrackSet() {
+  close();
+}
+
+bool TrackSet::open(const char* path) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  HANDLE map = GetFileSizeEx(file, &size) && size.QuadPart > 0
+                   ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr)
+                   : nullptr;
+  void* view = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  if (!view) {
+    if (map) CloseHandle(map);
+    CloseHandle(file);
+    std::cerr << "Failed to map track file: " << path << "\n";
+    return false;
+  }
+  fileHandle = file;
+  mapHandle = map;
+  mapping = view;
+  mappedBytes = static_cast<size_t>(size.QuadPart);
+#else
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  void* view = fstat(fd, &st) == 0 && st.st_size > 0
+                   ? mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0)
+                   : MAP_FAILED;
+  // The mapping keeps the file open
+  ::close(fd);
+  if (view == MAP_FAILED) {
+    std::cerr << "Failed to map track file: " << path << "\n";
+    return false;
+  }
+  mapping = view;
+  mappedBytes = static_cast<size_t>(st.st_size);
+#endif
+
+  TrackHeader h{};
+  const char* base = static_cast<const char*>(mapping);
+  if (mappedBytes >= sizeof(h)) std::memcpy(&h, base, sizeof(h));
+  if (mappedBytes < sizeof(h) || std::memcmp(h.magic, kTrackMagic, sizeof(h.magic)) != 0 ||
+      h.version != kTrackVersion) {
+    std::cerr << "Not a track file: " << path << "\n";
+    close();
+    return false;
+  }
+  // Every array within the file and aligned for its type
+  uint64_t indexCount = h.indexStride ? (h.count + h.indexStride - 1) / h.indexStride : 0;
+  auto fits = [&](uint64_t offset, uint64_t elements, uint64_t size) {
+    return offset % 8 == 0 && offset <= mappedBytes && elements <= (mappedBytes - offset) / size;
+  };
+  bool ok = h.count > 0 && h.indexStride > 0 && h.maxGap >= 0.0 && h.startTime <= h.endTime &&
+            fits(h.indexOffset, indexCount, sizeof(double)) && fits(h.timeOffset, h.count, sizeof(double)) &&
+            fits(h.idOffset, h.count, sizeof(uint32_t)) && fits(h.lonOffset, h.count, sizeof(float)) &&
+            fits(h.latOffset, h.count, sizeof(float)) && fits(h.nextOffset, h.count, sizeof(uint32_t));
+  if (!ok) {
+    std::cerr << "Truncated or corrupt track file: " << path << "\n";
+    close();
+    return false;
+  }
+  count = h.count;
+  indexStride = h.indexStride;
+  maxGap = h.maxGap;
+  start = h.startTime;
+  end = h.endTime;
+  index = reinterpret_cast<const double*>(base + h.indexOffset);
+  time = reinterpret_cast<const double*>(base + h.timeOffset);
+  id = reinterpret_cast<const uint32_t*>(base + h.idOffset);
+  lon = reinterpret_cast<const float*>(base + h.lonOffset);
+  lat = reinterpret_cast<const float*>(base + h.latOffset);
+  next = reinterpret_cast<const uint32_t*>(base + h.nextOffset);
+  return true;
+}
+
+void TrackSet::close() {
+#ifdef _WIN32
+  if (mapping) UnmapViewOfFile(mapping);
+  if (mapHandle) CloseHandle(mapHandle);
+  if (fileHandle) CloseHandle(fileHandle);
+  fileHandle = mapHandle = nullptr;
+#else
+  if (mapping) munmap(mapping, mappedBytes);
+#endif
+  mapping = nullptr;
+  mappedBytes = 0;
+  count = 0;
+  index = time = nullptr;
+  id = next = nullptr;
+  lon = lat = nullptr;
+}
+
+uint64_t TrackSet::upperBound(double t) const {
+  // The index narrows it to one stride without touching the time column
+  uint64_t indexCount = (count + indexStride - 1) / indexStride;
+  uint64_t block = static_cast<uint64_t>(std::upper_bound(index, index + indexCount, t) - index);
+  if (block == 0) return 0;
+  uint64_t lo = (block - 1) * indexStride, hi = std::min(block * indexStride, count);
+  return static_cast<uint64_t>(std::upper_bound(time + lo, time + hi, t) - time);
+}
+
+void TrackSet::gather(double t, TrackSlice& out, size_t maxOut) const {
+  out.clear();
+  if (count == 0 || t < start || t > end) return;
+  uint64_t hi = upperBound(t);
+  // Nothing that started before the window is still going
+  for (uint64_t s = upperBound(t - maxGap - 1e-9 * std::fabs(t)); s < hi && out.size() < maxOut; ++s) {
+    // Sorted by time, a later sample of the same id is always ahead
+    if (next[s] == 0 || s + next[s] >= count) continue;
+    uint64_t n = s + next[s];
+    if (time[n] <= t) continue;
+    float l0 = lon[s], l1 = lon[n];
+    if (l1 - l0 > 180.0f) l1 -= 360.0f;
+    if (l0 - l1 > 180.0f) l1 += 360.0f;
+    out.since.push_back(static_cast<float>(t - time[s]));
+    out.span.push_back(static_cast<float>(time[n] - time[s]));
+    out.lon0.push_back(l0);
+    out.lat0.push_back(lat[s]);
+    out.lon1.push_back(l1);
+    out.lat1.push_back(lat[n]);
+    out.id.push_back(id[s]);
+  }
+}
+
+void interpolateTracks(const TrackSlice& slice, float* u, float* v) {
+  size_t count = slice.size();
+  size_t i = 0;
+#ifdef TRACKS_SSE
+  const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+  const __m128 perLon = _mm_set1_ps(1.0f / 360.0f), perLat = _mm_set1_ps(1.0f / 180.0f);
+  for (; i + 4 <= count; i += 4) {
+    __m128 w = _mm_div_ps(_mm_loadu_ps(&slice.since[i]), _mm_loadu_ps(&slice.span[i]));
+    w = _mm_min_ps(_mm_max_ps(w, zero), one);
+    __m128 lon0 = _mm_loadu_ps(&slice.lon0[i]), lat0 = _mm_loadu_ps(&slice.lat0[i]);
+    __m128 x = _mm_add_ps(lon0, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&slice.lon1[i]), lon0), w));
+    __m128 y = _mm_add_ps(lat0, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&slice.lat1[i]), lat0), w));
+    x = _mm_add_ps(_mm_mul_ps(x, perLon), half);
+    // Back onto the map after an unwrapped step over the antimeridian
+    x = _mm_add_ps(x, _mm_and_ps(_mm_cmplt_ps(x, zero), one));
+    x = _mm_sub_ps(x, _mm_and_ps(_mm_cmpge_ps(x, one), one));
+    _mm_storeu_ps(u + i, x);
+    _mm_storeu_ps(v + i, _mm_add_ps(_mm_mul_ps(y, perLat), half));
+  }
+#endif
+  for (; i < count; ++i) {
+    float w = std::min(std::max(slice.since[i] / slice.span[i], 0.0f), 1.0f);
+    float x = (slice.lon0[i] + (slice.lon1[i] - slice.lon0[i]) * w) / 360.0f + 0.5f;
+    if (x < 0.0f) x += 1.0f;
+    if (x >= 1.0f) x -= 1.0f;
+    u[i] = x;
+    v[i] = (slice.lat0[i] + (slice.lat1[i] - slice.lat0[i]) * w) / 180.0f + 0.5f;
+  }
+}
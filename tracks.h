@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Where one moving thing is at the playback time, in texture coordinates
+// (v = 0 at the bottom), ready for the instance buffer
+struct TrackInstance {
+  float u, v;
+  uint32_t id;
+};
+
+// The samples live at the playback time, one per moving thing: the last
+// sample at or before it and the next sample of the same id, as columns so
+// they can be interpolated four at a time. Longitudes are unwrapped, so a
+// step across the antimeridian doesn't sweep the width of the map.
+struct TrackSlice {
+  std::vector<float> since; // playback time minus the sample's
+  std::vector<float> span;  // time to the next sample
+  std::vector<float> lon0, lat0, lon1, lat1;
+  std::vector<uint32_t> id;
+
+  void reserve(size_t n);
+  void clear();
+  size_t size() const { return id.size(); }
+};
+
+// Timestamped positions of many moving things (historic movement data),
+// built offline by tools/build_tracks and memory-mapped rather than read,
+// so the file can be far larger than memory and opening it costs nothing.
+// Samples are sorted by time and stored as columns. A sparse time index (the
+// time of every indexStride-th sample) sits ahead of the columns, so a
+// seek is a binary search of the index and then of one stretch of the time
+// column, touching a handful of pages wherever it lands.
+//
+// Every sample also knows how far ahead the next sample of its id is (0 if
+// the track ends there), and no track is longer than maxGap between two
+// samples, so everything live at time t starts in [t - maxGap, t]. Only that
+// window is ever read.
+//
+// File layout (little endian):
+//   "KTRK" u16 version, u16 pad, u32 indexStride, u32 pad, u64 count,
+//   f64 maxGap, f64 startTime, f64 endTime,
+//   u64 offsets of: the index, then columns time, id, lon, lat, next,
+//   then the index (f64 per stride) and the columns: f64 time, u32 id,
+//   f32 lon, f32 lat (degrees), u32 next (samples ahead), each 8-byte aligned
+class TrackSet {
+public:
+  TrackSet() = default;
+  TrackSet(const TrackSet&) = delete;
+  TrackSet& operator=(const TrackSet&) = delete;
+  ~TrackSet();
+
+  bool open(const char* path);
+  void close();
+  bool empty() const { return count == 0; }
+
+  double startTime() const { return start; }
+  double endTime() const { return end; }
+
+  // First sample later than t
+  uint64_t upperBound(double t) const;
+  // Everything live at `t` into `out`, up to `maxOut` samples
+  void gather(double t, TrackSlice& out, size_t maxOut) const;
+
+private:
+  void* mapping = nullptr;
+  size_t mappedBytes = 0;
+#ifdef _WIN32
+  void* fileHandle = nullptr;
+  void* mapHandle = nullptr;
+#endif
+  uint64_t count = 0;
+  uint32_t indexStride = 0;
+  double maxGap = 0.0, start = 0.0, end = 0.0;
+  // Into the mapping
+  const double* index = nullptr;
+  const double* time = nullptr;
+  const uint32_t* id = nullptr;
+  const float* lon = nullptr;
+  const float* lat = nullptr;
+  const uint32_t* next = nullptr;
+};
+
+// Positions of the slice's samples at the playback time into u and v, which
+// hold slice.size() each. SSE where it's available.
+void interpolateTracks(const TrackSlice& slice, float* u, float* v);
@@ -0,0 +1,254 @@
+#include "voice_manager.h"
+
+#include <algorithm>
+#include <cmath>
+
+// A real voice keeps its slot until a challenger is this much louder, so
+// voices near the cutoff don't flip every period
+constexpr float kRealBias = 1.25f;
+
+VoiceManager::~VoiceManager() {
+  uninit();
+}
+
+void VoiceManager::init(ma_engine* engine, const VoiceConfig& config) {
+  this->engine = engine;
+  this->config = config;
+  fadeFrames = static_cast<ma_uint64>(config.fadeMs * ma_engine_get_sample_rate(engine) / 1000.0f);
+}
+
+void VoiceManager::uninit() {
+  for (auto& c : copies) ma_sound_uninit(c.get());
+  copies.clear();
+  voices.clear();
+  pools.clear();
+  order.clear();
+  real = active = 0;
+}
+
+static void sourceInfo(ma_sound* sound, ma_uint64* length, ma_uint32* sampleRate) {
+  if (ma_sound_get_length_in_pcm_frames(sound, length) != MA_SUCCESS) *length = 0;
+  if (ma_sound_get_data_format(sound, NULL, NULL, sampleRate, NULL, 0) != MA_SUCCESS) *sampleRate = 0;
+}
+
+int VoiceManager::add(ma_sound* sound, int priority, std::initializer_list<ma_node*> chain) {
+  Voice v;
+  v.sound = sound;
+  int n = 0;
+  for (ma_node* node : chain)
+    if (n < 2) v.chain[n++] = node;
+  v.priority = priority;
+  v.active = true;
+  v.virtualSince = ma_engine_get_time_in_pcm_frames(engine);
+  // Starts virtual; the next update() decides
+  ma_sound_stop(sound);
+  for (ma_node* node : v.chain)
+    if (node) ma_node_set_state(node, ma_node_state_stopped);
+  voices.push_back(v);
+  order.reserve(voices.size());
+  ++active;
+  return static_cast<int>(voices.size()) - 1;
+}
+
+int VoiceManager::addPool(ma_sound* source, int instances, int priority, ma_sound_group* group) {
+  Pool p;
+  p.first = static_cast<int>(voices.size());
+  for (int i = 0; i < instances; ++i) {
+    auto copy = std::make_unique<ma_sound>();
+    if (ma_sound_init_copy(engine, source, 0, group, copy.get()) != MA_SUCCESS) break;
+    // Copies don't inherit the source's flags; a cue loaded unspatialized
+    // must stay that way, or it plays from the origin
+    ma_sound_set_spatialization_enabled(copy.get(), ma_sound_is_spatialization_enabled(source));
+    Voice v;
+    v.sound = copy.get();
+    v.priority = priority;
+    v.pool = static_cast<int>(pools.size());
+    voices.push_back(v);
+    copies.push_back(std::move(copy));
+    ++p.count;
+  }
+  if (p.count == 0) return -1;
+  order.reserve(voices.size());
+  pools.push_back(p);
+  return static_cast<int>(pools.size()) - 1;
+}
+
+float VoiceManager::estimateLoudness(const Voice& v) const {
+  if (v.pool >= 0) return loudnessAt(v.sound, v.volume, v.position);
+  return loudnessAt(v.sound, ma_sound_get_volume(v.sound), ma_sound_get_position(v.sound));
+}
+
+float VoiceManager::loudnessAt(const ma_sound* sound, float gain, ma_vec3f p) const {
+  if (!ma_sound_is_spatialization_enabled(sound)) return gain;
+  ma_vec3f l = ma_engine_listener_get_position(engine, 0);
+  float d = std::sqrt((p.x - l.x) * (p.x - l.x) + (p.y - l.y) * (p.y - l.y) + (p.z - l.z) * (p.z - l.z));
+  float minD = ma_sound_get_min_distance(sound);
+  float maxD = ma_sound_get_max_distance(sound);
+  float rolloff = ma_sound_get_rolloff(sound);
+  d = std::clamp(d, minD, std::max(minD, maxD));
+  // Same curves as miniaudio's spatializer
+  switch (ma_sound_get_attenuation_model(sound)) {
+  case ma_attenuation_model_inverse:
+    return minD > 0.0f ? gain * minD / (minD + rolloff * (d - minD)) : gain;
+  case ma_attenuation_model_linear:
+    return maxD > minD ? gain * std::max(0.0f, 1.0f - rolloff * (d - minD) / (maxD - minD)) : gain;
+  case ma_attenuation_model_exponential:
+    return minD > 0.0f ? gain * std::pow(d / minD, -rolloff) : gain;
+  default:
+    return gain;
+  }
+}
+
+bool VoiceManager::outranks(const Voice& a, const Voice& b) const {
+  if (a.priority != b.priority) return a.priority > b.priority;
+  float la = a.loudness * (a.isReal ? kRealBias : 1.0f);
+  float lb = b.loudness * (b.isReal ? kRealBias : 1.0f);
+  return la > lb;
+}
+
+bool VoiceManager::virtualPosition(const Voice& v, ma_uint64* cursor) const {
+  ma_uint64 elapsed = ma_engine_get_time_in_pcm_frames(engine) - v.virtualSince;
+  ma_uint32 engineRate = ma_engine_get_sample_rate(engine);
+  ma_uint64 pos = v.virtualCursor;
+  if (v.sampleRate && engineRate) pos += elapsed * v.sampleRate / engineRate;
+  if (v.length == 0) {
+    *cursor = v.virtualCursor;
+    return true;
+  }
+  if (pos >= v.length) {
+    if (v.pool >= 0) return false;
+    pos %= v.length;
+  }
+  *cursor = pos;
+  return true;
+}
+
+void VoiceManager::makeReal(Voice& v) {
+  // Still fading out; seeking it now would click, so it waits a step
+  if (ma_engine_get_time_in_pcm_frames(engine) < v.fadingUntil) return;
+  ma_uint64 cursor = 0;
+  if (!virtualPosition(v, &cursor)) {
+    // A one-shot that ran out while virtual is simply over
+    v.active = false;
+    --active;
+    return;
+  }
+  ma_node_set_state_time(v.sound, ma_node_state_started, 0);
+  ma_node_set_state_time(v.sound, ma_node_state_stopped, ~(ma_uint64)0);
+  if (v.pool >= 0) {
+    ma_sound_set_position(v.sound, v.position.x, v.position.y, v.position.z);
+    ma_sound_set_volume(v.sound, v.volume);
+  }
+  ma_sound_set_fade_in_pcm_frames(v.sound, 0.0f, 1.0f, fadeFrames);
+  ma_sound_seek_to_pcm_frame(v.sound, cursor);
+  ma_sound_start(v.sound);
+  for (ma_node* node : v.chain) {
+    if (!node) continue;
+    ma_node_set_state_time(node, ma_node_state_stopped, ~(ma_uint64)0);
+    ma_node_set_state(node, ma_node_state_started);
+  }
+  v.isReal = true;
+  ++real;
+}
+
+void VoiceManager::makeVirtual(Voice& v) {
+  ma_uint64 now = ma_engine_get_time_in_pcm_frames(engine);
+  if (ma_sound_get_cursor_in_pcm_frames(v.sound, &v.virtualCursor) != MA_SUCCESS) v.virtualCursor = 0;
+  v.virtualSince = now;
+  v.fadingUntil = now + fadeFrames;
+  // Fade out, then the sound and its chain stop on their own
+  ma_sound_stop_with_fade_in_pcm_frames(v.sound, fadeFrames);
+  for (ma_node* node : v.chain)
+    if (node) ma_node_set_state_time(node, ma_node_state_stopped, now + fadeFrames);
+  v.isReal = false;
+  --real;
+}
+
+bool VoiceManager::play(int pool, float x, float y, float z, float volume) {
+  if (pool < 0 || pool >= static_cast<int>(pools.size())) return false;
+  const Pool& p = pools[pool];
+
+  // Free instance, or else the quietest one
+  Voice* slot = nullptr;
+  for (int i = p.first; i < p.first + p.count; ++i) {
+    Voice& v = voices[i];
+    if (!v.active) {
+      slot = &v;
+      break;
+    }
+    v.loudness = estimateLoudness(v);
+    if (!slot || v.loudness < slot->loudness) slot = &v;
+  }
+
+  float loudness = loudnessAt(slot->sound, volume, ma_vec3f{x, y, z});
+  // Stealing would swap a sound for a quieter one
+  if (slot->active && loudness <= slot->loudness) return false;
+  if (slot->active) {
+    // Fades out like any voice going virtual; cutting it off would click
+    if (slot->isReal) makeVirtual(*slot);
+    --active;
+  }
+
+  Voice& v = *slot;
+  v.position = ma_vec3f{x, y, z};
+  v.volume = volume;
+  v.loudness = loudness;
+  v.isReal = false;
+  v.active = true;
+  ++active;
+  sourceInfo(v.sound, &v.length, &v.sampleRate);
+  v.virtualCursor = 0;
+  v.virtualSince = ma_engine_get_time_in_pcm_frames(engine);
+  if (v.loudness < config.audibleGain || v.virtualSince < v.fadingUntil) return true;
+
+  // Take a real voice now if there is room, or from the weakest real voice
+  // this one outranks; otherwise it waits virtual for the next update()
+  if (real >= config.maxReal) {
+    Voice* weakest = nullptr;
+    for (Voice& o : voices)
+      if (o.isReal && (!weakest || outranks(*weakest, o))) weakest = &o;
+    if (!weakest || !outranks(v, *weakest)) return true;
+    makeVirtual(*weakest);
+  }
+  makeReal(v);
+  return true;
+}
+
+bool VoiceManager::pending() const {
+  ma_uint64 now = ma_engine_get_time_in_pcm_frames(engine);
+  for (const Voice& v : voices)
+    if ((v.active && v.pool >= 0) || now < v.fadingUntil) return true;
+  return false;
+}
+
+void VoiceManager::update() {
+  order.clear();
+  for (int i = 0; i < static_cast<int>(voices.size()); ++i) {
+    Voice& v = voices[i];
+    if (!v.active) continue;
+    if (!v.isReal && v.length == 0) sourceInfo(v.sound, &v.length, &v.sampleRate);
+    ma_uint64 cursor;
+    bool over = v.isReal ? ma_sound_at_end(v.sound) : !virtualPosition(v, &cursor);
+    if (v.pool >= 0 && over) {
+      // One-shot finished, for real or on paper
+      if (v.isReal) --real;
+      v.active = false;
+      v.isReal = false;
+      --active;
+      continue;
+    }
+    v.loudness = estimateLoudness(v);
+    order.push_back(i);
+  }
+  // No allocation: order was reserved for every voice when it was added
+  std::sort(order.begin(), order.end(), [this](int a, int b) { return outranks(voices[a], voices[b]); });
+
+  int slots = config.maxReal;
+  for (int i : order) {
+    Voice& v = voices[i];
+    bool wantReal = slots > 0 && v.loudness >= config.audibleGain;
+    if (wantReal) --slots;
+    if (wantReal && !v.isReal) makeReal(v);
+    else if (!wantReal && v.isReal) makeVirtual(v);
+  }
+}
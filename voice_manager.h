@@ -0,0 +1,99 @@
+#pragma once
+
+#include <miniaudio.h>
+
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+struct VoiceConfig {
+  int maxReal = 32;           // hard cap on voices being decoded and mixed
+  float audibleGain = 0.003f; // about -50 dB; quieter voices go virtual
+  float fadeMs = 15.0f;       // fade when a voice turns real or virtual
+};
+
+// Decides which sounds are actually mixed. Every sound handed to it is either
+// real (playing) or virtual: stopped, with its position advanced on paper
+// from the engine clock, and seeked back into place when it becomes real
+// again. Each update ranks the wanted voices by priority, then by estimated
+// loudness at the listener, and makes the top maxReal audible ones real.
+//
+// One-shots come from pools of copies made with ma_sound_init_copy() at
+// init, so playing one never allocates; when a pool is exhausted the
+// quietest instance of it is stolen. A stolen instance that was playing
+// fades out first, and the new one-shot waits virtual until it has.
+//
+// Same threading rule as AudioAssets: voices and pools are added before the
+// audio control thread takes over, after which only that thread may call in.
+class VoiceManager {
+public:
+  VoiceManager() = default;
+  VoiceManager(const VoiceManager&) = delete;
+  VoiceManager& operator=(const VoiceManager&) = delete;
+  ~VoiceManager();
+
+  void init(ma_engine* engine, const VoiceConfig& config);
+  void uninit();
+
+  // Take over starting and stopping a looping sound owned by the caller.
+  // `chain` lists up to two nodes that only carry this sound, stopped along
+  // with it while it is virtual. Returns the voice index.
+  int add(ma_sound* sound, int priority, std::initializer_list<ma_node*> chain = {});
+  // `instances` copies of `source`, which must have been loaded from a file
+  // by the resource manager and not streamed. Returns the pool index or -1.
+  int addPool(ma_sound* source, int instances, int priority, ma_sound_group* group = nullptr);
+  // Start a one-shot from `pool` at world position (x, y, z). False if it
+  // was dropped because every instance is louder than it would be.
+  bool play(int pool, float x, float y, float z, float volume = 1.0f);
+
+  // Re-rank and apply; call every control step
+  void update();
+  // A one-shot is playing or a fade hasn't finished, so update() has work
+  // to do even if nothing else changes
+  bool pending() const;
+
+  int realCount() const { return real; }
+  int activeCount() const { return active; }
+
+private:
+  struct Voice {
+    ma_sound* sound = nullptr;
+    ma_node* chain[2] = {nullptr, nullptr};
+    int priority = 0;
+    int pool = -1;              // -1: looping voice added with add()
+    bool active = false;        // wants to be heard
+    bool isReal = false;
+    float loudness = 0.0f;
+    ma_uint64 length = 0;       // in source frames, 0 if unknown
+    ma_uint32 sampleRate = 0;   // source rate
+    ma_uint64 virtualCursor = 0;
+    ma_uint64 virtualSince = 0; // engine frame
+    ma_uint64 fadingUntil = 0;  // engine frame the fade to virtual ends
+    // Pool instances only: applied when the one-shot turns real, so a stolen
+    // instance keeps its old gain and position while it fades out
+    float volume = 1.0f;
+    ma_vec3f position = {0.0f, 0.0f, 0.0f};
+  };
+  struct Pool {
+    int first = 0, count = 0;
+  };
+
+  float estimateLoudness(const Voice& v) const;
+  float loudnessAt(const ma_sound* sound, float gain, ma_vec3f position) const;
+  bool outranks(const Voice& a, const Voice& b) const;
+  void makeReal(Voice& v);
+  void makeVirtual(Voice& v);
+  // Position the voice would be at now had it kept playing; false if a
+  // one-shot would have finished
+  bool virtualPosition(const Voice& v, ma_uint64* cursor) const;
+
+  ma_engine* engine = nullptr;
+  VoiceConfig config;
+  ma_uint64 fadeFrames = 0;
+  std::vector<Voice> voices;
+  std::vector<Pool> pools;
+  std::vector<std::unique_ptr<ma_sound>> copies; // pool instances
+  std::vector<int> order;                         // scratch for update()
+  int real = 0;
+  int active = 0;
+};
@@ -0,0 +1,203 @@
+#include "xyz_tiles.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+static std::string tilePath(const std::string& root, TileKey k) {
+  return root + "/" + std::to_string(k.z) + "/" + std::to_string(k.x) + "/" + std::to_string(k.y) + ".png";
+}
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& bytes) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in) return false;
+  std::streamoff size = in.tellg();
+  if (size <= 0) return false;
+  bytes.resize(static_cast<size_t>(size));
+  in.seekg(0);
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(bytes.data()), size));
+}
+
+// Non-negative decimal number making up all of `s`
+static bool parseIndex(const std::string& s, uint32_t* out) {
+  if (s.empty() || s.size() > 9) return false;
+  char* end = nullptr;
+  unsigned long v = std::strtoul(s.c_str(), &end, 10);
+  if (*end != '\0' || !std::isdigit(static_cast<unsigned char>(s[0]))) return false;
+  *out = static_cast<uint32_t>(v);
+  return true;
+}
+
+bool DirectoryTileBackend::fetch(TileKey k, std::vector<uint8_t>& bytes) {
+  return readFile(tilePath(root, k), bytes);
+}
+
+bool TileDiskCache::open(const std::string& path, uint64_t budgetBytes) {
+  dir = path;
+  budget = budgetBytes;
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  if (!fs::is_directory(dir, ec)) {
+    std::cerr << "Can't use tile cache directory: " << dir << "\n";
+    return false;
+  }
+
+  // Whatever an earlier run left, oldest use first
+  struct Found {
+    uint64_t key;
+    uint64_t size;
+    fs::file_time_type time;
+  };
+  std::vector<Found> found;
+  for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+    if (!it->is_regular_file(ec)) continue;
+    fs::path rel = it->path().lexically_relative(dir);
+    std::vector<std::string> parts;
+    for (const fs::path& p : rel) parts.push_back(p.string());
+    TileKey k;
+    uint32_t z = 0;
+    if (parts.size() != 3 || rel.extension() != ".png" || !parseIndex(parts[0], &z) || z > 30 ||
+        !parseIndex(parts[1], &k.x) || !parseIndex(rel.stem().string(), &k.y))
+      continue;
+    k.z = static_cast<uint8_t>(z);
+    found.push_back({k.packed(), static_cast<uint64_t>(it->file_size(ec)), it->last_write_time(ec)});
+  }
+  std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.time < b.time; });
+
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+  used = 0;
+  for (const Found& f : found) {
+    entries[f.key] = {f.size, ++useClock};
+    used += f.size;
+  }
+  if (used > budget) trim();
+  return true;
+}
+
+std::string TileDiskCache::pathOf(TileKey k) const {
+  return tilePath(dir, k);
+}
+
+bool TileDiskCache::get(TileKey k, std::vector<uint8_t>& bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(k.packed());
+    if (it == entries.end()) return false;
+    it->second.lastUsed = ++useClock;
+  }
+  std::string path = pathOf(k);
+  if (!readFile(path, bytes)) {
+    // Removed behind our back; fetch it again
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(k.packed());
+    if (it != entries.end()) {
+      used -= it->second.size;
+      entries.erase(it);
+    }
+    return false;
+  }
+  std::error_code ec;
+  fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+  return true;
+}
+
+void TileDiskCache::put(TileKey k, const std::vector<uint8_t>& bytes) {
+  std::string path = pathOf(k);
+  std::error_code ec;
+  fs::create_directories(fs::path(path).parent_path(), ec);
+  // Written aside and renamed, so a crash never leaves half a tile
+  std::string temp = path + ".part";
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    if (!out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())))
+      return;
+  }
+  fs::rename(temp, path, ec);
+  if (ec) {
+    fs::remove(temp, ec);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  Entry& e = entries[k.packed()];
+  used = used - e.size + bytes.size();
+  e = {bytes.size(), ++useClock};
+  if (used > budget) trim();
+}
+
+void TileDiskCache::trim() {
+  std::vector<std::pair<uint64_t, uint64_t>> byAge; // lastUsed, key
+  byAge.reserve(entries.size());
+  for (const auto& [key, e] : entries) byAge.push_back({e.lastUsed, key});
+  std::sort(byAge.begin(), byAge.end());
+  // Down to 90%, so the next few puts don't each trim again
+  std::error_code ec;
+  for (const auto& [lastUsed, key] : byAge) {
+    if (used <= budget / 10 * 9) break;
+    fs::remove(pathOf(TileKey::unpack(key)), ec);
+    used -= entries[key].size;
+    entries.erase(key);
+  }
+}
+
+bool XyzTileSource::open(std::unique_ptr<TileBackend> from, const std::string& cacheDir) {
+  backend = std::move(from);
+  cached = backend->remote() && cache.open(cacheDir, kDiskCacheBytes);
+
+  std::vector<uint8_t> bytes;
+  if (!fetch({0, 0, 0}, bytes)) return false;
+  int w = 0, h = 0, channels = 0;
+  if (!stbi_info_from_memory(bytes.data(), static_cast<int>(bytes.size()), &w, &h, &channels) || w != h ||
+      w <= 0 || (w & (w - 1)) != 0) {
+    std::cerr << "Unsupported XYZ tiles: level 0 must be square power-of-two images\n";
+    return false;
+  }
+  tileSize = w;
+  // Level 0 is a handful of tiles (2 x 1 for an equirectangular world), and
+  // there are at most 20 levels, as in a tile pyramid
+  tilesX = tilesY = 1;
+  while (tilesX < 64 && fetch({0, static_cast<uint32_t>(tilesX), 0}, bytes)) ++tilesX;
+  while (tilesY < 64 && fetch({0, 0, static_cast<uint32_t>(tilesY)}, bytes)) ++tilesY;
+  // Standard z/x/y servers are Web Mercator, one square tile at level 0.
+  // The map is drawn equirectangular, so those would land at the wrong
+  // latitudes; they're turned away rather than shown misaligned.
+  if (tilesX != 2 * tilesY) {
+    std::cerr << "Unsupported XYZ tiles: level 0 must be an equirectangular world, twice as wide as high "
+                 "(Web Mercator tiles aren't supported)\n";
+    return false;
+  }
+  levels = 1;
+  while (levels < 20 && fetch({static_cast<uint8_t>(levels), 0, 0}, bytes)) ++levels;
+  return true;
+}
+
+bool XyzTileSource::fetch(TileKey k, std::vector<uint8_t>& bytes) {
+  if (cached && cache.get(k, bytes)) return true;
+  if (!backend->fetch(k, bytes)) return false;
+  if (cached) cache.put(k, bytes);
+  return true;
+}
+
+bool XyzTileSource::read(TileKey k, uint8_t* rgb) {
+  if (!contains(k)) return false;
+  // Each worker keeps its own buffer for the encoded bytes
+  thread_local std::vector<uint8_t> bytes;
+  if (!fetch(k, bytes)) return false;
+  // The flag is per thread; tiles are top row first, like the pyramid's
+  stbi_set_flip_vertically_on_load_thread(0);
+  int w = 0, h = 0, channels = 0;
+  uint8_t* texels = stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()), &w, &h, &channels, 3);
+  bool ok = texels && w == tileSize && h == tileSize;
+  if (ok) std::memcpy(rgb, texels, tileBytes());
+  stbi_image_free(texels);
+  return ok;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "tile_source.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Where XyzTileSource gets encoded tiles (PNG, or anything stb_image reads)
+// by address, as a tile server would hand them out. fetch() is called from
+// the loader's worker threads, up to concurrency() at once.
+class TileBackend {
+public:
+  virtual ~TileBackend() = default;
+  // False if there is no such tile or it couldn't be had
+  virtual bool fetch(TileKey k, std::vector<uint8_t>& bytes) = 0;
+  // Slow or far enough away that fetched tiles are worth keeping on disk
+  virtual bool remote() const { return false; }
+  virtual int concurrency() const { return 2; }
+};
+
+// root/z/x/y.png on the local disk
+class DirectoryTileBackend : public TileBackend {
+public:
+  explicit DirectoryTileBackend(std::string root) : root(std::move(root)) {}
+  bool fetch(TileKey k, std::vector<uint8_t>& bytes) override;
+
+private:
+  std::string root;
+};
+
+// Tiles kept under a directory exactly as fetched, still compressed, in the
+// same z/x/y layout. Past the byte budget the least recently used go first;
+// use is tracked through file modification times, so it carries over
+// between runs.
+class TileDiskCache {
+public:
+  bool open(const std::string& dir, uint64_t budgetBytes);
+  bool get(TileKey k, std::vector<uint8_t>& bytes);
+  void put(TileKey k, const std::vector<uint8_t>& bytes);
+
+private:
+  struct Entry {
+    uint64_t size = 0;
+    uint64_t lastUsed = 0;
+  };
+  std::string pathOf(TileKey k) const;
+  // Drops the oldest tiles until the cache is well under budget
+  void trim();
+
+  std::mutex mutex;
+  std::string dir;
+  uint64_t budget = 0, used = 0;
+  uint64_t useClock = 0;
+  std::unordered_map<uint64_t, Entry> entries; // guarded by mutex
+};
+
+// Map tiles as a z/x/y tree of images, the layout XYZ tile servers use.
+// The layout is found by probing: level 0's width and height in tiles
+// along its top row and left column, then the number of levels down the
+// left edge. Tiles are fetched through the backend, kept in the disk cache
+// when the backend is remote, and decoded on the loader's worker threads.
+//
+// Only equirectangular tiles are drawn right, so level 0 must be twice as
+// many tiles across as down. Web Mercator tiles, which is what most public
+// tile servers hand out, are rejected rather than reprojected.
+class XyzTileSource : public TileSource {
+public:
+  static constexpr uint64_t kDiskCacheBytes = 512ull << 20;
+
+  // False if level 0 can't be fetched, isn't square power-of-two tiles or
+  // isn't an equirectangular world. Probing fetches several tiles, so call
+  // it off the render thread. cacheDir is only used for remote backends.
+  bool open(std::unique_ptr<TileBackend> backend, const std::string& cacheDir);
+
+  bool read(TileKey k, uint8_t* rgb) override;
+  int concurrency() const override { return backend->concurrency(); }
+
+private:
+  // From the disk cache if it's there, else from the backend
+  bool fetch(TileKey k, std::vector<uint8_t>& bytes);
+
+  std::unique_ptr<TileBackend> backend;
+  TileDiskCache cache;
+  bool cached = false;
+};